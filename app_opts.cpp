@@ -0,0 +1,231 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_opts.h"
+#include "error.h"
+
+app_opts_t app_opts;
+
+enum app_opt_type {
+  OPT_FLAG,
+  OPT_INT,
+  OPT_FLOAT,
+  OPT_STRING,
+  OPT_STRING_LIST   // may be given more than once
+};
+
+struct app_opt {
+  const char *name;
+  app_opt_type type;
+  void *value;
+  const char *help;
+};
+
+static const app_opt app_opt_table[] = {
+  {"softmax-scale", OPT_FLOAT, &app_opts.softmax_scale,
+   "Classification: dequantize the output with this scale and report\n"
+   "                      softmax probabilities (0 = raw output / 255)"},
+  {"vote-window", OPT_INT, &app_opts.vote_window,
+   "Classification: number of observations per ROI in the temporal vote"},
+  {"vote-decay", OPT_FLOAT, &app_opts.vote_decay,
+   "Classification: weight decay per observation of age in the vote"},
+  {"vote-threshold", OPT_FLOAT, &app_opts.vote_threshold,
+   "Classification: decayed score needed to display a class"},
+  {"roi-crop", OPT_STRING, &app_opts.roi_crop,
+   "Classification with ROI grid: crop regions on the vpe or the cpu"},
+  {"cascade-config", OPT_STRING, &app_opts.cascade_config,
+   "SSD: classify every detected box with this network on the DSPs"},
+  {"cascade-labels", OPT_STRING, &app_opts.cascade_labels,
+   "SSD: labels file of the cascade classification network"},
+  {"cascade-class", OPT_STRING, &app_opts.cascade_class,
+   "SSD: only classify boxes with this detection label (default all)"},
+  {"cascade-min-prob", OPT_FLOAT, &app_opts.cascade_min_prob,
+   "SSD: top-1 output / 255 a cascade class needs (default 0.25)"},
+  {"capture", OPT_STRING, &app_opts.capture,
+   "Capture resolution <width>x<height> (default depends on -t)"},
+  {"tiles", OPT_STRING, &app_opts.tiles,
+   "SSD: detect on <cols>x<rows> overlapping tiles of the capture"},
+  {"tile-overlap", OPT_FLOAT, &app_opts.tile_overlap,
+   "SSD with tiles: overlap of neighbouring tiles, fraction of the tile"},
+  {"tile-crop", OPT_STRING, &app_opts.tile_crop,
+   "SSD with tiles: crop the tiles on the vpe or the cpu"},
+  {"tile-nms", OPT_FLOAT, &app_opts.tile_nms,
+   "SSD with tiles: IoU above which boxes of the same class are merged"},
+  {"attention", OPT_FLAG, &app_opts.attention,
+   "SSD: zoom the model input onto the recent detections"},
+  {"attention-pad", OPT_FLOAT, &app_opts.attention_pad,
+   "SSD with attention: margin around the detections, fraction of size"},
+  {"attention-full", OPT_INT, &app_opts.attention_full,
+   "SSD with attention: look at the full capture every n frames"},
+  {"attention-hold", OPT_INT, &app_opts.attention_hold,
+   "SSD with attention: follow the detections of the last n frames"},
+  {"attention-zoom", OPT_FLOAT, &app_opts.attention_zoom,
+   "SSD with attention: largest zoom factor"},
+  {"attention-smooth", OPT_FLOAT, &app_opts.attention_smooth,
+   "SSD with attention: fraction of the way the window moves per frame"},
+  {"net", OPT_STRING_LIST, &app_opts.nets,
+   "Run another network on the capture, on its own cores and DSS plane:\n"
+   "                      <ssd|seg>:<config>:<objects_list>:<eves>:<dsps>"
+   "[:<rate>]\n"
+   "                      with rate n it gets every n-th capture"},
+  {"letterbox", OPT_FLAG, &app_opts.letterbox,
+   "Keep the aspect ratio of the capture in the model input, black bars"},
+  {"switch-config", OPT_STRING, &app_opts.switch_config,
+   "Network of the same type to switch to and back on SIGUSR1"},
+  {"switch-objects", OPT_STRING, &app_opts.switch_objects,
+   "Objects list of the network of --switch-config (ssd and seg)"},
+  {"switch-every", OPT_INT, &app_opts.switch_every,
+   "Also switch networks every n frames"},
+  {"warmup", OPT_INT, &app_opts.warmup,
+   "Synthetic frames per EOP before the capture starts (default 0)"},
+  {"ready-file", OPT_STRING, &app_opts.ready_file,
+   "Write pid and startup time to this file once the pipeline is ready"},
+  {"cmem-slab", OPT_INT, &app_opts.cmem_slab,
+   "MB of CMEM reserved at startup and sub-allocated, 0 to disable\n"
+   "                      (default 16)"},
+  {"uncached", OPT_FLAG, &app_opts.uncached,
+   "Map the CMEM buffers uncached, to compare CPU times with the default"},
+  {"log-level", OPT_INT, &app_opts.log_level,
+   "0 errors, 1 warnings, 2 info, 3 debug, 4 trace (default 2), levels\n"
+   "                      above the LOG_LEVEL of the build are compiled out"},
+  {"trace", OPT_STRING, &app_opts.trace_file,
+   "Write a timeline of the pipeline stages to this JSON file at exit,\n"
+   "                      for ui.perfetto.dev or chrome://tracing"},
+  {"record", OPT_STRING, &app_opts.record_file,
+   "Write every raw capture to this file, to be replayed by replay_bench"},
+  {"latency-hist", OPT_STRING, &app_opts.latency_hist_file,
+   "Write the histogram of the capture to display latency to this CSV\n"
+   "                      file at exit"},
+  {"frame-id", OPT_FLAG, &app_opts.frame_id,
+   "Draw the V4L2 sequence of the capture whose results are shown as a\n"
+   "                      block code into the overlay, for frameid_decode"},
+  {"display-dump", OPT_STRING, &app_opts.display_dump_file,
+   "Write the overlay to this file at every flip, for frameid_decode"},
+  {"metrics", OPT_STRING, &app_opts.metrics_socket,
+   "Serve FPS, stage latencies, drops, CMEM use and detections on this\n"
+   "                      Unix domain socket, as Prometheus text or JSON"},
+  {"results-shm", OPT_STRING, &app_opts.results_shm,
+   "Write the boxes, masks or classes of every frame to a ring in this\n"
+   "                      POSIX shared memory (e.g. /tidl_results)"},
+  {"export-frames", OPT_STRING, &app_opts.export_frames_socket,
+   "Hand the VPE output buffers to other processes as dmabuf fds on\n"
+   "                      this Unix domain socket, see frame_export.h"},
+};
+
+static const int num_app_opts = sizeof(app_opt_table) / sizeof(app_opt_table[0]);
+
+static bool set_app_opt(const app_opt &opt, const char *value)
+{
+  char *end = NULL;
+
+  switch (opt.type) {
+    case OPT_FLAG:
+      *(bool *) opt.value = true;
+      return true;
+    case OPT_INT:
+      *(int *) opt.value = strtol(value, &end, 0);
+      break;
+    case OPT_FLOAT:
+      *(float *) opt.value = strtof(value, &end);
+      break;
+    case OPT_STRING:
+      *(std::string *) opt.value = value;
+      return true;
+    case OPT_STRING_LIST:
+      ((std::vector<std::string> *) opt.value)->push_back(value);
+      return true;
+  }
+  if (end == value || *end != '\0') {
+    ERROR("Invalid value '%s' for --%s", value, opt.name);
+    return false;
+  }
+  return true;
+}
+
+/* Consume every recognized "--name value" or "--name=value" argument and
+ * compact argv so that ProcessArgs only sees the options it knows about.
+ */
+bool ProcessAppArgs(int &argc, char *argv[])
+{
+  int out = 1;
+
+  for (int i = 1; i < argc; i++) {
+    const app_opt *opt = NULL;
+    const char *value = NULL;
+
+    if (strncmp(argv[i], "--", 2) == 0) {
+      const char *name = argv[i] + 2;
+      const char *eq = strchr(name, '=');
+      size_t len = eq ? (size_t)(eq - name) : strlen(name);
+
+      for (int o = 0; o < num_app_opts; o++) {
+        if (strlen(app_opt_table[o].name) == len &&
+            strncmp(app_opt_table[o].name, name, len) == 0) {
+          opt = &app_opt_table[o];
+          break;
+        }
+      }
+      if (opt && eq)
+        value = eq + 1;
+    }
+
+    if (!opt) {
+      argv[out++] = argv[i];
+      continue;
+    }
+
+    if (opt->type != OPT_FLAG && !value) {
+      if (i + 1 >= argc) {
+        ERROR("Missing value for --%s", opt->name);
+        return false;
+      }
+      value = argv[++i];
+    }
+    if (!set_app_opt(*opt, value))
+      return false;
+  }
+
+  argc = out;
+  argv[argc] = NULL;
+  return true;
+}
+
+void DisplayAppHelp()
+{
+  for (int o = 0; o < num_app_opts; o++) {
+    char flag[64];
+    if (app_opt_table[o].type == OPT_FLAG)
+      snprintf(flag, sizeof(flag), "--%s", app_opt_table[o].name);
+    else
+      snprintf(flag, sizeof(flag), "--%s <value>", app_opt_table[o].name);
+    printf(" %-20s %s\n", flag, app_opt_table[o].help);
+  }
+}
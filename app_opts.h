@@ -0,0 +1,131 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef APP_OPTS_H
+#define APP_OPTS_H
+
+#include <string>
+#include <vector>
+#include "async_log.h"
+
+/* Options that are specific to this demo. The short options (-t, -c, -e, ...)
+ * are parsed by ProcessArgs in ../common, which does not know about anything
+ * below. ProcessAppArgs pulls these "--name value" pairs out of argv first so
+ * that the remaining arguments can be passed to ProcessArgs untouched.
+ */
+typedef struct app_opts_t_ {
+  // Classification: scale applied to the uint8 TIDL output before the
+  // softmax. 0 reports the raw output value / 255, as before.
+  float softmax_scale = 0;
+  // Classification: temporal vote over the last vote_window observations of
+  // every ROI, older observations weighted by vote_decay^age. A class is
+  // shown once its decayed score reaches vote_threshold.
+  int vote_window = 5;
+  float vote_decay = 0.8;
+  float vote_threshold = 0.4;
+  // Classification with more than one ROI: "vpe" crops every region with
+  // the VPE, "cpu" cuts them out of the full resolution capture on the CPU
+  std::string roi_crop = "vpe";
+  // SSD: classification network that is run on every detected box, its
+  // labels, and the detection label whose boxes are classified ("" for all)
+  std::string cascade_config = "";
+  std::string cascade_labels = "";
+  std::string cascade_class = "";
+  // top-1 output / 255 of the cascade below which a box keeps its
+  // detection label
+  float cascade_min_prob = 0.25;
+  // Capture resolution "<w>x<h>" instead of the default of the net_type
+  std::string capture = "";
+  // SSD: split every capture into "<cols>x<rows>" overlapping tiles that
+  // are cropped by the "vpe" or on the "cpu", and merge the detections with
+  // a class-aware NMS at IoU tile_nms
+  std::string tiles = "";
+  float tile_overlap = 0.2;
+  std::string tile_crop = "vpe";
+  float tile_nms = 0.45;
+  // SSD: zoom the model input onto the detections of the last
+  // attention_hold frames, padded by attention_pad of their size, at most
+  // attention_zoom times and looking at the full capture every
+  // attention_full frames. The window moves attention_smooth of the way to
+  // its target per frame.
+  bool attention = false;
+  float attention_pad = 0.25;
+  int attention_full = 15;
+  int attention_hold = 5;
+  float attention_zoom = 4;
+  float attention_smooth = 0.5;
+  // Additional networks on the same capture, one
+  // "<type>:<config>:<objects_list>:<eves>:<dsps>[:<rate>]" per --net
+  std::vector<std::string> nets;
+  // Keep the aspect ratio of the capture (or of the crops) in the model
+  // input, with black bars, instead of stretching it
+  bool letterbox = false;
+  // Network of the same type (and its objects list for ssd and seg) that
+  // the pipeline switches to and back from, every switch_every frames and
+  // on SIGUSR1, while the capture keeps streaming
+  std::string switch_config = "";
+  std::string switch_objects = "";
+  int switch_every = 0;
+  // Synthetic frames pushed through every EOP before the capture starts
+  int warmup = 0;
+  // File that is written once the pipeline is ready, for a watchdog
+  std::string ready_file = "";
+  // MB of CMEM reserved at startup for the display buffers, 0 to allocate
+  // every buffer from CMEM on its own
+  int cmem_slab = 16;
+  // Map the CMEM buffers uncached, without cache maintenance around the CPU
+  // accesses, to compare against the default
+  bool uncached = false;
+  // Messages up to this level are logged, as far as the build keeps them
+  // (0 errors, 1 warnings, 2 info, 3 debug, 4 trace)
+  int log_level = LOGLVL_INFO;
+  // Chrome trace-event JSON of the pipeline stages, written at exit
+  std::string trace_file = "";
+  // Raw captures are written to this file, for bench/replay_bench
+  std::string record_file = "";
+  // Histogram of the capture to display latency, written at exit
+  std::string latency_hist_file = "";
+  // Draw the frame ID code of the capture into the overlay, for
+  // bench/frameid_decode
+  bool frame_id = false;
+  // The first overlay is written to this file at every flip
+  std::string display_dump_file = "";
+  // Unix domain socket that serves the live metrics
+  std::string metrics_socket = "";
+  // POSIX shared memory that the results of every frame are written to
+  std::string results_shm = "";
+  // Unix domain socket that the VPE output buffers are exported on
+  std::string export_frames_socket = "";
+} app_opts_t;
+
+extern app_opts_t app_opts;
+
+bool ProcessAppArgs(int &argc, char *argv[]);
+void DisplayAppHelp();
+
+#endif // APP_OPTS_H
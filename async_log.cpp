@@ -0,0 +1,199 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "async_log.h"
+
+#define LOG_RING_SIZE 1024  // power of 2
+#define LOG_MSG_LEN   200
+#define LOG_DRAIN_US  5000
+
+/* Bounded multi-producer ring: a slot is free for position pos when its seq
+ * is pos and holds a message once its seq is pos + 1. The writer thread is
+ * the only consumer and hands the slot back as pos + LOG_RING_SIZE.
+ */
+struct LogSlot {
+  std::atomic<uint32_t> seq;
+  uint32_t frame;
+  int level;
+  uint64_t ns;
+  char msg[LOG_MSG_LEN];
+};
+
+int async_log_level = LOGLVL_INFO;
+
+static LogSlot ring[LOG_RING_SIZE];
+static std::atomic<uint32_t> head(0);
+static uint32_t tail = 0;
+static std::atomic<bool> running(false);
+static std::atomic<uint32_t> dropped(0);
+static std::thread writer;
+static uint64_t start_ns = 0;
+static thread_local uint32_t cur_frame = LOG_NO_FRAME;
+
+static uint64_t now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int format_line(char *line, size_t size, int level, uint32_t frame,
+                       uint64_t ns, const char *msg)
+{
+  static const char tag[] = "EWIDT";
+  double s = (ns - start_ns) / 1e9;
+  int n;
+  if (frame == LOG_NO_FRAME)
+    n = snprintf(line, size, "[%10.6f] %c       %s\n", s, tag[level], msg);
+  else
+    n = snprintf(line, size, "[%10.6f] %c %5u %s\n", s, tag[level], frame,
+                 msg);
+  return n < (int) size ? n : (int) size - 1;
+}
+
+// Write out everything that is in the ring, in one go
+static void drain()
+{
+  char buf[LOG_RING_SIZE / 8 * (LOG_MSG_LEN + 32)];
+  size_t len = 0;
+
+  for (;;) {
+    LogSlot &slot = ring[tail & (LOG_RING_SIZE - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != tail + 1)
+      break;
+    if (sizeof(buf) - len < LOG_MSG_LEN + 32) {
+      fwrite(buf, 1, len, stderr);
+      len = 0;
+    }
+    len += format_line(buf + len, sizeof(buf) - len, slot.level, slot.frame,
+                       slot.ns, slot.msg);
+    slot.seq.store(tail + LOG_RING_SIZE, std::memory_order_release);
+    tail++;
+  }
+  uint32_t lost = dropped.exchange(0, std::memory_order_relaxed);
+  if (lost)
+    len += snprintf(buf + len, sizeof(buf) - len,
+                    "[%10.6f] W       %u log messages dropped\n",
+                    (now_ns() - start_ns) / 1e9, lost);
+  if (len)
+    fwrite(buf, 1, len, stderr);
+}
+
+bool async_log_start(int level)
+{
+  async_log_level = level;
+  if (running)
+    return true;
+  for (uint32_t i = 0; i < LOG_RING_SIZE; i++)
+    ring[i].seq.store(i, std::memory_order_relaxed);
+  head = 0;
+  tail = 0;
+  if (start_ns == 0)
+    start_ns = now_ns();
+  running = true;
+  try {
+    writer = std::thread([] {
+      while (running.load(std::memory_order_relaxed)) {
+        drain();
+        usleep(LOG_DRAIN_US);
+      }
+    });
+  } catch (...) {
+    running = false;
+    return false;
+  }
+  return true;
+}
+
+void async_log_stop()
+{
+  if (!running.exchange(false))
+    return;
+  writer.join();
+  drain();
+}
+
+void async_log_frame(uint32_t frame)
+{
+  cur_frame = frame;
+}
+
+uint32_t async_log_current_frame()
+{
+  return cur_frame;
+}
+
+void async_log_write(int level, const char *fmt, ...)
+{
+  va_list ap;
+  uint64_t ns = now_ns();
+
+  if (!running.load(std::memory_order_relaxed)) {
+    // no writer thread yet (or any more), straight to stderr
+    char msg[LOG_MSG_LEN], line[LOG_MSG_LEN + 32];
+    if (start_ns == 0)
+      start_ns = ns;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+    fwrite(line, 1, format_line(line, sizeof(line), level, cur_frame, ns, msg),
+           stderr);
+    return;
+  }
+
+  uint32_t pos = head.load(std::memory_order_relaxed);
+  LogSlot *slot;
+  for (;;) {
+    slot = &ring[pos & (LOG_RING_SIZE - 1)];
+    int32_t diff = (int32_t) (slot->seq.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    }
+    else if (diff < 0) {
+      // full, the writer is behind
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    else
+      pos = head.load(std::memory_order_relaxed);
+  }
+  slot->level = level;
+  slot->frame = cur_frame;
+  slot->ns = ns;
+  va_start(ap, fmt);
+  vsnprintf(slot->msg, sizeof(slot->msg), fmt, ap);
+  va_end(ap);
+  slot->seq.store(pos + 1, std::memory_order_release);
+}
@@ -0,0 +1,76 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <stdint.h>
+
+/* Log levels. Messages above LOG_LEVEL are compiled out ("make LOG_LEVEL=4"
+ * keeps all of them), the ones below it are filtered at run time against
+ * async_log_level.
+ */
+#define LOGLVL_ERROR 0
+#define LOGLVL_WARN  1
+#define LOGLVL_INFO  2
+#define LOGLVL_DEBUG 3
+#define LOGLVL_TRACE 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOGLVL_INFO
+#endif
+
+/* Messages of the frame loop. They are formatted into a lock-free ring and
+ * written to stderr by a background thread, with the time since startup and
+ * the frame set by async_log_frame() of the calling thread. When the ring is
+ * full the message is dropped and counted rather than blocking the caller.
+ */
+#define LOG_AT(level, fmt, ...) \
+  do { if ((level) <= LOG_LEVEL && (level) <= async_log_level) \
+    async_log_write(level, fmt, ##__VA_ARGS__); } while (0)
+
+#define LOGW(fmt, ...) LOG_AT(LOGLVL_WARN, fmt, ##__VA_ARGS__)
+#define LOGI(fmt, ...) LOG_AT(LOGLVL_INFO, fmt, ##__VA_ARGS__)
+#define LOGD(fmt, ...) LOG_AT(LOGLVL_DEBUG, fmt, ##__VA_ARGS__)
+#define LOGT(fmt, ...) LOG_AT(LOGLVL_TRACE, fmt, ##__VA_ARGS__)
+
+#define LOG_NO_FRAME 0xffffffffu
+
+extern int async_log_level;
+
+// Start the writer thread, until then the messages are written right away
+bool async_log_start(int level);
+// Write out what is left in the ring and stop the writer thread
+void async_log_stop();
+// Frame the messages of the calling thread belong to
+void async_log_frame(uint32_t frame);
+uint32_t async_log_current_frame();
+void async_log_write(int level, const char *fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+#endif // ASYNC_LOG_H
@@ -0,0 +1,163 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <math.h>
+#include <algorithm>
+#include "error.h"
+#include "attention.h"
+
+AttentionCrop::AttentionCrop() : next_recent(0), cap_w(0), cap_h(0),
+  num_frames(0), num_zoomed(0), zoom_sum(0) {}
+
+/* pad:         margin around the detections, fraction of their size
+ * full_period: every full_period-th frame looks at the full capture
+ * hold:        number of frames whose detections the window follows
+ * max_zoom:    the window is at least 1/max_zoom of the capture
+ * smooth:      fraction of the way the window moves to its target per frame
+ */
+bool AttentionCrop::init(int _cap_w, int _cap_h, int model_w, int model_h,
+                         float _pad, int _full_period, int hold,
+                         float _max_zoom, float _smooth)
+{
+  if (hold <= 0 || _max_zoom < 1 || _smooth <= 0 || _smooth > 1) {
+    ERROR("Invalid attention settings: hold %d, max zoom %f, smoothing %f",
+          hold, _max_zoom, _smooth);
+    return false;
+  }
+  cap_w = _cap_w;
+  cap_h = _cap_h;
+  aspect = (float) model_w / model_h;
+  pad = _pad;
+  full_period = _full_period;
+  max_zoom = _max_zoom;
+  smooth = _smooth;
+  recent.assign(hold, area{0, 0, 0, 0, false});
+  next_recent = 0;
+  win_x0 = 0;
+  win_y0 = 0;
+  win_x1 = cap_w;
+  win_y1 = cap_h;
+  for (int i = 0; i < CROP_RING; i++)
+    crops[i] = {0, 0, (uint32_t) cap_w, (uint32_t) cap_h};
+  return true;
+}
+
+void AttentionCrop::update(const det_box_t *boxes, int num)
+{
+  area &a = recent[next_recent];
+  next_recent = (next_recent + 1) % recent.size();
+  a.valid = num > 0;
+  if (!a.valid)
+    return;
+
+  a.x0 = a.y0 = INFINITY;
+  a.x1 = a.y1 = -INFINITY;
+  for (int i = 0; i < num; i++) {
+    a.x0 = std::min(a.x0, boxes[i].xmin);
+    a.y0 = std::min(a.y0, boxes[i].ymin);
+    a.x1 = std::max(a.x1, boxes[i].xmax);
+    a.y1 = std::max(a.y1, boxes[i].ymax);
+  }
+}
+
+/* Window for frame frame_idx, in capture coordinates */
+v4l2_rect AttentionCrop::next(uint32_t frame_idx)
+{
+  float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+  for (auto &a : recent) {
+    if (!a.valid) continue;
+    x0 = std::min(x0, a.x0);
+    y0 = std::min(y0, a.y0);
+    x1 = std::max(x1, a.x1);
+    y1 = std::max(y1, a.y1);
+  }
+
+  v4l2_rect r = {0, 0, (uint32_t) cap_w, (uint32_t) cap_h};
+  bool full = x1 <= x0 ||
+              (full_period > 0 && frame_idx % full_period == 0);
+  if (x1 <= x0) {
+    // nothing to follow, the window opens up again
+    win_x0 = 0;
+    win_y0 = 0;
+    win_x1 = cap_w;
+    win_y1 = cap_h;
+  }
+  else {
+    // target: padded union, at least 1/max_zoom of the capture, with the
+    // aspect ratio of the model
+    float px = (x1 - x0) * pad, py = (y1 - y0) * pad;
+    x0 -= px; x1 += px; y0 -= py; y1 += py;
+    float w = std::max(x1 - x0, cap_w / max_zoom);
+    float h = std::max(y1 - y0, cap_h / max_zoom);
+    if (w / h < aspect) w = h * aspect;
+    else h = w / aspect;
+    w = std::min(w, (float) cap_w);
+    h = std::min(h, (float) cap_h);
+    float cx = std::min(std::max((x0 + x1) / 2, w / 2), cap_w - w / 2);
+    float cy = std::min(std::max((y0 + y1) / 2, h / 2), cap_h - h / 2);
+
+    win_x0 += smooth * ((cx - w / 2) - win_x0);
+    win_y0 += smooth * ((cy - h / 2) - win_y0);
+    win_x1 += smooth * ((cx + w / 2) - win_x1);
+    win_y1 += smooth * ((cy + h / 2) - win_y1);
+  }
+
+  if (!full) {
+    // the VPE works on pairs of YUYV pixels
+    r.left = std::max(0, (int) lroundf(win_x0)) & ~1;
+    r.top = std::max(0, (int) lroundf(win_y0));
+    r.width = std::min(cap_w - (int) r.left,
+                       (int) lroundf(win_x1 - win_x0)) & ~1;
+    r.height = std::min(cap_h - (int) r.top, (int) lroundf(win_y1 - win_y0));
+    num_zoomed++;
+    zoom_sum += (double) cap_w * cap_h / ((double) r.width * r.height);
+  }
+  num_frames++;
+  crops[frame_idx % CROP_RING] = r;
+  return r;
+}
+
+/* The window that was actually applied for frame_idx, if the driver
+ * adjusted the one from next()
+ */
+void AttentionCrop::set_crop(uint32_t frame_idx, const v4l2_rect &r)
+{
+  crops[frame_idx % CROP_RING] = r;
+}
+
+const v4l2_rect &AttentionCrop::crop_of(uint32_t frame_idx) const
+{
+  return crops[frame_idx % CROP_RING];
+}
+
+void AttentionCrop::report() const
+{
+  MSG("Attention: %llu of %llu frames zoomed, mean zoom %.2fx (area)",
+      (unsigned long long) num_zoomed, (unsigned long long) num_frames,
+      num_zoomed ? zoom_sum / num_zoomed : 1.0);
+}
@@ -0,0 +1,78 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef ATTENTION_H
+#define ATTENTION_H
+
+#include <stdint.h>
+#include <vector>
+#include <linux/videodev2.h>
+#include "nms.h"
+
+/* Window of the capture that the model input is zoomed onto. It follows the
+ * union of the detections of the last few frames, padded and grown to the
+ * aspect ratio of the model, and every full_period frames the full capture
+ * is looked at again so that new objects are found. Without recent
+ * detections the full capture is used.
+ *
+ * The window that was used for every frame is kept until its results are
+ * in, so that they can be mapped back to the capture. No memory is
+ * allocated after init.
+ */
+class AttentionCrop {
+public:
+  AttentionCrop();
+  bool init(int cap_w, int cap_h, int model_w, int model_h, float pad,
+            int full_period, int hold, float max_zoom, float smooth);
+  bool enabled() const { return cap_w > 0; }
+  v4l2_rect next(uint32_t frame_idx);
+  void set_crop(uint32_t frame_idx, const v4l2_rect &r);
+  const v4l2_rect &crop_of(uint32_t frame_idx) const;
+  // detections of a frame, in capture coordinates
+  void update(const det_box_t *boxes, int num);
+  void report() const;
+
+private:
+  // must cover the frames that are in flight in the EOPs
+  static const int CROP_RING = 64;
+  v4l2_rect crops[CROP_RING];
+  struct area { float x0, y0, x1, y1; bool valid; };
+  std::vector<area> recent;   // union of the boxes of the last hold frames
+  int next_recent;
+  float win_x0, win_y0, win_x1, win_y1;
+  int cap_w, cap_h;
+  float aspect;
+  float pad;
+  int full_period;
+  float max_zoom;
+  float smooth;
+  uint64_t num_frames, num_zoomed;
+  double zoom_sum;
+};
+
+#endif // ATTENTION_H
@@ -0,0 +1,145 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/* Reference client of "accelerated_tidl --export-frames <socket>": maps the
+ * VPE output buffers that come as dmabuf fds, reads every frame in place and
+ * releases it, so that the buffer goes back to the VPE.
+ *
+ *   make frame_sink && ./frame_sink /tmp/tidl_frames.sock [--frames <n>]
+ *       [--hold <ms>] [--record <file>]
+ *
+ * --hold keeps every frame that long before the release, as a slow
+ * analytics process would; --record writes the frames to a capture file.
+ * At the end the time from the capture to the frame here is reported.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include "../frame_export.h"
+#include "../capture_file.h"
+#include "../perf_stats.h"
+
+using namespace std;
+
+static uint64_t now_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// mean of the first channel over every 16th pixel, to touch the frame
+static double mean_level(const uint8_t *data, const frame_export_msg_t &f)
+{
+  uint64_t sum = 0, n = 0;
+  uint32_t bytes_pp = f.width ? f.stride / f.width : 1;
+  for (uint32_t y = 0; y < f.height; y += 16)
+    for (uint32_t x = 0; x < f.width; x += 16, n++)
+      sum += data[y * f.stride + x * bytes_pp];
+  return n ? (double) sum / n : 0;
+}
+
+int main(int argc, char *argv[])
+{
+  string path, record;
+  long frames = -1;
+  int hold_ms = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+      frames = atol(argv[++i]);
+    else if (!strcmp(argv[i], "--hold") && i + 1 < argc)
+      hold_ms = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+      record = argv[++i];
+    else if (path == "" && argv[i][0] != '-')
+      path = argv[i];
+    else
+      path = "";
+  }
+  if (path == "") {
+    printf("Usage: frame_sink <socket> [--frames <n>] [--hold <ms>] "
+           "[--record <file>]\n");
+    return EXIT_FAILURE;
+  }
+
+  FrameImporter frames_in;
+  if (!frames_in.connect(path))
+    return EXIT_FAILURE;
+
+  CaptureWriter writer;
+  LatencyStats capture_to_client;
+  frame_export_msg_t f;
+  uint64_t last = 0, skipped = 0;
+  uint32_t generation = 0;
+  for (long n = 0; frames < 0 || n < frames; n++) {
+    const uint8_t *data = frames_in.next(f, -1);
+    if (!data)
+      break;
+    if (f.generation != generation) {
+      printf("%u buffers of %ux%u, fourcc %.4s, stride %u\n",
+             frames_in.get_format().num_buffers, f.width, f.height,
+             (const char *) &f.fourcc, f.stride);
+      generation = f.generation;
+      writer.close();
+      if (record != "" &&
+          !writer.open(record, f.width, f.height, f.fourcc, f.size))
+        return EXIT_FAILURE;
+    }
+    // the frames the exporter published while this client could not take
+    if (last && f.frame > last + 1)
+      skipped += f.frame - last - 1;
+    last = f.frame;
+
+    uint64_t now = now_us();
+    if (f.capture_us)
+      capture_to_client.add((now - f.capture_us) / 1000.0);
+    printf("frame %llu capture %u: %.1f ms after the capture, level %.1f\n",
+           (unsigned long long) f.frame, f.sequence,
+           f.capture_us ? (now - f.capture_us) / 1000.0 : 0.0,
+           mean_level(data, f));
+    if (writer.is_open()) {
+      capture_frame_info_t info = {};
+      info.sequence = f.sequence;
+      info.capture_us = f.capture_us;
+      info.display_us = now;
+      writer.write(data, info);
+    }
+    if (hold_ms)
+      usleep(hold_ms * 1000);
+    frames_in.release(f);
+  }
+
+  printf("%llu frames published while this client held its buffers or was "
+         "behind\n", (unsigned long long) skipped);
+  capture_to_client.report("Capture to client");
+  return frames_in.is_connected() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
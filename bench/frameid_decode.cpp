@@ -0,0 +1,230 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/* Glass-to-glass latency from the frame ID code that "accelerated_tidl
+ * --frame-id" draws into the overlay:
+ *
+ *   ./frameid_decode <file> [--roi x,y,w,h] [--csv out.csv]
+ *
+ * file is either
+ *  - a recording of the screen, made with "--record" by a second instance
+ *    (or the same camera) looking at the display or at a loopback of its
+ *    output. The code carries the V4L2 sequence of the capture the results
+ *    are of, the recording holds when each capture was taken, so the
+ *    latency is from the capture of the ID to the first recorded frame
+ *    that shows it. Both have to come from the same camera.
+ *  - the overlays dumped with "--display-dump" at every flip, to measure
+ *    the display path on a bench without a camera on the screen. The
+ *    latency is then up to the page flip, and every decoded ID is checked
+ *    against the one the frame loop drew.
+ *
+ * The code is looked for where --frame-id puts it for the size of the
+ * frames, --roi gives the region of the row of cells in a recording of the
+ * screen instead.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "../capture_file.h"
+#include "../frame_id.h"
+#include "../perf_stats.h"
+#include "../error.h"
+
+using namespace std;
+
+#define FOURCC(a, b, c, d) ((uint32_t)(uint8_t)(a) | \
+    ((uint32_t)(uint8_t)(b) << 8) | ((uint32_t)(uint8_t)(c) << 16) | \
+    ((uint32_t)(uint8_t)(d) << 24 ))
+
+// brightness 0..255 of pixel (x, y) of a frame
+static float luma(const uint8_t *frame, const capture_file_header_t &fmt,
+                  int x, int y)
+{
+  switch (fmt.fourcc) {
+  case FOURCC('Y','U','Y','V'):
+    return frame[(y * fmt.width + x) * 2];
+  case FOURCC('A','R','2','4'): {
+    const uint8_t *p = frame + (y * fmt.width + x) * 4;
+    return 0.114f * p[0] + 0.587f * p[1] + 0.299f * p[2];
+  }
+  default: { // RX12, 0bXXXXRRRRGGGGBBBB
+    uint16_t v = ((const uint16_t *) frame)[y * fmt.width + x];
+    return 17 * (0.299f * ((v >> 8) & 15) + 0.587f * ((v >> 4) & 15) +
+                 0.114f * (v & 15));
+  }
+  }
+}
+
+// mean brightness of the middle half of every cell of the row in roi
+static void sample_cells(const uint8_t *frame, const capture_file_header_t &fmt,
+                         int rx, int ry, int rw, int rh,
+                         float level[FRAME_ID_CELLS])
+{
+  float cw = (float) rw / FRAME_ID_CELLS;
+  for (int i = 0; i < FRAME_ID_CELLS; i++) {
+    int x0 = rx + (int) (cw * (i + 0.25f)), x1 = rx + (int) (cw * (i + 0.75f));
+    int y0 = ry + rh / 4, y1 = ry + (rh * 3) / 4;
+    if (x1 <= x0) x1 = x0 + 1;
+    if (y1 <= y0) y1 = y0 + 1;
+    float sum = 0;
+    for (int y = y0; y < y1; y++)
+      for (int x = x0; x < x1; x++)
+        sum += luma(frame, fmt, x, y);
+    level[i] = sum / ((x1 - x0) * (y1 - y0));
+  }
+}
+
+static void usage()
+{
+  printf("Usage: frameid_decode <file> [--roi x,y,w,h] [--csv out.csv]\n");
+}
+
+int main(int argc, char *argv[])
+{
+  string path, csv_path;
+  int rx = -1, ry = -1, rw = 0, rh = 0;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--roi" && i + 1 < argc) {
+      if (sscanf(argv[++i], "%d,%d,%d,%d", &rx, &ry, &rw, &rh) != 4 ||
+          rx < 0 || ry < 0 || rw < FRAME_ID_CELLS || rh <= 0) {
+        usage();
+        return EXIT_FAILURE;
+      }
+    }
+    else if (arg == "--csv" && i + 1 < argc)  csv_path = argv[++i];
+    else if (path == "" && arg[0] != '-')    path = arg;
+    else {
+      usage();
+      return EXIT_FAILURE;
+    }
+  }
+  if (path == "") {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  CaptureReader file;
+  if (!file.open(path))
+    return EXIT_FAILURE;
+  const capture_file_header_t &fmt = file.format();
+  if (fmt.fourcc != FOURCC('Y','U','Y','V') &&
+      fmt.fourcc != FOURCC('A','R','2','4') &&
+      fmt.fourcc != FOURCC('R','X','1','2')) {
+    ERROR("%s: frames of %.4s are not supported", path.c_str(),
+          (const char *) &fmt.fourcc);
+    return EXIT_FAILURE;
+  }
+  if (rw == 0) {
+    int cell;
+    frame_id_layout(fmt.width, fmt.height, &rx, &ry, &cell);
+    rw = FRAME_ID_CELLS * cell;
+    rh = cell;
+  }
+  if (rx + rw > (int) fmt.width || ry + rh > (int) fmt.height) {
+    ERROR("The code region is outside of the %ux%u frames", fmt.width,
+          fmt.height);
+    return EXIT_FAILURE;
+  }
+
+  FILE *csv = NULL;
+  if (csv_path != "") {
+    csv = fopen(csv_path.c_str(), "w");
+    if (!csv) {
+      ERROR("Could not open %s: %s", csv_path.c_str(), strerror(errno));
+      return EXIT_FAILURE;
+    }
+    fprintf(csv, "frame,sequence,id,latency_ms\n");
+  }
+
+  /* when the capture of every sequence (low 16 bits, as in the code) was
+   * taken, from the frame info of the file
+   */
+  vector<uint8_t> frame(fmt.frame_size);
+  vector<capture_frame_info_t> info(file.num_frames());
+  map<uint16_t, uint64_t> captured_at;
+  for (uint32_t f = 0; f < file.num_frames(); f++) {
+    if (!file.read(frame.data(), &info[f]))
+      return EXIT_FAILURE;
+    if (info[f].capture_us)
+      captured_at[(uint16_t) info[f].sequence] = info[f].capture_us;
+  }
+
+  LatencyStats latency;
+  uint32_t decoded = 0, ids = 0, unmatched = 0, mismatched = 0;
+  bool dump = fmt.fourcc != FOURCC('Y','U','Y','V');
+  int last_id = -1;
+  for (uint32_t f = 0; f < file.num_frames(); f++) {
+    float level[FRAME_ID_CELLS];
+    uint16_t id;
+    file.read(frame.data());
+    sample_cells(frame.data(), fmt, rx, ry, rw, rh, level);
+    if (!frame_id_decode(level, &id)) {
+      if (csv)
+        fprintf(csv, "%u,%u,,\n", f, info[f].sequence);
+      continue;
+    }
+    decoded++;
+    // the dump knows which ID was drawn
+    if (dump && id != (uint16_t) info[f].sequence)
+      mismatched++;
+
+    double ms = -1;
+    if (id != last_id) {
+      ids++;
+      auto it = captured_at.find(id);
+      if (it != captured_at.end() && info[f].display_us > it->second) {
+        ms = (info[f].display_us - it->second) / 1000.0;
+        latency.add(ms);
+      }
+      else
+        unmatched++;
+      last_id = id;
+    }
+    if (csv) {
+      if (ms >= 0)
+        fprintf(csv, "%u,%u,%u,%.3f\n", f, info[f].sequence, id, ms);
+      else
+        fprintf(csv, "%u,%u,%u,\n", f, info[f].sequence, id);
+    }
+  }
+  if (csv)
+    fclose(csv);
+
+  MSG("%u frames, the code was read in %u, %u different IDs of which %u "
+      "have no capture time in the file", file.num_frames(), decoded, ids,
+      unmatched);
+  if (dump)
+    MSG("%u frames show another ID than the one drawn", mismatched);
+  latency.report(dump ? "Capture to flip" : "Glass to glass");
+  return decoded > 0 && mismatched == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
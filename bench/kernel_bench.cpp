@@ -0,0 +1,401 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/* Microbenchmarks of the CPU kernels of the frame loop at every shipped
+ * model resolution:
+ *
+ *   make kernel_bench && ./kernel_bench [--kernel <name>] [--reps <n>]
+ *                                       [--warmup <n>] [--perf]
+ *
+ * Every implementation runs warmup times and then reps times on the same
+ * inputs, the median time and its median absolute deviation are printed,
+ * with --perf also the median CPU cycles (perf_event). The first
+ * implementation of a kernel is its reference, the output of the others is
+ * checked against it.
+ *
+ * An alternative is benchmarked by adding it next to the others:
+ *
+ *   KERNEL_IMPL(seg_colorize, my_version) {
+ *     ...read in.seg_classes, write in.dst...
+ *     return bytes written to in.dst;
+ *   }
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "../overlay_kernels.h"
+#include "../crop_kernels.h"
+#include "../topk.h"
+
+using namespace std;
+using namespace cv;
+
+#define TOP_CANDIDATES 5
+#define CLASS_OUTPUTS  1001
+#define SSD_DETS       100
+
+// Inputs of the kernels at one resolution, the same for every implementation
+struct KernelInput {
+  int w, h;
+  vector<uint8_t> bgrx;          // VPE output
+  vector<uint8_t> yuyv;          // capture of the USB camera
+  vector<uint8_t> seg_classes;   // segmentation output
+  vector<float>   ssd_out;       // detection output, 7 floats per box
+  vector<uint8_t> class_out;     // classification output
+  vector<uint8_t> dst;           // written by the kernels
+};
+
+typedef size_t (*kernel_fn_t)(KernelInput &in);
+
+struct KernelImpl {
+  const char *kernel;
+  const char *impl;
+  kernel_fn_t fn;
+};
+
+static vector<KernelImpl> &kernel_impls()
+{
+  static vector<KernelImpl> impls;
+  return impls;
+}
+
+struct RegisterKernel {
+  RegisterKernel(const char *kernel, const char *impl, kernel_fn_t fn) {
+    kernel_impls().push_back({kernel, impl, fn});
+  }
+};
+
+#define KERNEL_IMPL(kernel, impl) \
+  static size_t kernel##_##impl(KernelInput &in); \
+  static RegisterKernel register_##kernel##_##impl(#kernel, #impl, \
+                                                    kernel##_##impl); \
+  static size_t kernel##_##impl(KernelInput &in)
+
+/*************************** network input ********************************/
+// What ReadFrameInput did before SplitToPlanar
+KERNEL_IMPL(input, split_memcpy) {
+  Mat pic(in.h, in.w, CV_8UC4, in.bgrx.data());
+  Mat planes[4];
+  split(pic, planes);
+  int plane_size = in.w * in.h;
+  for (int i = 0; i < 3; i++)
+    memcpy(in.dst.data() + i * plane_size, planes[i].data, plane_size);
+  return 3 * plane_size;
+}
+
+KERNEL_IMPL(input, mix_channels) {
+  SplitToPlanar(in.bgrx.data(), in.w, in.h, (char *) in.dst.data());
+  return 3 * in.w * in.h;
+}
+
+KERNEL_IMPL(input, packed_to_planar) {
+  resize_packed_to_planar(in.bgrx.data(), in.w, in.h, 4, in.dst.data(),
+                          in.w, in.h, 3);
+  return 3 * in.w * in.h;
+}
+
+/*************************** segmentation overlay **************************/
+KERNEL_IMPL(seg_colorize, switch) {
+  ColorizeSeg(in.seg_classes.data(), in.w * in.h, (uint16_t *) in.dst.data());
+  return 2 * in.w * in.h;
+}
+
+KERNEL_IMPL(seg_colorize, lut) {
+  static const uint16_t lut[256] = {0x0000, 0x00F0, 0x0F00, 0x000F, 0x0FF0};
+  uint16_t *dst = (uint16_t *) in.dst.data();
+  const uint8_t *cls = in.seg_classes.data();
+  for (int i = 0; i < in.w * in.h; i++)
+    dst[i] = lut[cls[i]];
+  return 2 * in.w * in.h;
+}
+
+/*************************** detection overlay *****************************/
+// The loop of WriteFrameOutputSSD, every box that passes is drawn
+KERNEL_IMPL(ssd_boxes, opencv) {
+  static const string label = "pedestrian";
+  Mat frame(in.h, in.w, CV_8UC4, in.dst.data());
+  memset(in.dst.data(), 0, in.w * in.h * 4);
+  int num_floats = in.ssd_out.size();
+  ssd_det_t dets[num_floats / 7 + 1];
+  int num = ParseSSDOutput(in.ssd_out.data(), num_floats, 0.30f, in.w, in.h,
+                           dets, num_floats / 7);
+  for (int i = 0; i < num; i++)
+    DrawBox(frame, Scalar(0, 255, 0, 255), label, (int) dets[i].xmin,
+            (int) dets[i].ymin, (int) dets[i].xmax, (int) dets[i].ymax);
+  return in.w * in.h * 4;
+}
+
+/*************************** classification ********************************/
+// The top-k of tf_postprocess with the softmax of the best candidate
+KERNEL_IMPL(class_topk, topk_u8) {
+  topk_result_t top;
+  topk_u8(in.class_out.data(), CLASS_OUTPUTS, TOP_CANDIDATES, &top);
+  float denom = topk_softmax_denom(in.class_out.data(), CLASS_OUTPUTS,
+                                   top.val[0]);
+  float prob = topk_softmax_prob(top.val[0], top.val[0], denom);
+  memcpy(in.dst.data(), top.idx, top.k * sizeof(top.idx[0]));
+  memcpy(in.dst.data() + top.k * sizeof(top.idx[0]), &prob, sizeof(prob));
+  return top.k * sizeof(top.idx[0]) + sizeof(prob);
+}
+
+KERNEL_IMPL(class_topk, partial_sort) {
+  const uint8_t *out = in.class_out.data();
+  int idx[CLASS_OUTPUTS];
+  for (int i = 0; i < CLASS_OUTPUTS; i++)
+    idx[i] = i;
+  partial_sort(idx, idx + TOP_CANDIDATES, idx + CLASS_OUTPUTS,
+               [out](int a, int b) {
+                 return out[a] > out[b] || (out[a] == out[b] && a < b);
+               });
+  float denom = topk_softmax_denom(out, CLASS_OUTPUTS, out[idx[0]]);
+  float prob = topk_softmax_prob(out[idx[0]], out[idx[0]], denom);
+  memcpy(in.dst.data(), idx, TOP_CANDIDATES * sizeof(idx[0]));
+  memcpy(in.dst.data() + TOP_CANDIDATES * sizeof(idx[0]), &prob, sizeof(prob));
+  return TOP_CANDIDATES * sizeof(idx[0]) + sizeof(prob);
+}
+
+/*************************** FPS overlay ***********************************/
+KERNEL_IMPL(overlay_fps, opencv) {
+  Mat frame(in.h, in.w, CV_8UC4, in.dst.data());
+  OverlayFPS(frame, in.w, in.h, 29.97f, 1);
+  return in.w * in.h * 4;
+}
+
+/*************************** USB capture ***********************************/
+// The copy of a USB camera capture into the VPE input in grab_image
+KERNEL_IMPL(usb_memcpy, memcpy) {
+  memcpy(in.dst.data(), in.yuyv.data(), in.yuyv.size());
+  return in.yuyv.size();
+}
+
+/***************************************************************************/
+
+struct Resolution {
+  const char *name;
+  int w, h;
+};
+
+// input sizes of the shipped networks
+static const Resolution resolutions[] = {
+  {"jdetnet", 768, 320},
+  {"jseg21", 1024, 512},
+  {"class", 224, 224},
+};
+
+static void fill_input(KernelInput &in, int w, int h)
+{
+  in.w = w;
+  in.h = h;
+  in.bgrx.resize(w * h * 4);
+  in.yuyv.resize(w * h * 2);
+  in.seg_classes.resize(w * h);
+  in.class_out.resize(CLASS_OUTPUTS);
+  in.dst.assign(w * h * 4, 0);
+  srand(1);
+  for (size_t i = 0; i < in.bgrx.size(); i++)
+    in.bgrx[i] = rand();
+  for (size_t i = 0; i < in.yuyv.size(); i++)
+    in.yuyv[i] = rand();
+  // regions of one class, as a segmentation output
+  for (int y = 0; y < h; y++)
+    for (int x = 0; x < w; x++)
+      in.seg_classes[y * w + x] = ((x / 64) + (y / 32)) % 6;
+  // a softmax output, mostly close to zero with a few peaks
+  for (int i = 0; i < CLASS_OUTPUTS; i++)
+    in.class_out[i] = rand() % 4;
+  for (int p = 0; p < 5; p++)
+    in.class_out[rand() % CLASS_OUTPUTS] = 32 + rand() % 224;
+  // a third of the boxes above the threshold
+  in.ssd_out.assign(SSD_DETS * 7 + 1, 0);
+  for (int i = 0; i < SSD_DETS; i++) {
+    float *d = &in.ssd_out[i * 7];
+    float x = (rand() % 80) / 100.0f, y = (rand() % 70) / 100.0f;
+    d[1] = 1;
+    d[2] = (i % 3 == 0) ? 0.5f + (rand() % 50) / 100.0f : 0.1f;
+    d[3] = x;
+    d[4] = y;
+    d[5] = x + 0.05f + (rand() % 15) / 100.0f;
+    d[6] = y + 0.1f + (rand() % 20) / 100.0f;
+  }
+  in.ssd_out[SSD_DETS * 7] = -1;
+}
+
+static uint64_t now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int open_cycle_counter()
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static double median(vector<double> v)
+{
+  sort(v.begin(), v.end());
+  size_t n = v.size();
+  return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static double mad(const vector<double> &v, double med)
+{
+  vector<double> dev(v.size());
+  for (size_t i = 0; i < v.size(); i++)
+    dev[i] = fabs(v[i] - med);
+  return median(dev);
+}
+
+static uint64_t fnv1a(const uint8_t *p, size_t n)
+{
+  uint64_t h = 14695981039346656037ull;
+  for (size_t i = 0; i < n; i++)
+    h = (h ^ p[i]) * 1099511628211ull;
+  return h;
+}
+
+static void usage()
+{
+  printf("Usage: kernel_bench [--kernel <name>] [--reps <n>] [--warmup <n>] "
+         "[--perf]\nKernels:");
+  string last;
+  for (auto &k : kernel_impls())
+    if (last != k.kernel) {
+      printf(" %s", k.kernel);
+      last = k.kernel;
+    }
+  printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+  string only;
+  int reps = 100, warmup = 10;
+  bool perf = false;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--kernel" && i + 1 < argc)       only = argv[++i];
+    else if (arg == "--reps" && i + 1 < argc)    reps = atoi(argv[++i]);
+    else if (arg == "--warmup" && i + 1 < argc)  warmup = atoi(argv[++i]);
+    else if (arg == "--perf")                    perf = true;
+    else {
+      usage();
+      return EXIT_FAILURE;
+    }
+  }
+  if (reps <= 0 || warmup < 0) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  int cycles_fd = -1;
+  if (perf) {
+    cycles_fd = open_cycle_counter();
+    if (cycles_fd < 0)
+      printf("perf_event cycle counter not available: %s\n", strerror(errno));
+  }
+  topk_softmax_init(0.25f);
+
+  printf("%-14s %-18s %-10s %11s %9s %12s  %s\n", "kernel", "implementation",
+         "input", "median us", "MAD us", "cycles", "output");
+  KernelInput in;
+  for (const Resolution &r : resolutions) {
+    fill_input(in, r.w, r.h);
+    string ref_kernel;
+    uint64_t ref_hash = 0;
+    size_t ref_size = 0;
+    for (const KernelImpl &k : kernel_impls()) {
+      if (only != "" && only != k.kernel)
+        continue;
+      fill(in.dst.begin(), in.dst.end(), 0);
+      size_t size = 0;
+      for (int i = 0; i < warmup; i++)
+        size = k.fn(in);
+
+      vector<double> us(reps), cycles;
+      for (int i = 0; i < reps; i++) {
+        if (cycles_fd >= 0) {
+          ioctl(cycles_fd, PERF_EVENT_IOC_RESET, 0);
+          ioctl(cycles_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        uint64_t t0 = now_ns();
+        size = k.fn(in);
+        uint64_t t1 = now_ns();
+        if (cycles_fd >= 0) {
+          uint64_t count = 0;
+          ioctl(cycles_fd, PERF_EVENT_IOC_DISABLE, 0);
+          if (read(cycles_fd, &count, sizeof(count)) == sizeof(count))
+            cycles.push_back(count);
+        }
+        us[i] = (t1 - t0) / 1e3;
+      }
+
+      // the first implementation of a kernel is the reference
+      const char *check = "reference";
+      uint64_t hash = fnv1a(in.dst.data(), size);
+      if (ref_kernel != k.kernel) {
+        ref_kernel = k.kernel;
+        ref_hash = hash;
+        ref_size = size;
+      }
+      else
+        check = size == ref_size && hash == ref_hash ? "same" : "DIFFERS";
+
+      double med = median(us);
+      char res[16], cyc[16] = "-";
+      snprintf(res, sizeof(res), "%dx%d", r.w, r.h);
+      if (!cycles.empty())
+        snprintf(cyc, sizeof(cyc), "%.0f", median(cycles));
+      printf("%-14s %-18s %-10s %11.2f %9.2f %12s  %s\n", k.kernel, k.impl,
+             res, med, mad(us, med), cyc, check);
+    }
+  }
+  if (cycles_fd >= 0)
+    close(cycles_fd);
+  return EXIT_SUCCESS;
+}
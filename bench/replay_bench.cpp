@@ -0,0 +1,673 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/* Replay of a capture recorded with "accelerated_tidl --record <file>"
+ * through the pipeline of every shipped network, to catch performance
+ * regressions before they ship:
+ *
+ *   make replay_bench && ./replay_bench capture.raw --out results.json
+ *   ./replay_bench capture.raw --baseline results.json [--tolerance 10]
+ *
+ * Every frame goes through capture (reading the recording), VPE,
+ * preprocess, the network, postprocess and display. The networks run on
+ * the EVEs and DSPs as in the demo, the VPE is replaced by the CPU crop
+ * kernel (the --cpu-crop path) and the display by a copy of the overlay,
+ * so no camera or screen is needed. The preprocess and the postprocess are
+ * the kernels of the demo in overlay_kernels.cpp.
+ *
+ * "make replay_bench_host" builds it for x86 Linux hosts (with OpenCV),
+ * with stand-ins for the networks that produce outputs of the right shape
+ * from the input. The host numbers only track the CPU stages.
+ *
+ * The results (FPS, p50/p99 frame latency, per stage times and CPU use)
+ * are written as JSON. With --baseline, an earlier results file, the exit
+ * status is 1 when a network lost more than the tolerance in FPS or gained
+ * more than it in p50/p99 latency.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include "../capture_file.h"
+#include "../crop_kernels.h"
+#include "../topk.h"
+#include "../overlay_kernels.h"
+#include "../perf_stats.h"
+#include "../error.h"
+#ifndef REPLAY_HOST
+#include "executor.h"
+#include "execution_object.h"
+#include "execution_object_pipeline.h"
+#include "configuration.h"
+using namespace tidl;
+#endif
+
+using namespace std;
+
+#define TOP_CANDIDATES   5
+#define SSD_MAX_DETS     20
+#define SSD_MIN_SCORE    0.3f
+#define DEFAULT_FRAMES   300
+#define DEFAULT_TOLERANCE 10.0
+
+enum { ST_CAPTURE, ST_VPE, ST_PREPROCESS, ST_NETWORK, ST_POSTPROCESS,
+       ST_DISPLAY, NUM_STAGES };
+static const char *stage_names[NUM_STAGES] = {
+  "capture", "vpe", "preprocess", "network", "postprocess", "display"
+};
+
+/* The shipped networks. The input and output sizes are those of the
+ * stand-ins, on the board they come from the configuration.
+ */
+typedef struct net_spec_t_ {
+  const char *name;
+  const char *net_type;
+  const char *config;
+  int in_w, in_h;
+  int out_size;
+} net_spec_t;
+
+#define INFER_CONFIG(name) "../test/testvecs/config/infer/tidl_config_" name ".txt"
+
+static const net_spec_t net_specs[] = {
+  {"jdetnet",      "ssd",   INFER_CONFIG("jdetnet"),         768, 320,
+   SSD_MAX_DETS * 7 * 4},
+  {"jdetnet_voc",  "ssd",   INFER_CONFIG("jdetnet_voc"),     768, 320,
+   SSD_MAX_DETS * 7 * 4},
+  {"jseg21",       "seg",   INFER_CONFIG("jseg21_tiscapes"), 1024, 512,
+   1024 * 512},
+  {"toydogs",      "class", "configs/stream_config_toydogs.txt",      224, 224,
+   1000},
+  {"j11_v2",       "class", "configs/stream_config_j11_v2.txt",       224, 224,
+   1000},
+  {"mobilenet",    "class", "configs/stream_config_mobilenet.txt",    224, 224,
+   1001},
+  {"inceptionnet", "class", "configs/stream_config_inceptionnet.txt", 224, 224,
+   1001},
+};
+static const int num_net_specs = sizeof(net_specs) / sizeof(net_specs[0]);
+
+static double now_ms(clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static double process_cpu_ms()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3 +
+         (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+struct StageStats {
+  LatencyStats time;
+  double cpu_ms = 0;
+  double wall_ms = 0;
+};
+
+// Wall and CPU time of the enclosing scope
+class StageTimer {
+public:
+  explicit StageTimer(StageStats &s)
+    : stats(s), wall(now_ms(CLOCK_MONOTONIC)),
+      cpu(now_ms(CLOCK_THREAD_CPUTIME_ID)) {}
+  ~StageTimer() {
+    double ms = now_ms(CLOCK_MONOTONIC) - wall;
+    stats.time.add(ms);
+    stats.wall_ms += ms;
+    stats.cpu_ms += now_ms(CLOCK_THREAD_CPUTIME_ID) - cpu;
+  }
+
+private:
+  StageStats &stats;
+  double wall;
+  double cpu;
+};
+
+struct NetResult {
+  string name;
+  double fps = 0;
+  double cpu_util = 0;
+  LatencyStats latency;
+  StageStats stages[NUM_STAGES];
+};
+
+/* One frame in flight: the input and output of the network and where the
+ * frame started
+ */
+class BenchPipe {
+public:
+  virtual ~BenchPipe() {}
+  virtual char *input() = 0;
+  virtual const char *output() = 0;
+  virtual void start(uint32_t frame) = 0;
+  virtual void wait() = 0;
+  double start_ms = 0;
+  bool busy = false;
+};
+
+#ifdef REPLAY_HOST
+/* Stand-in for a network: an output of the right shape, derived from the
+ * input so that the postprocessing has something to chew on
+ */
+class StandInPipe : public BenchPipe {
+public:
+  StandInPipe(const net_spec_t &spec)
+    : spec(spec), in(spec.in_w * spec.in_h * 3), out(spec.out_size),
+      frame(0) {}
+  char *input() override { return in.data(); }
+  const char *output() override { return out.data(); }
+  void start(uint32_t f) override { frame = f; }
+  void wait() override;
+
+private:
+  const net_spec_t &spec;
+  vector<char> in;
+  vector<char> out;
+  uint32_t frame;
+};
+
+void StandInPipe::wait()
+{
+  const uint8_t *src = (const uint8_t *) in.data();
+  int plane = spec.in_w * spec.in_h;
+
+  if (!strcmp(spec.net_type, "ssd")) {
+    // boxes that drift with the frame, the last entry ends the list
+    float *det = (float *) out.data();
+    int num = SSD_MAX_DETS - 1;
+    for (int i = 0; i < num; i++, det += 7) {
+      float x = ((i * 37 + frame) % 90) / 100.0f;
+      float y = ((i * 53) % 80) / 100.0f;
+      det[0] = 0;
+      det[1] = i % 4;
+      det[2] = src[(i * 7919) % plane] / 255.0f;
+      det[3] = x;
+      det[4] = y;
+      det[5] = x + 0.1f;
+      det[6] = y + 0.2f;
+    }
+    det[0] = -1;
+  }
+  else if (!strcmp(spec.net_type, "seg")) {
+    uint8_t *cls = (uint8_t *) out.data();
+    for (int i = 0; i < plane; i++)
+      cls[i] = src[i] >> 5;
+  }
+  else {
+    uint8_t *prob = (uint8_t *) out.data();
+    for (int i = 0; i < spec.out_size; i++)
+      prob[i] = src[(i * 97) % plane] >> 4;
+  }
+}
+
+static bool create_pipes(const net_spec_t &spec, int &in_w, int &in_h,
+                         int &out_size, vector<unique_ptr<BenchPipe>> &pipes)
+{
+  in_w = spec.in_w;
+  in_h = spec.in_h;
+  out_size = spec.out_size;
+  // double buffered, as the EOPs of the demo
+  for (int i = 0; i < 2; i++)
+    pipes.emplace_back(new StandInPipe(spec));
+  return true;
+}
+
+static void destroy_pipes(vector<unique_ptr<BenchPipe>> &pipes)
+{
+  pipes.clear();
+}
+#else
+class TidlPipe : public BenchPipe {
+public:
+  TidlPipe(ExecutionObjectPipeline *eop) : eop(eop) {}
+  char *input() override { return eop->GetInputBufferPtr(); }
+  const char *output() override { return eop->GetOutputBufferPtr(); }
+  void start(uint32_t frame) override {
+    eop->SetFrameIndex(frame);
+    eop->ProcessFrameStartAsync();
+  }
+  void wait() override { eop->ProcessFrameWait(); }
+
+private:
+  ExecutionObjectPipeline *eop;
+};
+
+static Executor *e_eve = nullptr, *e_dsp = nullptr;
+static vector<ExecutionObjectPipeline *> eops;
+
+// layers_group_id 0 runs the full network
+static Executor *create_executor(DeviceType dt, uint32_t num,
+                                 const Configuration &c, int layers_group_id)
+{
+  if (num == 0)
+    return nullptr;
+  DeviceIds ids;
+  for (uint32_t i = 0; i < num; i++)
+    ids.insert(static_cast<DeviceId>(i));
+  if (layers_group_id == 0)
+    return new Executor(dt, ids, c);
+  return new Executor(dt, ids, c, layers_group_id);
+}
+
+/* The EOPs of the demo: layer group 1 on the EVEs and 2 on the DSPs when
+ * there are both, otherwise the full network on every device, two EOPs per
+ * device so that reading a frame overlaps the processing of the previous one
+ */
+static bool create_pipes(const net_spec_t &spec, int &in_w, int &in_h,
+                         int &out_size, vector<unique_ptr<BenchPipe>> &pipes)
+{
+  Configuration c;
+  if (!c.ReadFromFile(spec.config)) {
+    ERROR("Error in configuration file: %s", spec.config);
+    return false;
+  }
+  uint32_t num_eves = Executor::GetNumDevices(DeviceType::EVE);
+  uint32_t num_dsps = Executor::GetNumDevices(DeviceType::DSP);
+  bool split = num_eves > 0 && num_dsps > 0 && strcmp(spec.net_type, "seg");
+  if (!split)
+    c.runFullNet = true;
+
+  try {
+    if (split) {
+      e_eve = create_executor(DeviceType::EVE, num_eves, c, 1);
+      e_dsp = create_executor(DeviceType::DSP, num_dsps, c, 2);
+      for (int j = 0; j < 2; j++)
+        for (uint32_t i = 0; i < max(num_eves, num_dsps); i++)
+          eops.push_back(new ExecutionObjectPipeline(
+            {(*e_eve)[i % num_eves], (*e_dsp)[i % num_dsps]}));
+    }
+    else {
+      e_eve = create_executor(DeviceType::EVE, num_eves, c, 0);
+      e_dsp = create_executor(DeviceType::DSP, num_dsps, c, 0);
+      for (int j = 0; j < 2; j++) {
+        for (uint32_t i = 0; i < num_eves; i++)
+          eops.push_back(new ExecutionObjectPipeline({(*e_eve)[i]}));
+        for (uint32_t i = 0; i < num_dsps; i++)
+          eops.push_back(new ExecutionObjectPipeline({(*e_dsp)[i]}));
+      }
+    }
+  }
+  catch (tidl::Exception &e) {
+    ERROR("%s: %s", spec.name, e.what());
+    return false;
+  }
+  if (eops.empty())
+    return false;
+  // input and output of every EOP from malloc_ddr, as AllocateMemory does
+  for (auto eop : eops) {
+    size_t in_size = eop->GetInputBufferSizeInBytes();
+    size_t out_size = eop->GetOutputBufferSizeInBytes();
+    ArgInfo in(malloc_ddr<char>(in_size), in_size);
+    ArgInfo out(malloc_ddr<char>(out_size), out_size);
+    eop->SetInputOutputBuffer(in, out);
+  }
+
+  in_w = c.inWidth;
+  in_h = c.inHeight;
+  out_size = eops[0]->GetOutputBufferSizeInBytes();
+  for (auto eop : eops)
+    pipes.emplace_back(new TidlPipe(eop));
+  return true;
+}
+
+static void destroy_pipes(vector<unique_ptr<BenchPipe>> &pipes)
+{
+  pipes.clear();
+  for (auto eop : eops) {
+    free_ddr(eop->GetInputBufferPtr());
+    free_ddr(eop->GetOutputBufferPtr());
+    delete eop;
+  }
+  eops.clear();
+  delete e_eve;
+  delete e_dsp;
+  e_eve = e_dsp = nullptr;
+}
+#endif
+
+/* What the WriteFrameOutput functions of the demo do: decode the output
+ * and draw it into the overlay, BGRA or for segmentation 16 bit, with the
+ * same kernels. The boxes of every class are drawn, the demo only draws
+ * the ones of its class list.
+ */
+static void postprocess(const char *net_type, const char *out, int out_size,
+                        int w, int h, float fps, void *overlay)
+{
+  if (!strcmp(net_type, "ssd")) {
+    int num_floats = out_size / sizeof(float);
+    ssd_det_t dets[num_floats / 7 + 1];
+    int num = ParseSSDOutput((const float *) out, num_floats, SSD_MIN_SCORE,
+                             w, h, dets, num_floats / 7);
+    memset(overlay, 0, w * h * 4);
+    cv::Mat frame(h, w, CV_8UC4, overlay);
+    for (int i = 0; i < num; i++) {
+      const ssd_det_t &d = dets[i];
+      int color = 64 + 48 * (d.label % 4);
+      DrawBox(frame, cv::Scalar(color, 255 - color, 255, 255),
+              "class " + to_string(d.label), (int) d.xmin, (int) d.ymin,
+              (int) d.xmax, (int) d.ymax);
+    }
+    OverlayFPS(frame, w, h, fps, 1);
+  }
+  else if (!strcmp(net_type, "seg")) {
+    ColorizeSeg((const uint8_t *) out, w * h, (uint16_t *) overlay);
+    cv::Mat frame(h, w, CV_16UC1, overlay);
+    OverlayFPS(frame, w, h, fps, 1);
+  }
+  else {
+    // the top-k and softmax of tf_postprocess
+    topk_result_t top;
+    topk_u8((const uint8_t *) out, out_size, TOP_CANDIDATES, &top);
+    float prob = topk_softmax_prob(top.val[0], top.val[0],
+      topk_softmax_denom((const uint8_t *) out, out_size, top.val[0]));
+    memset(overlay, 0, w * h * 4);
+    cv::Mat frame(h, w, CV_8UC4, overlay);
+    char label[32];
+    snprintf(label, sizeof(label), "class %d %.2f", top.idx[0], prob);
+    DrawClassLabel(frame, label, 0, 0.6);
+    OverlayFPS(frame, w, h, fps, 0.45);
+  }
+}
+
+static bool run_net(const net_spec_t &spec, CaptureReader &cap, int frames,
+                    NetResult &res)
+{
+  vector<unique_ptr<BenchPipe>> pipes;
+  int in_w, in_h, out_size;
+  if (!create_pipes(spec, in_w, in_h, out_size, pipes)) {
+    destroy_pipes(pipes);
+    return false;
+  }
+
+  const capture_file_header_t &fmt = cap.format();
+  vector<uint8_t> raw(fmt.frame_size);
+  vector<uint8_t> bgrx(in_w * in_h * 4);
+  // 16 bit for segmentation, as the overlay plane of the demo
+  int overlay_size = in_w * in_h * (strcmp(spec.net_type, "seg") ? 4 : 2);
+  vector<uint8_t> overlay(overlay_size), scanout(overlay_size);
+  uint32_t num = pipes.size();
+  float fps = 0;
+  StageStats *st = res.stages;
+
+  res.name = spec.name;
+  double wall0 = now_ms(CLOCK_MONOTONIC), cpu0 = process_cpu_ms();
+  for (uint32_t f = 0; f < (uint32_t) frames + num; f++) {
+    BenchPipe &p = *pipes[f % num];
+    if (p.busy) {
+      {
+        StageTimer t(st[ST_NETWORK]);
+        p.wait();
+      }
+      {
+        StageTimer t(st[ST_POSTPROCESS]);
+        postprocess(spec.net_type, p.output(), out_size, in_w, in_h, fps,
+                    overlay.data());
+      }
+      {
+        StageTimer t(st[ST_DISPLAY]);
+        memcpy(scanout.data(), overlay.data(), overlay.size());
+      }
+      res.latency.add(now_ms(CLOCK_MONOTONIC) - p.start_ms);
+      fps = (f - num + 1) * 1000.0 / (now_ms(CLOCK_MONOTONIC) - wall0);
+      p.busy = false;
+    }
+    if (f >= (uint32_t) frames)
+      continue;
+
+    p.start_ms = now_ms(CLOCK_MONOTONIC);
+    {
+      StageTimer t(st[ST_CAPTURE]);
+      if (!cap.read(raw.data())) {
+        ERROR("Could not read frame %u of the capture", f);
+        destroy_pipes(pipes);
+        return false;
+      }
+    }
+    {
+      StageTimer t(st[ST_VPE]);
+      crop_resize_yuyv_to_bgrx(raw.data(), fmt.width, fmt.height, 0, 0,
+                               fmt.width, fmt.height, bgrx.data(), in_w,
+                               in_h, in_w * 4);
+    }
+    {
+      StageTimer t(st[ST_PREPROCESS]);
+      SplitToPlanar(bgrx.data(), in_w, in_h, p.input());
+    }
+    p.start(f);
+    p.busy = true;
+  }
+  double wall = now_ms(CLOCK_MONOTONIC) - wall0;
+  res.fps = frames * 1000.0 / wall;
+  res.cpu_util = (process_cpu_ms() - cpu0) / wall;
+  destroy_pipes(pipes);
+  return true;
+}
+
+static bool write_results(const string &path, const string &capture,
+                          int frames, const vector<NetResult> &results)
+{
+  FILE *fp = path == "-" ? stdout : fopen(path.c_str(), "w");
+  if (!fp) {
+    ERROR("Could not open %s: %s", path.c_str(), strerror(errno));
+    return false;
+  }
+  // one value per line, load_results() depends on it
+  fprintf(fp, "{\n  \"capture\": \"%s\",\n  \"frames\": %d,\n"
+          "  \"results\": {\n", capture.c_str(), frames);
+  for (size_t r = 0; r < results.size(); r++) {
+    const NetResult &n = results[r];
+    fprintf(fp, "    \"%s\": {\n", n.name.c_str());
+    fprintf(fp, "      \"fps\": %.2f,\n", n.fps);
+    fprintf(fp, "      \"latency_p50_ms\": %.2f,\n", n.latency.percentile(50));
+    fprintf(fp, "      \"latency_p99_ms\": %.2f,\n", n.latency.percentile(99));
+    fprintf(fp, "      \"cpu_util\": %.3f,\n", n.cpu_util);
+    fprintf(fp, "      \"stages\": {\n");
+    for (int s = 0; s < NUM_STAGES; s++) {
+      const StageStats &st = n.stages[s];
+      fprintf(fp, "        \"%s\": {\"mean_ms\": %.3f, \"p50_ms\": %.2f, "
+              "\"p99_ms\": %.2f, \"cpu_util\": %.3f}%s\n", stage_names[s],
+              st.time.mean(), st.time.percentile(50), st.time.percentile(99),
+              st.wall_ms > 0 ? st.cpu_ms / st.wall_ms : 0,
+              s < NUM_STAGES - 1 ? "," : "");
+    }
+    fprintf(fp, "      }\n    }%s\n", r < results.size() - 1 ? "," : "");
+  }
+  fprintf(fp, "  }\n}\n");
+  if (fp != stdout)
+    fclose(fp);
+  return true;
+}
+
+/* The per network values of a file written by write_results(), keyed by
+ * network and then by name ("fps", "latency_p99_ms", ...)
+ */
+typedef map<string, map<string, double>> baseline_t;
+
+static bool load_results(const string &path, baseline_t &base)
+{
+  FILE *fp = fopen(path.c_str(), "r");
+  if (!fp) {
+    ERROR("Could not open %s: %s", path.c_str(), strerror(errno));
+    return false;
+  }
+  char line[512], key[64];
+  double value;
+  string net;
+  bool in_results = false;
+  while (fgets(line, sizeof(line), fp)) {
+    int indent = strspn(line, " ");
+    if (indent == 2)
+      in_results = strstr(line, "\"results\"") != NULL;
+    else if (in_results && indent == 4 &&
+             sscanf(line + indent, "\"%63[^\"]\": {", key) == 1)
+      net = key;
+    else if (in_results && indent == 6 && net != "" &&
+             sscanf(line + indent, "\"%63[^\"]\": %lf", key, &value) == 2)
+      base[net][key] = value;
+  }
+  fclose(fp);
+  if (base.empty()) {
+    ERROR("No results in %s", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Number of regressions beyond tolerance percent
+static int compare(const vector<NetResult> &results, const baseline_t &base,
+                   double tolerance)
+{
+  int regressions = 0;
+  double t = tolerance / 100;
+
+  printf("\n%-14s %17s %23s %23s\n", "network", "fps (base)",
+         "p50 ms (base)", "p99 ms (base)");
+  for (const NetResult &n : results) {
+    auto b = base.find(n.name);
+    if (b == base.end()) {
+      printf("%-14s not in the baseline\n", n.name.c_str());
+      continue;
+    }
+    auto get = [&b](const char *key) {
+      auto v = b->second.find(key);
+      return v == b->second.end() ? 0.0 : v->second;
+    };
+    double fps = get("fps"), p50 = get("latency_p50_ms"),
+           p99 = get("latency_p99_ms");
+    bool slow = fps > 0 && n.fps < fps * (1 - t);
+    bool late = (p50 > 0 && n.latency.percentile(50) > p50 * (1 + t)) ||
+                (p99 > 0 && n.latency.percentile(99) > p99 * (1 + t));
+    printf("%-14s %8.2f (%6.2f) %12.2f (%8.2f) %12.2f (%8.2f)%s\n",
+           n.name.c_str(), n.fps, fps, n.latency.percentile(50), p50,
+           n.latency.percentile(99), p99,
+           slow || late ? "  REGRESSION" : "");
+    regressions += slow || late;
+  }
+  return regressions;
+}
+
+static void usage()
+{
+  printf("Usage: replay_bench <capture> [options]\n"
+         "  <capture>          file recorded with accelerated_tidl --record\n"
+         "  --nets <a,b,..>    networks to run (default all:");
+  for (int i = 0; i < num_net_specs; i++)
+    printf(" %s", net_specs[i].name);
+  printf(")\n"
+         "  --frames <n>       frames per network (default %d)\n"
+         "  --out <file>       write the results as JSON, - for stdout\n"
+         "  --baseline <file>  results of an earlier run to compare against\n"
+         "  --tolerance <pct>  allowed FPS drop and latency rise (default "
+         "%.0f)\n", DEFAULT_FRAMES, DEFAULT_TOLERANCE);
+}
+
+int main(int argc, char *argv[])
+{
+  string capture, nets, out, baseline;
+  int frames = DEFAULT_FRAMES;
+  double tolerance = DEFAULT_TOLERANCE;
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--nets" && has_value)            nets = argv[++i];
+    else if (arg == "--frames" && has_value)     frames = atoi(argv[++i]);
+    else if (arg == "--out" && has_value)        out = argv[++i];
+    else if (arg == "--baseline" && has_value)   baseline = argv[++i];
+    else if (arg == "--tolerance" && has_value)  tolerance = atof(argv[++i]);
+    else if (arg[0] != '-' && capture == "")     capture = arg;
+    else {
+      usage();
+      return EXIT_FAILURE;
+    }
+  }
+  if (capture == "" || frames <= 0) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  CaptureReader cap;
+  if (!cap.open(capture))
+    return EXIT_FAILURE;
+  const capture_file_header_t &fmt = cap.format();
+  if (fmt.fourcc != FOURCC_STR("YUYV")) {
+    ERROR("Only YUYV captures can be replayed");
+    return EXIT_FAILURE;
+  }
+  MSG("Replaying %u frames of %ux%u from %s, %d frames per network",
+      cap.num_frames(), fmt.width, fmt.height, capture.c_str(), frames);
+
+  topk_softmax_init(0.25f);
+  vector<NetResult> results;
+  for (int i = 0; i < num_net_specs; i++) {
+    const net_spec_t &spec = net_specs[i];
+    if (nets != "" && ("," + nets + ",").find(string(",") + spec.name + ",") ==
+                      string::npos)
+      continue;
+    results.emplace_back();
+    if (!run_net(spec, cap, frames, results.back())) {
+      ERROR("%s could not be run", spec.name);
+      return EXIT_FAILURE;
+    }
+    const NetResult &r = results.back();
+    MSG("\n%s: %.2f fps, CPU %.0f%%", spec.name, r.fps, r.cpu_util * 100);
+    r.latency.report("frame latency");
+    for (int s = 0; s < NUM_STAGES; s++)
+      r.stages[s].time.report(stage_names[s]);
+  }
+  if (results.empty()) {
+    ERROR("No network matches --nets %s", nets.c_str());
+    return EXIT_FAILURE;
+  }
+
+  if (out != "" && !write_results(out, capture, frames, results))
+    return EXIT_FAILURE;
+  if (baseline != "") {
+    baseline_t base;
+    if (!load_results(baseline, base))
+      return EXIT_FAILURE;
+    int regressions = compare(results, base, tolerance);
+    if (regressions) {
+      printf("%d network(s) regressed by more than %.0f%%\n", regressions,
+             tolerance);
+      return EXIT_FAILURE;
+    }
+    printf("No regression beyond %.0f%%\n", tolerance);
+  }
+  return EXIT_SUCCESS;
+}
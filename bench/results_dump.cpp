@@ -0,0 +1,120 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/* Reference consumer of the results ring of "accelerated_tidl
+ * --results-shm <name>": prints every record as it comes in, and how many
+ * were overwritten before they could be read.
+ *
+ *   make results_dump && ./results_dump /tidl_results [--frames <n>]
+ *
+ * The ring is polled, reading it takes no system call.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include "../results_ring.h"
+
+using namespace std;
+
+// how often the ring is looked at when it had nothing new
+#define POLL_US 2000
+
+static uint64_t now_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int main(int argc, char *argv[])
+{
+  string name;
+  long frames = -1;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+      frames = atol(argv[++i]);
+    else if (name == "" && argv[i][0] == '/')
+      name = argv[i];
+    else
+      name = "";
+  }
+  if (name == "") {
+    printf("Usage: results_dump /<shm name> [--frames <n>]\n");
+    return EXIT_FAILURE;
+  }
+
+  ResultsReader ring;
+  if (!ring.open(name))
+    return EXIT_FAILURE;
+
+  results_record_t rec;
+  uint64_t lost = 0;
+  for (long n = 0; frames < 0 || n < frames; ) {
+    if (!ring.read(rec)) {
+      usleep(POLL_US);
+      continue;
+    }
+    n++;
+    if (ring.num_lost() != lost) {
+      printf("%llu records overwritten before they were read\n",
+             (unsigned long long) (ring.num_lost() - lost));
+      lost = ring.num_lost();
+    }
+    printf("#%llu frame %u capture %u: %.1f ms after the capture, read "
+           "%.1f ms after the results", (unsigned long long) rec.record,
+           rec.frame_id, rec.capture_sequence,
+           rec.capture_us ? (rec.result_us - rec.capture_us) / 1000.0 : 0.0,
+           (now_us() - rec.result_us) / 1000.0);
+    const uint8_t *mask = ring.mask(rec);
+    if (mask) {
+      // the share of the pixels of each class, if it is still there
+      uint32_t count[256] = {0};
+      for (uint32_t i = 0; i < rec.mask_width * rec.mask_height; i++)
+        count[mask[i]]++;
+      if (ring.still_valid(rec)) {
+        printf(", %ux%u mask:", rec.mask_width, rec.mask_height);
+        for (int c = 0; c < 256; c++)
+          if (count[c])
+            printf(" %d=%.1f%%", c,
+                   100.0 * count[c] / (rec.mask_width * rec.mask_height));
+      }
+      else
+        printf(", mask overwritten");
+    }
+    printf("\n");
+    for (uint32_t b = 0; b < rec.num_boxes; b++)
+      printf("  label %3d score %.2f (%.3f, %.3f) -> (%.3f, %.3f)\n",
+             rec.boxes[b].label, rec.boxes[b].score, rec.boxes[b].xmin,
+             rec.boxes[b].ymin, rec.boxes[b].xmax, rec.boxes[b].ymax);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+/* Benchmark of the classification top-k kernel against the priority_queue
+ * implementation it replaced, for 1000 and 1001 class outputs.
+ *
+ *   make topk_bench && ./topk_bench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <queue>
+#include <vector>
+#include <chrono>
+#include "../topk.h"
+
+using namespace std;
+using namespace chrono;
+
+typedef pair<uint8_t, int> val_index;
+
+static void topk_queue(const uint8_t *in, int size, int k, vector<val_index> &sorted)
+{
+  auto cmp = [](val_index &left, val_index &right) { return left.first > right.first; };
+  priority_queue<val_index, vector<val_index>, decltype(cmp)> queue(cmp);
+  for (int i = 0; i < k; i++)
+    queue.push(val_index(in[i], i));
+  for (int i = k; i < size; i++) {
+    if (in[i] > queue.top().first) {
+      queue.pop();
+      queue.push(val_index(in[i], i));
+    }
+  }
+  sorted.clear();
+  while (!queue.empty()) {
+    sorted.push_back(queue.top());
+    queue.pop();
+  }
+}
+
+/* Softmax outputs are mostly close to zero with a handful of peaks */
+static void fill_output(uint8_t *out, int size)
+{
+  for (int i = 0; i < size; i++)
+    out[i] = rand() % 4;
+  for (int p = 0; p < 5; p++)
+    out[rand() % size] = 32 + rand() % 224;
+}
+
+static bool same_result(const topk_result_t &res, const vector<val_index> &sorted)
+{
+  for (int i = 0; i < res.k; i++) {
+    const val_index &q = sorted[res.k - 1 - i];
+    if (q.first != res.val[i])
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+  const int sizes[] = {1000, 1001};
+  const int k = 3;
+  const int num_outputs = 64;
+
+  topk_softmax_init(0.25f);
+
+  for (int size : sizes) {
+    vector<uint8_t> outputs(num_outputs * size);
+    for (int o = 0; o < num_outputs; o++)
+      fill_output(&outputs[o * size], size);
+
+    vector<val_index> sorted;
+    topk_result_t res;
+    volatile int sink = 0;
+    volatile float fsink = 0;
+
+    for (int o = 0; o < num_outputs; o++) {
+      topk_queue(&outputs[o * size], size, k, sorted);
+      topk_u8(&outputs[o * size], size, k, &res);
+      if (!same_result(res, sorted)) {
+        printf("MISMATCH for output %d of size %d\n", o, size);
+        return EXIT_FAILURE;
+      }
+    }
+
+    auto t0 = steady_clock::now();
+    for (int it = 0; it < iterations; it++) {
+      topk_queue(&outputs[(it % num_outputs) * size], size, k, sorted);
+      sink += sorted[k - 1].second;
+    }
+    auto t1 = steady_clock::now();
+    for (int it = 0; it < iterations; it++) {
+      topk_u8(&outputs[(it % num_outputs) * size], size, k, &res);
+      sink += res.idx[0];
+    }
+    auto t2 = steady_clock::now();
+    for (int it = 0; it < iterations; it++) {
+      const uint8_t *in = &outputs[(it % num_outputs) * size];
+      topk_u8(in, size, k, &res);
+      float denom = topk_softmax_denom(in, size, res.val[0]);
+      fsink = fsink + topk_softmax_prob(res.val[0], res.val[0], denom);
+    }
+    auto t3 = steady_clock::now();
+
+    double q_us = duration<double, micro>(t1 - t0).count() / iterations;
+    double t_us = duration<double, micro>(t2 - t1).count() / iterations;
+    double s_us = duration<double, micro>(t3 - t2).count() / iterations;
+    printf("%4d classes: priority_queue %7.3f us, topk_u8 %7.3f us (%.1fx), "
+           "topk_u8 + softmax %7.3f us\n", size, q_us, t_us, q_us / t_us, s_us);
+    (void) sink;
+    (void) fsink;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,229 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+extern "C" {
+  #include <omap_drm.h>
+  #include <omap_drmif.h>
+  #include <xf86drmMode.h>
+}
+#include "buffer_pool.h"
+#include "cmem_slab.h"
+#include "error.h"
+
+unsigned int BufferPool::num_live = 0;
+size_t BufferPool::live_bytes = 0;
+size_t BufferPool::peak_bytes = 0;
+unsigned int BufferPool::num_allocs = 0;
+
+/* Buffers in the CMEM slab only have their own range maintained */
+CpuAccess cpu_access(const DmaBuffer *buf, uint32_t flags)
+{
+  if (cmem_slab.contains(buf->cmem_buf))
+    return CpuAccess(buf->cmem_buf, buf->pitches[0] * buf->height, flags);
+  return CpuAccess(buf->fd[0], flags);
+}
+
+/* Allocate n buffers of w x h pixels. Whatever the pool held before is
+ * freed first.
+ */
+bool BufferPool::alloc(struct omap_device *_dev, unsigned int n,
+                       uint32_t fourcc, uint32_t w, uint32_t h,
+                       uint32_t bytes_pp, BufferMemory mem)
+{
+  release();
+  dev = _dev;
+  for (unsigned int i = 0; i < n; i++) {
+    DmaBuffer *buf = alloc_buffer(fourcc, w, h, bytes_pp, mem);
+    if (!buf) {
+      ERROR("Allocation of buffer %u of %u (%ux%u) failed", i, n, w, h);
+      release();
+      return false;
+    }
+    bufs.push_back(buf);
+  }
+  return true;
+}
+
+DmaBuffer *BufferPool::alloc_buffer(uint32_t fourcc, uint32_t w, uint32_t h,
+                                    uint32_t bytes_pp, BufferMemory mem)
+{
+  size_t size = (size_t) w * h * bytes_pp;
+  DmaBuffer *buf = (DmaBuffer *) calloc(1, sizeof(DmaBuffer));
+  if (!buf)
+    return NULL;
+  buf->bo = (struct omap_bo **) calloc(4, sizeof(struct omap_bo *));
+  buf->buf_mem_addr = (void **) calloc(4, sizeof(void *));
+  if (!buf->bo || !buf->buf_mem_addr) {
+    free_buffer(buf);
+    return NULL;
+  }
+  buf->fourcc = fourcc;
+  buf->width = w;
+  buf->height = h;
+  buf->num_buffer_objects = 1;
+  buf->pitches[0] = w * bytes_pp;
+  for (int i = 0; i < 4; i++)
+    buf->fd[i] = -1;
+
+  if (mem == BUF_CMEM_SLAB) {
+    /* a framebuffer at an offset of the buffer object of the whole slab,
+     * every buffer in it holds a reference to that object
+     */
+    buf->cmem_buf = cmem_slab.alloc(size);
+    if (buf->cmem_buf)
+      buf->bo[0] = omap_bo_from_dmabuf(dev, cmem_slab.region_fd());
+    if (buf->cmem_buf && !buf->bo[0]) {
+      free_buffer(buf);
+      return NULL;
+    }
+    if (!buf->cmem_buf)
+      mem = BUF_CMEM;
+  }
+  if (mem == BUF_CMEM) {
+    buf->fd[0] = cmem_slab.alloc_exported(size, &buf->cmem_buf);
+    if (buf->fd[0] < 0) {
+      free_buffer(buf);
+      return NULL;
+    }
+  }
+  if (mem == BUF_OMAP) {
+    buf->bo[0] = omap_bo_new(dev, size, OMAP_BO_SCANOUT | OMAP_BO_WC);
+    if (!buf->bo[0]) {
+      free_buffer(buf);
+      return NULL;
+    }
+    buf->fd[0] = omap_bo_dmabuf(buf->bo[0]);
+    buf->buf_mem_addr[0] = omap_bo_map(buf->bo[0]);
+  }
+  else {
+    // the CPU goes through the cached CMEM mapping, see CpuAccess
+    buf->buf_mem_addr[0] = buf->cmem_buf;
+  }
+
+  bytes += size;
+  num_live++;
+  num_allocs++;
+  live_bytes += size;
+  if (live_bytes > peak_bytes)
+    peak_bytes = live_bytes;
+  return buf;
+}
+
+bool BufferPool::add_framebuffers(int _drm_fd)
+{
+  drm_fd = _drm_fd;
+  for (auto buf : bufs) {
+    uint32_t bo_handles[4] = {0}, offsets[4] = {0};
+
+    if (!buf->bo[0])
+      buf->bo[0] = omap_bo_from_dmabuf(dev, buf->fd[0]);
+    if (!buf->bo[0]) {
+      ERROR("Could not import dmabuf %d into omapdrm", buf->fd[0]);
+      return false;
+    }
+    bo_handles[0] = omap_bo_handle(buf->bo[0]);
+    if (cmem_slab.contains(buf->cmem_buf))
+      offsets[0] = cmem_slab.offset_of(buf->cmem_buf);
+
+    int ret = drmModeAddFB2(drm_fd, buf->width, buf->height, buf->fourcc,
+                            bo_handles, buf->pitches, offsets, &buf->fb_id, 0);
+    if (ret) {
+      ERROR("drmModeAddFB2 failed: %s (%d)", strerror(errno), ret);
+      return false;
+    }
+    DBG("fb %u: %ux%u, handle %u at offset %u", buf->fb_id, buf->width,
+        buf->height, bo_handles[0], offsets[0]);
+  }
+  return true;
+}
+
+void BufferPool::clear()
+{
+  for (auto buf : bufs) {
+    CpuAccess access = cpu_access(buf, DMA_BUF_SYNC_WRITE);
+    memset(buf->buf_mem_addr[0], 0, buf->pitches[0] * buf->height);
+  }
+}
+
+void BufferPool::free_buffer(DmaBuffer *buf)
+{
+  if (buf->fb_id)
+    drmModeRmFB(drm_fd, buf->fb_id);
+  if (buf->bo && buf->bo[0])
+    omap_bo_del(buf->bo[0]);
+  if (cmem_slab.contains(buf->cmem_buf))
+    cmem_slab.free(buf->cmem_buf);
+  else if (buf->cmem_buf)
+    // the dmabuf stays open in the slab for the next buffer of this size
+    cmem_slab.free_exported(buf->cmem_buf);
+  else if (buf->fd[0] >= 0)
+    close(buf->fd[0]);
+  free(buf->bo);
+  free(buf->buf_mem_addr);
+  free(buf);
+}
+
+void BufferPool::release()
+{
+  for (auto buf : bufs)
+    free_buffer(buf);
+  num_live -= bufs.size();
+  live_bytes -= bytes;
+  bufs.clear();
+  bytes = 0;
+  drm_fd = -1;
+}
+
+// exchange the buffers, e.g. to free the old ones once the new are in use
+void BufferPool::swap(BufferPool &other)
+{
+  std::swap(bufs, other.bufs);
+  std::swap(dev, other.dev);
+  std::swap(drm_fd, other.drm_fd);
+  std::swap(bytes, other.bytes);
+}
+
+void BufferPool::fds(int *fds) const
+{
+  for (unsigned int i = 0; i < bufs.size(); i++)
+    fds[i] = bufs[i]->fd[0];
+}
+
+/* What all pools hold, it comes back to the same value after every
+ * reconfiguration unless buffers leak
+ */
+void BufferPool::report()
+{
+  MSG("Buffer pools: %u buffers, %zu KB, peak %zu KB, %u allocated in total",
+      num_live, live_bytes >> 10, peak_bytes >> 10, num_allocs);
+}
@@ -0,0 +1,113 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "cmem_buf.h"
+
+struct omap_device;
+struct omap_bo;
+
+class DmaBuffer {
+public:
+	uint32_t fourcc, width, height;
+	int num_buffer_objects;
+	void *cmem_buf;
+	/* The [4]'s are due to the fact that the DSS can  support up to 4 planes of
+	 * operation. If the user wants to populate the second plane, they may place
+	 * the data in [1], [2], or [3]
+	 */
+	struct omap_bo **bo;
+	void **buf_mem_addr;
+	uint32_t pitches[4];
+	int fd[4];		/* dmabuf */
+	unsigned fb_id;
+};
+
+// CPU access to the memory of buf, for as long as the guard lives
+CpuAccess cpu_access(const DmaBuffer *buf, uint32_t flags);
+
+// where the buffers of a pool come from
+enum BufferMemory {
+  BUF_OMAP,       // omapdrm scanout buffers, write-combined
+  BUF_CMEM,       // CMEM, a dmabuf per buffer as V4L2 needs it
+  BUF_CMEM_SLAB   // carved out of the CMEM slab if it fits, display only
+};
+
+/* A set of buffers of one size and format that are allocated, exported as
+ * dmabufs, registered as DRM framebuffers and freed together. The pool owns
+ * all of it: a buffer lives as long as its pool, which frees it when it is
+ * released, destroyed or swapped out. V4L2 devices import the buffers with
+ * the dmabufs of fds(), they must have released them (REQBUFS 0 or closed)
+ * before the pool goes. The footprint of all pools is kept for report().
+ */
+class BufferPool {
+public:
+  BufferPool() : dev(NULL), drm_fd(-1), bytes(0) {}
+  ~BufferPool() { release(); }
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  bool alloc(struct omap_device *dev, unsigned int n, uint32_t fourcc,
+             uint32_t w, uint32_t h, uint32_t bytes_pp, BufferMemory mem);
+  // DRM framebuffers of all buffers, freed with them
+  bool add_framebuffers(int drm_fd);
+  // black, or transparent for the overlay formats
+  void clear();
+  void release();
+  void swap(BufferPool &other);
+
+  unsigned int size() const { return bufs.size(); }
+  DmaBuffer *operator[](unsigned int i) const { return bufs[i]; }
+  DmaBuffer **data() { return bufs.data(); }
+  void fds(int *fds) const;
+
+  static void report();
+  static unsigned int live_buffers() { return num_live; }
+  static size_t total_bytes() { return live_bytes; }
+
+private:
+  DmaBuffer *alloc_buffer(uint32_t fourcc, uint32_t w, uint32_t h,
+                          uint32_t bytes_pp, BufferMemory mem);
+  void free_buffer(DmaBuffer *buf);
+  std::vector<DmaBuffer *> bufs;
+  struct omap_device *dev;
+  int drm_fd;
+  size_t bytes;
+
+  static unsigned int num_live;
+  static size_t live_bytes;
+  static size_t peak_bytes;
+  static unsigned int num_allocs;
+};
+
+#endif // BUFFER_POOL_H
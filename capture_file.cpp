@@ -0,0 +1,146 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <string.h>
+#include <sys/stat.h>
+#include "capture_file.h"
+#include "error.h"
+
+bool CaptureWriter::open(const std::string &path, uint32_t width,
+                         uint32_t height, uint32_t fourcc, uint32_t frame_size)
+{
+  close();
+  fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    ERROR("Could not open %s: %s", path.c_str(), strerror(errno));
+    return false;
+  }
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CAPTURE_FILE_MAGIC, sizeof(header.magic));
+  header.width = width;
+  header.height = height;
+  header.fourcc = fourcc;
+  header.frame_size = frame_size;
+  frames = 0;
+  if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+    ERROR("Could not write to %s: %s", path.c_str(), strerror(errno));
+    close();
+    return false;
+  }
+  MSG("Recording %ux%u %.4s captures to %s", width, height,
+      (const char *) &fourcc, path.c_str());
+  return true;
+}
+
+bool CaptureWriter::write(const void *frame, const capture_frame_info_t &info)
+{
+  if (!fp)
+    return false;
+  if (fwrite(&info, sizeof(info), 1, fp) != 1 ||
+      fwrite(frame, header.frame_size, 1, fp) != 1) {
+    ERROR("Recording stopped after %u frames: %s", frames, strerror(errno));
+    close();
+    return false;
+  }
+  frames++;
+  return true;
+}
+
+void CaptureWriter::close()
+{
+  if (!fp)
+    return;
+  fclose(fp);
+  fp = NULL;
+  MSG("%u captures recorded", frames);
+}
+
+bool CaptureReader::open(const std::string &path)
+{
+  struct stat st;
+
+  close();
+  fp = fopen(path.c_str(), "rb");
+  if (!fp || fstat(fileno(fp), &st) < 0) {
+    ERROR("Could not open %s: %s", path.c_str(), strerror(errno));
+    close();
+    return false;
+  }
+  if (fread(&header, sizeof(header), 1, fp) != 1 ||
+      (memcmp(header.magic, CAPTURE_FILE_MAGIC, sizeof(header.magic)) != 0 &&
+       memcmp(header.magic, CAPTURE_FILE_MAGIC_V1, sizeof(header.magic)) != 0) ||
+      header.frame_size == 0) {
+    ERROR("%s is not a capture recorded with --record", path.c_str());
+    close();
+    return false;
+  }
+  has_info = memcmp(header.magic, CAPTURE_FILE_MAGIC, sizeof(header.magic)) == 0;
+  num = (st.st_size - sizeof(header)) /
+        (header.frame_size + (has_info ? sizeof(capture_frame_info_t) : 0));
+  next = 0;
+  if (num == 0) {
+    ERROR("%s holds no complete frame", path.c_str());
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool CaptureReader::read(void *dst, capture_frame_info_t *info)
+{
+  capture_frame_info_t frame_info;
+
+  if (!fp)
+    return false;
+  if (next == num) {
+    fseek(fp, sizeof(header), SEEK_SET);
+    next = 0;
+  }
+  if (has_info) {
+    if (fread(&frame_info, sizeof(frame_info), 1, fp) != 1)
+      return false;
+  }
+  else {
+    memset(&frame_info, 0, sizeof(frame_info));
+    frame_info.sequence = next;
+  }
+  if (fread(dst, header.frame_size, 1, fp) != 1)
+    return false;
+  if (info)
+    *info = frame_info;
+  next++;
+  return true;
+}
+
+void CaptureReader::close()
+{
+  if (fp)
+    fclose(fp);
+  fp = NULL;
+  num = 0;
+}
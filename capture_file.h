@@ -0,0 +1,106 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+/* Raw captures as the VIP delivers them, recorded with --record and
+ * replayed by bench/replay_bench, or the overlays dumped at every flip with
+ * --display-dump: a header followed by a capture_frame_info_t and
+ * frame_size bytes per frame. Files of the first version have no frame info.
+ */
+#define CAPTURE_FILE_MAGIC    "ATCAP02"
+#define CAPTURE_FILE_MAGIC_V1 "ATCAP01"
+
+typedef struct capture_file_header_t_ {
+  char     magic[8];
+  uint32_t width;
+  uint32_t height;
+  uint32_t fourcc;
+  uint32_t frame_size;
+} capture_file_header_t;
+
+/* The V4L2 sequence and timestamp of the capture, CLOCK_MONOTONIC in us.
+ * For a dumped overlay, the capture is the one whose results it shows and
+ * display_us the time of the flip, else display_us is capture_us.
+ */
+typedef struct capture_frame_info_t_ {
+  uint32_t sequence;
+  uint32_t reserved;
+  uint64_t capture_us;
+  uint64_t display_us;
+} capture_frame_info_t;
+
+class CaptureWriter {
+public:
+  CaptureWriter() : fp(NULL), frames(0) {}
+  ~CaptureWriter() { close(); }
+  CaptureWriter(const CaptureWriter &) = delete;
+  CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+  bool open(const std::string &path, uint32_t width, uint32_t height,
+            uint32_t fourcc, uint32_t frame_size);
+  bool is_open() const { return fp != NULL; }
+  bool write(const void *frame, const capture_frame_info_t &info);
+  void close();
+
+private:
+  FILE *fp;
+  capture_file_header_t header;
+  uint32_t frames;
+};
+
+class CaptureReader {
+public:
+  CaptureReader() : fp(NULL), has_info(false), num(0), next(0) {}
+  ~CaptureReader() { close(); }
+  CaptureReader(const CaptureReader &) = delete;
+  CaptureReader &operator=(const CaptureReader &) = delete;
+
+  bool open(const std::string &path);
+  const capture_file_header_t &format() const { return header; }
+  uint32_t num_frames() const { return num; }
+  /* The next frame into dst, starting over after the last one. info is
+   * zero but for the sequence (the frame number) with files of version 1.
+   */
+  bool read(void *dst, capture_frame_info_t *info = NULL);
+  void close();
+
+private:
+  FILE *fp;
+  capture_file_header_t header;
+  bool has_info;
+  uint32_t num;
+  uint32_t next;
+};
+
+#endif // CAPTURE_FILE_H
@@ -0,0 +1,107 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <chrono>
+#include "capture_stats.h"
+#include "error.h"
+
+double capture_stats_now_ms() {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CaptureStats::CaptureStats() {
+  stream_on(0);
+}
+
+void CaptureStats::stream_on(int num_buffers) {
+  m_num_buffers = num_buffers;
+  m_frames = 0;
+  m_lost = 0;
+  m_gaps = 0;
+  m_starved = 0;
+  m_have_seq = false;
+  m_last_seq = 0;
+  m_last_ts_us = 0;
+  m_dqbuf_wait.reset();
+  m_out_of_driver.reset();
+  // buffers queued before stream on are with the driver
+  m_held = 0;
+  for (int i = 0; i < VIDEO_MAX_FRAME; i++)
+    m_dequeued_at[i] = 0;
+}
+
+void CaptureStats::dequeued(const v4l2_buffer &buf, double wait_ms) {
+  double now = capture_stats_now_ms();
+  m_frames++;
+  m_dqbuf_wait.add(wait_ms);
+
+  if (m_have_seq && buf.sequence != m_last_seq + 1) {
+    uint32_t missing = buf.sequence - m_last_seq - 1;
+    // a sequence that went backwards is a restart, not a gap
+    if ((int32_t) missing > 0) {
+      m_gaps++;
+      m_lost += missing;
+      LOGW("capture sequence gap: %u frame(s) lost before #%u", missing,
+           buf.sequence);
+    }
+  }
+  m_have_seq = true;
+  m_last_seq = buf.sequence;
+  if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+      V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+    m_last_ts_us = (uint64_t) buf.timestamp.tv_sec * 1000000 +
+                   buf.timestamp.tv_usec;
+  else
+    m_last_ts_us = 0;
+
+  if (buf.index < VIDEO_MAX_FRAME && m_dequeued_at[buf.index] == 0) {
+    m_dequeued_at[buf.index] = now;
+    m_held++;
+  }
+  if (m_num_buffers > 0 && m_held >= m_num_buffers)
+    m_starved++;
+}
+
+void CaptureStats::queued(int index) {
+  if (index < 0 || index >= VIDEO_MAX_FRAME || m_dequeued_at[index] == 0)
+    return;
+  m_out_of_driver.add(capture_stats_now_ms() - m_dequeued_at[index]);
+  m_dequeued_at[index] = 0;
+  m_held--;
+}
+
+void CaptureStats::report(const char *name) const {
+  MSG("%s: %llu frames, %llu lost in %llu sequence gaps, %llu dequeues left "
+      "none of the %d buffers with the driver", name,
+      (unsigned long long) m_frames, (unsigned long long) m_lost,
+      (unsigned long long) m_gaps, (unsigned long long) m_starved,
+      m_num_buffers);
+  m_dqbuf_wait.report("  DQBUF wait");
+  m_out_of_driver.report("  Buffer out of driver");
+}
@@ -0,0 +1,86 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef CAPTURE_STATS_H
+#define CAPTURE_STATS_H
+
+#include <stdint.h>
+#include <linux/videodev2.h>
+#include "perf_stats.h"
+
+/* Health of a V4L2 capture device, updated with every QBUF and DQBUF:
+ *  - sequence gaps, frames the driver captured into no buffer because none
+ *    was queued (or that it dropped for other reasons)
+ *  - how long DQBUF blocked waiting for the next frame
+ *  - how long each buffer was out of the driver, from its DQBUF to its QBUF
+ *  - how often a DQBUF left no buffer queued in the driver, so that the
+ *    next frame of the sensor had nowhere to go
+ * Nothing is allocated after the constructor.
+ */
+class CaptureStats {
+public:
+  CaptureStats();
+  // the driver starts over with its sequence numbers on stream on
+  void stream_on(int num_buffers);
+  void dequeued(const v4l2_buffer &buf, double wait_ms);
+  void queued(int index);
+  void report(const char *name) const;
+
+  uint64_t frames() const { return m_frames; }
+  uint64_t lost() const { return m_lost; }
+  uint64_t gaps() const { return m_gaps; }
+  uint64_t starved() const { return m_starved; }
+  int held() const { return m_held; }
+  /* Of the last dequeued buffer. The timestamp is when the driver captured
+   * it, in us of CLOCK_MONOTONIC, and 0 if the driver uses another clock.
+   */
+  uint32_t last_sequence() const { return m_last_seq; }
+  uint64_t last_timestamp_us() const { return m_last_ts_us; }
+  const LatencyStats &dqbuf_wait() const { return m_dqbuf_wait; }
+  const LatencyStats &out_of_driver() const { return m_out_of_driver; }
+
+private:
+  int m_num_buffers;
+  uint64_t m_frames;
+  uint64_t m_lost;
+  uint64_t m_gaps;
+  uint64_t m_starved;
+  int m_held;
+  bool m_have_seq;
+  uint32_t m_last_seq;
+  uint64_t m_last_ts_us;
+  // steady clock time of the DQBUF of each buffer, 0 while queued
+  double m_dequeued_at[VIDEO_MAX_FRAME];
+  LatencyStats m_dqbuf_wait;
+  LatencyStats m_out_of_driver;
+};
+
+// milliseconds of the steady clock, for the wait of CaptureStats::dequeued
+double capture_stats_now_ms();
+
+#endif // CAPTURE_STATS_H
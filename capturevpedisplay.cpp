@@ -50,11 +50,32 @@ extern "C" {
 #include <sys/mman.h>
 #include <sys/ioctl.h>
 #include "capturevpedisplay.h"
+#include "crop_kernels.h"
+#include "overlay_kernels.h"
 #include "save_utils.h"
 #include "cmem_buf.h"
+#include "cmem_slab.h"
+#include "trace.h"
 using namespace std;
 using namespace chrono;
 
+v4l2_rect letterbox_rect(int src_w, int src_h, int dst_w, int dst_h) {
+  v4l2_rect r = {0, 0, (uint32_t) dst_w, (uint32_t) dst_h};
+  if (src_w <= 0 || src_h <= 0)
+    return r;
+  if ((int64_t) src_w * dst_h > (int64_t) src_h * dst_w) {
+    // wider than dst: bars at the top and the bottom
+    r.height = (int) ((int64_t) src_h * dst_w / src_w) & ~1;
+    r.top = (dst_h - r.height) / 2;
+  }
+  else {
+    // the VPE writes pairs of pixels
+    r.width = (int) ((int64_t) src_w * dst_h / src_h) & ~1;
+    r.left = ((dst_w - r.width) / 2) & ~1;
+  }
+  return r;
+}
+
 CamDisp::CamDisp() {
   /* The VIP and VPE default constructors will be called since they are member
    * variables
@@ -67,7 +88,21 @@ CamDisp::CamDisp() {
   frame_num = 0;
 }
 
+/* The devices let go of the buffers before the pools free them, then the
+ * display is handed back
+ */
 CamDisp::~CamDisp() {
+  if (drm_device.dev) {
+    turn_off();
+    vpe.vpe_output_release();
+    bo_vpe_out.release();
+    bo_vpe_out_retired.release();
+    bo_vpe_in.release();
+    for (unsigned int p = 0; p < drm_device.num_planes; p++)
+      drm_device.free_vid_buffers(p);
+    drm_device.drm_exit_device();
+  }
+  free(crop_buf);
 }
 
 
@@ -106,93 +141,28 @@ bool CamDisp::init_capture_pipeline() {
   /* set num_planes to 1 for no output layer and num_planes to 2 for the output
    * layer to be shown
    */
-  int num_planes = 2;
+  int num_planes = 2 + num_extra_overlays;
   if (num_planes < 2)
     alpha = 0;
 
-  vpe.open_fd();
-  drm_device.drm_init_device(num_planes);
-  vip.device_init();
-  vpe.open_fd();
-
-  // vip.device_init();
+  if (drm_device.drm_init_device(num_planes) < 0) {
+    ERROR("DSS planes could not be reserved for %d overlays", num_planes - 1);
+    return false;
+  }
+  if (!vip.device_init() || !vpe.open_fd())
+    return false;
 
   int in_export_fds[vip.src.num_buffers];
   int out_export_fds[vpe.m_num_buffers];
-  // Create an "omap_device" from the fd
-  struct omap_device *dev = omap_device_new(drm_device.fd);
-  bo_vpe_in = (class DmaBuffer **) malloc(vip.src.num_buffers * sizeof(class DmaBuffer *));
-  bo_vpe_out = (class DmaBuffer **) malloc(vip.src.num_buffers * sizeof(class DmaBuffer *));
-
-  if (!bo_vpe_in || !bo_vpe_out) {
-    ERROR("memory allocation failure, exiting \n");
-    exit(EXIT_FAILURE);
-  }
-
-  for (int i = 0; i < vip.src.num_buffers; i++) {
-    bo_vpe_in[i] = (class DmaBuffer *) malloc(sizeof(class DmaBuffer));
-    bo_vpe_out[i] = (class DmaBuffer *) malloc(sizeof(class DmaBuffer));
-    bo_vpe_in[i]->buf_mem_addr = (void **) calloc(4, sizeof(unsigned int));
-    bo_vpe_out[i]->buf_mem_addr = (void **) calloc(4, sizeof(unsigned int));
-
-    bo_vpe_in[i]->width = src_w;
-    bo_vpe_out[i]->width = dst_w;
-
-    bo_vpe_in[i]->height = src_h;
-    bo_vpe_out[i]->height = dst_h;
-
-    bo_vpe_in[i]->fourcc = vip.src.fourcc;
-
-    // These are a good 1 -> 1 mapping
-    if (vpe.dst.fourcc == V4L2_PIX_FMT_BGR24 || vpe.dst.fourcc == V4L2_PIX_FMT_BGR32)
-      bo_vpe_out[i]->fourcc = FOURCC_STR("AR24");
-    else
-      bo_vpe_out[i]->fourcc = vpe.dst.fourcc;
-
-
-    // allocate space for buffer object (bo)
-    bo_vpe_in[i]->bo = (struct omap_bo **) malloc(4 *sizeof(omap_bo *));
-    bo_vpe_out[i]->bo = (struct omap_bo **) malloc(4 *sizeof(omap_bo *));
-
-    if (use_cmem) {
-      bo_vpe_in[i]->fd[0] = alloc_cmem_buffer(src_w*src_h*vpe.src.bytes_pp, 1,
-        &bo_vpe_in[i]->buf_mem_addr[0]);
-      bo_vpe_out[i]->fd[0] = alloc_cmem_buffer(dst_w*dst_h*vpe.dst.bytes_pp, 1,
-        &bo_vpe_out[i]->buf_mem_addr[0]);
-
-      if(bo_vpe_in[i]->fd[0] < 0) {
-        free_cmem_buffer(bo_vpe_in[i]->buf_mem_addr[0]);
-        printf(" Cannot export CMEM buffer\n");
-        return NULL;
-      }
-      if(bo_vpe_out[i]->fd[0] < 0) {
-  			free_cmem_buffer(bo_vpe_out[i]->buf_mem_addr[0]);
-  			printf(" Cannot export CMEM buffer\n");
-  			return NULL;
-      }
-    }
-    else {
-      // define the object
-  		bo_vpe_in[i]->bo[0] = omap_bo_new(dev, src_w*src_h*vpe.src.bytes_pp,
-        OMAP_BO_SCANOUT | OMAP_BO_WC);
-      bo_vpe_out[i]->bo[0] = omap_bo_new(dev, dst_w*dst_h*vpe.dst.bytes_pp,
-        OMAP_BO_SCANOUT | OMAP_BO_WC);
-
-      // give the object a file descriptor for dmabuf v4l2 calls
-      bo_vpe_in[i]->fd[0] = omap_bo_dmabuf(bo_vpe_in[i]->bo[0]);
-      bo_vpe_out[i]->fd[0] = omap_bo_dmabuf(bo_vpe_out[i]->bo[0]);
-    }
-
-    // get the buffer addresses so that they can be used later.
-    if(!use_cmem) {
-      bo_vpe_in[i]->buf_mem_addr[0] = omap_bo_map(bo_vpe_in[i]->bo[0]);
-      bo_vpe_out[i]->buf_mem_addr[0] = omap_bo_map(bo_vpe_out[i]->bo[0]);
-    }
-    DBG("Exported file descriptor for bo_vpe_in[%d]: %d", i, bo_vpe_in[i]->fd[0]);
-    DBG("Exported file descriptor for bo_vpe_out[%d]: %d", i, bo_vpe_out[i]->fd[0]);
-    in_export_fds[i] = bo_vpe_in[i]->fd[0];
-    out_export_fds[i] = bo_vpe_out[i]->fd[0];
+  if (!bo_vpe_in.alloc(drm_device.dev, vip.src.num_buffers, vip.src.fourcc,
+                       src_w, src_h, vpe.src.bytes_pp,
+                       use_cmem ? BUF_CMEM : BUF_OMAP) ||
+      !alloc_vpe_out_buffers(bo_vpe_out)) {
+    ERROR("Capture buffer allocation failed");
+    return false;
   }
+  bo_vpe_in.fds(in_export_fds);
+  bo_vpe_out.fds(out_export_fds);
 
   if (!vip.request_export_buf(in_export_fds)) {
     ERROR("VIP buffer requests failed.");
@@ -206,6 +176,7 @@ bool CamDisp::init_capture_pipeline() {
   }
   DBG("Input layer initialization done\n");
 
+  setup_letterbox();
   if (!vpe.vpe_output_init(out_export_fds)) {
     ERROR("Output layer initialization failed.");
     return false;
@@ -228,9 +199,10 @@ bool CamDisp::init_capture_pipeline() {
     }
   }
   DBG("VPE initial output buffer queues done\n");
+  export_buffers();
 
   vpe.m_field = V4L2_FIELD_ANY;
-  if (drm_device.export_buffer(bo_vpe_out, vpe.m_num_buffers, vpe.dst.bytes_pp, 0)){
+  if (drm_device.export_buffer(bo_vpe_out, 0)){
     DBG("Buffer from vpe exported");
   }
   else {
@@ -240,40 +212,34 @@ bool CamDisp::init_capture_pipeline() {
 
   // initialize the second plane of data
   if (num_planes > 1) {
-    if (net_type == "seg") {
-      /* since TIDL outputs 8-bit data and DSS consumes a minimum of 16-bit,
-       * this buffer needs to be half its normal size. There are adjustments
-       * in disp_obj as well
-       */
-      if (drm_device.get_vid_buffers(vpe.m_num_buffers, FOURCC_STR("RX12"), dst_w, dst_h, 2, 1)) {
-        DBG("\nSegmentation overlay plane successfully allocated");
-        for (int b=0; b<vpe.m_num_buffers; b++) {
-          print_omap_bo(drm_device.plane_data_buffer[1][b]->bo[0]);
-        }
-      }
-      else {
-        ERROR("DRM failed to allocate buffers for the overlay plane\n" \
-              "Check that parameters are valid and size inputs are correct" \
-              "'modetest -p' will give more information on plane specs");
-        return false;
-      }
-    }
-    else if (net_type == "ssd" || net_type == "class") {
-      if (drm_device.get_vid_buffers(vpe.m_num_buffers, FOURCC_STR("AR24"), dst_w, dst_h, 4, 1)) {
-
-        if (net_type == "ssd") DBG("\nBounding Box overlay plane successfully allocated");
-        if (net_type == "class") DBG("\nClassification overlay plane successfully allocated");
+    if ((net_type == "seg" || net_type == "ssd" || net_type == "class") &&
+        !alloc_overlay_buffers())
+      return false;
 
-        for (int b=0; b<vpe.m_num_buffers; b++) {
-          print_omap_bo(drm_device.plane_data_buffer[1][b]->bo[0]);
-        }
+    /* Planes of the additional networks. Segmentation overlays have no
+     * per-pixel alpha, they go right above the video so that they do not
+     * cover the boxes and labels of the others.
+     */
+    unsigned int zorder = 2;
+    for (int pass = 0; pass < 2; pass++) {
+      for (int p = 1; p < num_planes; p++) {
+        std::string type = p == 1 ? net_type : extra_overlays[p-2].type;
+        if ((type == "seg") == (pass == 0))
+          drm_device.plane_zorder[p] = zorder++;
       }
-      else {
-        ERROR("DRM failed to allocate buffers for the overlay plane\n" \
-              "Check that parameters are valid and size inputs are correct" \
-              "'modetest -p' will give more information on plane specs");
+    }
+    for (int o = 0; o < num_extra_overlays; o++) {
+      int p = o + 2;
+      bool seg = extra_overlays[o].type == "seg";
+      if (!drm_device.get_vid_buffers(vpe.m_num_buffers,
+            seg ? FOURCC_STR("RX12") : FOURCC_STR("AR24"),
+            extra_overlays[o].w, extra_overlays[o].h, seg ? 2 : 4, p)) {
+        ERROR("DRM failed to allocate buffers for overlay plane %d", p);
         return false;
       }
+      drm_device.plane_pool[p].clear();
+      drm_device.plane_alpha[p] = extra_overlays[o].alpha;
+      drm_device.plane_buf[p] = 0;
     }
   }
 
@@ -288,8 +254,174 @@ bool CamDisp::init_capture_pipeline() {
   return true;
 }
 
+/* Region of the model input that the VPE output and crop_buf are written
+ * into, the full input unless letterbox is set
+ */
+void CamDisp::setup_letterbox() {
+  crop_lb.left = crop_lb.top = 0;
+  crop_lb.width = dst_w;
+  crop_lb.height = dst_h;
+  vpe.compose = crop_lb;
+  if (letterbox) {
+    /* The regions of a layout have the same size up to rounding, they all
+     * use the letterbox of the first one so that the bars of crop_buf stay
+     * cleared.
+     */
+    if (num_crops > 0)
+      crop_lb = letterbox_rect(crops[0].width, crops[0].height, dst_w, dst_h);
+    vpe.compose = letterbox_rect(vpe.crop.width, vpe.crop.height, dst_w, dst_h);
+    MSG("Letterbox: %ux%u at (%d,%d) of the %dx%d model input",
+        vpe.compose.width, vpe.compose.height, vpe.compose.left,
+        vpe.compose.top, dst_w, dst_h);
+  }
+}
+
+/* Allocate the output buffers of the VPE at dst_w x dst_h, which are also
+ * the video buffers of the display. They are black until the VPE writes
+ * them, the letterbox bars are never written and stay cleared.
+ */
+bool CamDisp::alloc_vpe_out_buffers(BufferPool &pool) {
+  // These are a good 1 -> 1 mapping
+  uint32_t fourcc = vpe.dst.fourcc;
+  if (fourcc == V4L2_PIX_FMT_BGR24 || fourcc == V4L2_PIX_FMT_BGR32)
+    fourcc = FOURCC_STR("AR24");
+
+  if (!pool.alloc(drm_device.dev, vpe.m_num_buffers, fourcc, dst_w, dst_h,
+                  vpe.dst.bytes_pp, use_cmem ? BUF_CMEM : BUF_OMAP))
+    return false;
+  pool.clear();
+  return true;
+}
+
+/* Allocate the buffers of the first overlay, at the model input size */
+bool CamDisp::alloc_overlay_buffers() {
+  bool seg = net_type == "seg";
+  /* since TIDL outputs 8-bit data and DSS consumes a minimum of 16-bit, the
+   * segmentation buffer needs to be half its normal size. There are
+   * adjustments in disp_obj as well
+   */
+  if (!drm_device.get_vid_buffers(vpe.m_num_buffers,
+        seg ? FOURCC_STR("RX12") : FOURCC_STR("AR24"), dst_w, dst_h,
+        seg ? 2 : 4, 1)) {
+    ERROR("DRM failed to allocate buffers for the overlay plane\n" \
+          "Check that parameters are valid and size inputs are correct" \
+          "'modetest -p' will give more information on plane specs");
+    return false;
+  }
+  if (net_type == "seg") DBG("\nSegmentation overlay plane successfully allocated");
+  if (net_type == "ssd") DBG("\nBounding Box overlay plane successfully allocated");
+  if (net_type == "class") DBG("\nClassification overlay plane successfully allocated");
+  drm_device.plane_pool[1].clear();
+  return true;
+}
+
+/* Change the model input size to w x h while the capture keeps streaming.
+ * Only the output side of the VPE, its buffers and the buffers of the video
+ * and first overlay planes are replaced. The new buffers are on screen
+ * before the old ones are freed.
+ */
+bool CamDisp::set_output_size(int w, int h) {
+  int n = vpe.m_num_buffers;
+
+  // the capture held by the VPE input goes back to the VIP
+  if (!vpe.stream_off(1) || !vpe.stream_off(0))
+    return false;
+  if (stop_after_one && !vip.queue_buf(bo_vpe_in[cap_num]->fd[0], cap_num))
+    return false;
+  stop_after_one = false;
+  if (!vpe.vpe_output_release())
+    return false;
+
+  /* the old buffers are freed once they are off screen, as these go, or
+   * once the clients of the exporter gave them back. Only one retired set
+   * is kept, the one before is waited for.
+   */
+  exporter.wait_retired();
+  bo_vpe_out_retired.release();
+  BufferPool old_out, old_overlay;
+  old_out.swap(bo_vpe_out);
+  old_overlay.swap(drm_device.plane_pool[1]);
+
+  dst_w = w;
+  dst_h = h;
+  vpe.dst.width = w;
+  vpe.dst.height = h;
+  vpe.dst.size = w * h * vpe.dst.bytes_pp;
+  int out_export_fds[n];
+  if (!alloc_vpe_out_buffers(bo_vpe_out))
+    return false;
+  bo_vpe_out.fds(out_export_fds);
+  setup_letterbox();
+
+  if (!vpe.vpe_output_init(out_export_fds))
+    return false;
+  for (int i = 0; i < n; i++) {
+    if (!vpe.output_qbuf(i, out_export_fds[i])) {
+      ERROR("queue VPE output buffer #%d failed", i);
+      return false;
+    }
+  }
+  if (!vpe.stream_on(1))
+    return false;
+  export_buffers();
+  if (exporter.retired_held())
+    bo_vpe_out_retired.swap(old_out);
+
+  if (!drm_device.export_buffer(bo_vpe_out, 0))
+    return false;
+  if (old_overlay.size() > 0 && !alloc_overlay_buffers())
+    return false;
+  if (num_crops > 0) {
+    free(crop_buf);
+    crop_buf = calloc(dst_w*dst_h, vpe.dst.bytes_pp);
+    if (!crop_buf)
+      return false;
+  }
+
+  // the atomic commit returns once the new buffers are scanned out
+  if (drm_device.drm_init_dss(&vpe.dst, &vpe.dst, alpha, net_type) < 0)
+    return false;
+  BufferPool::report();
+  return true;
+}
+
+bool CamDisp::record(const std::string &path) {
+  return recorder.open(path, src_w, src_h, vip.src.fourcc, src_w * src_h * 2);
+}
+
+bool CamDisp::dump_display(const std::string &path) {
+  bool seg = net_type == "seg";
+  return display_dump.open(path, dst_w, dst_h,
+                           seg ? FOURCC_STR("RX12") : FOURCC_STR("AR24"),
+                           dst_w * dst_h * (seg ? 2 : 4));
+}
+
+DmaBuffer *CamDisp::overlay_buffer() {
+  int b = drm_device.plane_buf[1] < 0 ? disp_frame_num : drm_device.plane_buf[1];
+  return drm_device.plane_data_buffer[1][b];
+}
+
+void CamDisp::set_overlay_capture(uint32_t sequence, uint64_t capture_us) {
+  overlay_capture.sequence = sequence;
+  overlay_capture.capture_us = capture_us;
+  if (!frame_id || drm_device.num_planes < 2)
+    return;
+  DmaBuffer *buf = overlay_buffer();
+  CpuAccess access = cpu_access(buf, DMA_BUF_SYNC_WRITE);
+  cv::Mat frame(dst_h, dst_w, net_type == "seg" ? CV_16UC1 : CV_8UC4,
+                buf->buf_mem_addr[0]);
+  DrawFrameId(frame, sequence);
+}
+
 void CamDisp::disp_frame() {
   drm_device.disp_frame(disp_frame_num);
+  if (display_dump.is_open() && drm_device.num_planes >= 2 &&
+      drm_device.last_flip_us) {
+    DmaBuffer *buf = overlay_buffer();
+    CpuAccess access = cpu_access(buf, DMA_BUF_SYNC_READ);
+    overlay_capture.display_us = drm_device.last_flip_us;
+    display_dump.write(buf->buf_mem_addr[0], overlay_capture);
+  }
 }
 
 void *CamDisp::grab_image() {
@@ -297,21 +429,40 @@ void *CamDisp::grab_image() {
    * don't want to do this until the user calls for another frame. Otherwise,
    * the data pointed to by *imagedata could be corrupted.
    */
+  export_poll();
   if (stop_after_one) {
-    vpe.output_qbuf(frame_num, bo_vpe_out[frame_num]->fd[0]);
+    requeue_vpe_output(frame_num);
     frame_num = vpe.input_dqbuf();
     vip.queue_buf(bo_vpe_in[frame_num]->fd[0], frame_num);
   }
 
-  /* dequeue the vip */
-  frame_num = vip.dequeue_buf();
-
-  // In other terms, "if the camera is a usb camera"
-  if (vip.src.memory == V4L2_MEMORY_MMAP) {
-    memcpy(bo_vpe_in[frame_num]->buf_mem_addr[0],
-      vip.src.base_addr[frame_num], vip.src.size);
+  {
+    TraceScope span("capture");
+    /* dequeue the vip, the camera may take a while to deliver its first
+     * frame after streaming starts
+     */
+    if (!stop_after_one && !vip.wait_frame(FIRST_FRAME_TIMEOUT_MS))
+      return NULL;
+    frame_num = vip.dequeue_buf();
+    cap_num = frame_num;
+
+    // In other terms, "if the camera is a usb camera"
+    if (vip.src.memory == V4L2_MEMORY_MMAP) {
+      CpuAccess access = cpu_access(bo_vpe_in[frame_num], DMA_BUF_SYNC_WRITE);
+      memcpy(bo_vpe_in[frame_num]->buf_mem_addr[0],
+        vip.src.base_addr[frame_num], vip.src.size);
+    }
+    if (recorder.is_open()) {
+      CpuAccess access = cpu_access(bo_vpe_in[frame_num], DMA_BUF_SYNC_READ);
+      capture_frame_info_t info = {};
+      info.sequence = vip.stats.last_sequence();
+      info.capture_us = vip.stats.last_timestamp_us();
+      info.display_us = info.capture_us;
+      recorder.write(bo_vpe_in[frame_num]->buf_mem_addr[0], info);
+    }
   }
 
+  TraceScope span("VPE");
   /* queue that frame onto the vpe */
   if (!vpe.input_qbuf(bo_vpe_in[frame_num]->fd[0], frame_num)) {
     ERROR("vpe input queue buffer failed");
@@ -330,13 +481,211 @@ void *CamDisp::grab_image() {
 
   // if no display, then the api is not called
   disp_frame_num = frame_num;
+  if (exporter.is_open() && vpe_full_frame())
+    exporter.publish(frame_num, vip.stats.last_sequence(),
+                     vip.stats.last_timestamp_us());
 
   /********** DATA IS HERE ************/
   void *imagedata = (void *) bo_vpe_out[frame_num]->buf_mem_addr[0];
-  DBG("Image data at %p of size 0x%x", imagedata, vpe.dst.size);
+  LOGT("Image data at %p of size 0x%x", imagedata, vpe.dst.size);
   return imagedata;
 }
 
+/* Split every capture into num regions (capture coordinates) that are each
+ * scaled to the model input size. Must be called before init_capture_pipeline
+ * so that the VPE starts out with the right crop. crop_buf is allocated here
+ * also for VPE crops, for the fallback to CPU crops in grab_crop.
+ */
+bool CamDisp::set_crops(const v4l2_rect *rects, int num, bool use_cpu,
+                        bool _full_frame_display) {
+  if (num <= 0 || num > MAX_CROPS) {
+    ERROR("Number of crops must be between 1 and %d, got %d", MAX_CROPS, num);
+    return false;
+  }
+
+  for (int i = 0; i < num; i++) {
+    // the VPE works on pairs of YUYV pixels
+    crops[i].left = rects[i].left & ~1;
+    crops[i].top = rects[i].top;
+    crops[i].width = std::min((int) rects[i].width & ~1, src_w - crops[i].left);
+    crops[i].height = std::min((int) rects[i].height, src_h - crops[i].top);
+    DBG("Crop %d: %dx%d at (%d,%d)", i, crops[i].width, crops[i].height,
+        crops[i].left, crops[i].top);
+  }
+  free(crop_buf);
+  crop_buf = calloc(dst_w*dst_h, vpe.dst.bytes_pp);
+  if (!crop_buf) {
+    ERROR("Failed to allocate the crop buffer");
+    return false;
+  }
+  num_crops = num;
+  cpu_crop = use_cpu;
+  full_frame_display = _full_frame_display;
+
+  if (cpu_crop) {
+    vpe.crop.left = 0;
+    vpe.crop.top = 0;
+    vpe.crop.width = src_w;
+    vpe.crop.height = src_h;
+  }
+  else {
+    vpe.crop = crops[0];
+  }
+  return true;
+}
+
+/* Return region crop_idx of the capture, scaled to the model input. Region 0
+ * grabs a new capture, the other regions reuse the capture that is held by
+ * the VPE: its input buffer is queued once more with a different crop. The
+ * pointer is valid until the next grab.
+ */
+void *CamDisp::grab_crop(int crop_idx) {
+  if (num_crops == 0) return grab_image();
+  const v4l2_rect &r = crops[crop_idx % num_crops];
+
+  if (!cpu_crop && memcmp(&r, &vpe.crop, sizeof(r)) != 0) {
+    if (!vpe.set_src_crop(r)) {
+      /* Keep going with whatever the VPE produces, the regions are then cut
+       * out of that (clipped to it) on the CPU.
+       */
+      ERROR("VPE crop could not be changed, falling back to CPU crops");
+      cpu_crop = true;
+    }
+  }
+
+  void *image;
+  if (crop_idx % num_crops == 0 || !stop_after_one)
+    image = grab_image();
+  else if (!cpu_crop)
+    image = regrab_image();
+  else
+    image = bo_vpe_out[frame_num]->buf_mem_addr[0];
+
+  if (cpu_crop && image)
+    image = cpu_crop_image(r);
+  return image;
+}
+
+/* The image of region crop_idx has been consumed. After the last region of
+ * a capture that was cropped by the VPE (or after every capture with a
+ * dynamic crop), the capture is run through it once more uncropped if the
+ * display is to show the full frame.
+ */
+void CamDisp::release_crop(int crop_idx) {
+  if (cpu_crop || !full_frame_display)
+    return;
+  if (num_crops > 0 && crop_idx % num_crops != num_crops - 1)
+    return;
+
+  v4l2_rect full = {0, 0, (uint32_t) src_w, (uint32_t) src_h};
+  if (memcmp(&full, &vpe.crop, sizeof(full)) == 0)
+    return;
+  if (vpe.set_src_crop(full) && regrab_image() && exporter.is_open())
+    exporter.publish(frame_num, vip.stats.last_sequence(),
+                     vip.stats.last_timestamp_us());
+}
+
+/* Crop the captures that follow to r (capture coordinates) while the
+ * pipeline is streaming, without the set of regions of set_crops. Only the
+ * selection of the VPE input changes, nothing is restarted.
+ */
+bool CamDisp::set_dynamic_crop(const v4l2_rect &r, bool _full_frame_display) {
+  full_frame_display = _full_frame_display;
+  if (memcmp(&r, &vpe.crop, sizeof(r)) == 0)
+    return true;
+  return vpe.set_src_crop(r);
+}
+
+/* Run the capture that is currently held by the VPE through it again, with
+ * the current crop settings.
+ */
+void *CamDisp::regrab_image() {
+  TraceScope span("VPE");
+  requeue_vpe_output(frame_num);
+  int in_idx = vpe.input_dqbuf();
+  if (in_idx < 0 || !vpe.input_qbuf(bo_vpe_in[in_idx]->fd[0], in_idx)) {
+    ERROR("vpe input requeue failed");
+    return NULL;
+  }
+  frame_num = vpe.output_dqbuf();
+  disp_frame_num = frame_num;
+  return (void *) bo_vpe_out[frame_num]->buf_mem_addr[0];
+}
+
+/* Cut region r out of the YUYV capture at its full resolution and scale it
+ * to the model input size in crop_buf (BGRx, as the VPE output). With
+ * letterbox only the crop_lb region of crop_buf is written.
+ */
+void *CamDisp::cpu_crop_image(const v4l2_rect &r) {
+  int stride = dst_w * vpe.dst.bytes_pp;
+  uint8_t *dst = (uint8_t *) crop_buf + crop_lb.top * stride +
+                 crop_lb.left * vpe.dst.bytes_pp;
+  TraceScope span("CPU crop");
+  CpuAccess access = cpu_access(bo_vpe_in[cap_num], DMA_BUF_SYNC_READ);
+  crop_resize_yuyv_to_bgrx((const uint8_t *) bo_vpe_in[cap_num]->buf_mem_addr[0],
+                           src_w, src_h, r.left, r.top, r.width, r.height,
+                           dst, crop_lb.width, crop_lb.height, stride);
+  return crop_buf;
+}
+
+/* Give VPE output buffer index back to the VPE, or keep it until the
+ * clients of the exporter release it.
+ */
+void CamDisp::requeue_vpe_output(int index) {
+  if (exporter.is_held(index)) {
+    export_deferred[index] = true;
+    return;
+  }
+  vpe.output_qbuf(index, bo_vpe_out[index]->fd[0]);
+}
+
+// Take the releases of the clients and queue what they gave back
+void CamDisp::export_poll() {
+  if (!exporter.is_open())
+    return;
+  exporter.poll();
+  for (int i = 0; i < vpe.m_num_buffers; i++) {
+    if (export_deferred[i] && !exporter.is_held(i)) {
+      export_deferred[i] = false;
+      vpe.output_qbuf(i, bo_vpe_out[i]->fd[0]);
+    }
+  }
+  if (bo_vpe_out_retired.size() > 0 && !exporter.retired_held())
+    bo_vpe_out_retired.release();
+}
+
+// Send the current VPE output buffers, all of them queued, to the clients
+void CamDisp::export_buffers() {
+  if (!exporter.is_open())
+    return;
+  int fds[vpe.m_num_buffers];
+  frame_export_msg_t fmt;
+  memset(&fmt, 0, sizeof(fmt));
+  bo_vpe_out.fds(fds);
+  fmt.fourcc = bo_vpe_out[0]->fourcc;
+  fmt.width = dst_w;
+  fmt.height = dst_h;
+  fmt.stride = bo_vpe_out[0]->pitches[0];
+  fmt.size = fmt.stride * dst_h;
+  exporter.set_buffers(fds, vpe.m_num_buffers, fmt);
+  memset(export_deferred, 0, sizeof(export_deferred));
+}
+
+/* the VPE output is the whole capture, not one of the crops. Only the VPE
+ * crop tells, after the fallback to CPU crops it is left on a region.
+ */
+bool CamDisp::vpe_full_frame() {
+  return vpe.crop.left == 0 && vpe.crop.top == 0 &&
+         (int) vpe.crop.width == src_w && (int) vpe.crop.height == src_h;
+}
+
+bool CamDisp::export_frames(const std::string &path) {
+  if (!exporter.open(path))
+    return false;
+  vpe.m_num_buffers += FRAME_EXPORT_HELD_BUFFERS;
+  return true;
+}
+
 /* Helper function for the grab_image function above*/
 void CamDisp::init_vpe_stream() {
   int count = 1;
@@ -356,8 +705,62 @@ void CamDisp::init_vpe_stream() {
   }
 }
 
-void *CamDisp::get_overlay_plane_ptr() {
-  return drm_device.plane_data_buffer[1][frame_num]->buf_mem_addr[0];
+/* The first overlay is drawn for every frame and follows the video buffer,
+ * unless it is held. The others get the buffer after the one on screen,
+ * which is shown from the next disp_frame on.
+ */
+void *CamDisp::get_overlay_plane_ptr(int overlay) {
+  int p = overlay + 1;
+  if (drm_device.plane_buf[p] < 0)
+    return drm_device.plane_data_buffer[p][frame_num]->buf_mem_addr[0];
+
+  drm_device.plane_buf[p] = (drm_device.plane_buf[p] + 1) %
+                            drm_device.num_buffers[p];
+  return drm_device.plane_data_buffer[p][drm_device.plane_buf[p]]->buf_mem_addr[0];
+}
+
+/* The VPE output of the last grab, crop_buf is ordinary memory */
+CpuAccess CamDisp::image_access(const void *image) {
+  if (image != bo_vpe_out[frame_num]->buf_mem_addr[0])
+    return CpuAccess();
+  return cpu_access(bo_vpe_out[frame_num], DMA_BUF_SYNC_READ);
+}
+
+/* The buffer of overlay that get_overlay_plane_ptr returned last */
+CpuAccess CamDisp::overlay_access(int overlay) {
+  int p = overlay + 1;
+  int b = drm_device.plane_buf[p] < 0 ? frame_num : drm_device.plane_buf[p];
+  return cpu_access(drm_device.plane_data_buffer[p][b], DMA_BUF_SYNC_WRITE);
+}
+
+/* Keep showing the last buffer that was drawn into overlay instead of the
+ * one of the current video buffer, for an overlay that is not redrawn with
+ * every VPE output.
+ */
+void CamDisp::hold_overlay(int overlay) {
+  drm_device.plane_buf[overlay + 1] = 0;
+}
+
+/* Add an overlay plane of w x h for an additional network of the given type
+ * ("ssd" or "seg"). Must be called before init_capture_pipeline. Returns the
+ * overlay index to pass to get_overlay_plane_ptr, or -1 if the DSS has no
+ * plane left.
+ */
+int CamDisp::add_overlay(std::string type, int w, int h, int _alpha) {
+  if (num_extra_overlays >= MAX_EXTRA_OVERLAYS) {
+    ERROR("No DSS plane left for another overlay");
+    return -1;
+  }
+  extra_overlays[num_extra_overlays].type = type;
+  extra_overlays[num_extra_overlays].w = w;
+  extra_overlays[num_extra_overlays].h = h;
+  extra_overlays[num_extra_overlays].alpha = _alpha;
+  return ++num_extra_overlays;
+}
+
+/* Full VPE output of the last grab, valid until the next grab */
+void *CamDisp::get_image_ptr() {
+  return bo_vpe_out[frame_num]->buf_mem_addr[0];
 }
 
 void CamDisp::turn_off() {
@@ -42,6 +42,8 @@
 #include <sys/ioctl.h>
 #include "v4l2_obj.h"
 #include "disp_obj.h"
+#include "capture_file.h"
+#include "frame_export.h"
 
 #include "save_utils.h"
 
@@ -50,6 +52,16 @@
     ((uint32_t)(uint8_t)(d) << 24 ))
 #define FOURCC_STR(str)    FOURCC(str[0], str[1], str[2], str[3])
 
+// most regions that one capture can be cropped into
+#define MAX_CROPS 16
+// longest wait for the first frame of the camera
+#define FIRST_FRAME_TIMEOUT_MS 3000
+/* overlays beyond the first one, each one takes a DSS plane of its own.
+ * zorder 0 is left to the primary plane, 1 is the video and 2 the first
+ * overlay.
+ */
+#define MAX_EXTRA_OVERLAYS (MAX_ZORDER_VAL - 2)
+
 struct dmabuf_buffer {
 	uint32_t fourcc, width, height;
 	int num_buffer_objects;
@@ -61,6 +73,9 @@ struct dmabuf_buffer {
 };
 
 
+// centered region of dst_w x dst_h that src_w x src_h fills at its aspect ratio
+v4l2_rect letterbox_rect(int src_w, int src_h, int dst_w, int dst_h);
+
 class CamDisp {
 public:
 
@@ -69,17 +84,66 @@ public:
   ~CamDisp();
   CamDisp(int src_w, int src_h, int dst_w, int dst_h, int alpha,
     std::string dev_name, bool usb, std::string net_type, bool quick_display);
+  // the buffers are owned by the one CamDisp
+  CamDisp(const CamDisp &) = delete;
+  CamDisp &operator=(const CamDisp &) = delete;
   bool init_capture_pipeline();
+  bool set_output_size(int w, int h);
+  bool set_crops(const v4l2_rect *rects, int num, bool use_cpu,
+                 bool full_frame_display = false);
+  int get_num_crops() { return num_crops; }
+  int add_overlay(std::string type, int w, int h, int alpha);
   void *grab_image();
+  void *grab_crop(int crop_idx);
+  void release_crop(int crop_idx);
+  bool set_dynamic_crop(const v4l2_rect &r, bool full_frame_display);
+  const v4l2_rect &get_crop() { return vpe.crop; }
+  void *get_image_ptr();
   void disp_frame();
-  void *get_overlay_plane_ptr();
+  void *get_overlay_plane_ptr(int overlay = 0);
+  /* CPU access guards: reads of an image that was returned by one of the
+   * grabs or get_image_ptr, and drawing into the buffer of the last
+   * get_overlay_plane_ptr. They have to end before the next grab or
+   * disp_frame respectively.
+   */
+  CpuAccess image_access(const void *image);
+  CpuAccess overlay_access(int overlay = 0);
+  void hold_overlay(int overlay);
+  void set_letterbox(bool on) { letterbox = on; }
+  // Write every capture to path, for bench/replay_bench
+  bool record(const std::string &path);
+  /* Write the first overlay to path at every flip, for bench/frameid_decode.
+   * set_overlay_capture tells which capture the results on it are of before
+   * the flip, with set_frame_id it also draws the ID of that capture.
+   */
+  bool dump_display(const std::string &path);
+  void set_frame_id(bool on) { frame_id = on; }
+  void set_overlay_capture(uint32_t sequence, uint64_t capture_us);
+  /* Hand the VPE output buffers of the full captures to other processes on
+   * the Unix domain socket path, see frame_export.h. Must be called before
+   * init_capture_pipeline, the VPE gets FRAME_EXPORT_HELD_BUFFERS more
+   * buffers for the ones the clients hold.
+   */
+  bool export_frames(const std::string &path);
+  const FrameExporter &frame_exporter() { return exporter; }
+  // health of the camera capture, for the telemetry
+  const CaptureStats &capture_stats() { return vip.stats; }
+  /* CLOCK_MONOTONIC times in us of when the driver captured the last grab
+   * and of the flip of the last disp_frame, 0 if unknown
+   */
+  uint64_t capture_timestamp_us() { return vip.stats.last_timestamp_us(); }
+  uint32_t capture_sequence() { return vip.stats.last_sequence(); }
+  uint64_t flip_timestamp_us() { return drm_device.last_flip_us; }
+  const v4l2_rect &get_letterbox() { return cpu_crop ? crop_lb : vpe.compose; }
+  const v4l2_rect &get_display_letterbox() { return vpe.compose; }
 
 private:
   VIPObj vip;
   VPEObj vpe;
-  DmaBuffer **bo_vpe_in;
-  DmaBuffer **bo_vpe_out;
   DRMDeviceInfo drm_device;
+  // capture buffers of the VIP and output buffers of the VPE
+  BufferPool bo_vpe_in;
+  BufferPool bo_vpe_out;
   int frame_num;
   int disp_frame_num = -1;
   int src_w;
@@ -90,7 +154,59 @@ private:
   std::string net_type;
   bool use_cmem = true;
   bool stop_after_one = false;
+  /* Regions of the capture (in capture coordinates) that are scaled to the
+   * model input one after the other. The VPE crops them itself unless
+   * cpu_crop is set, in which case the VPE scales the full capture for the
+   * display and each region is cut out of the capture buffer on the CPU
+   * into crop_buf. With full_frame_display the VPE also produces the full
+   * capture after the last region, so that the display is not left on it.
+   */
+  v4l2_rect crops[MAX_CROPS];
+  int num_crops = 0;
+  bool cpu_crop = false;
+  bool full_frame_display = false;
+  void *crop_buf = NULL;
+  // VIP buffer of the current capture
+  int cap_num = 0;
+  /* Overlays of the additional networks, on DSS planes 2 and up. They are
+   * drawn at the rate of their network, so every one of them flips through
+   * its buffers on its own.
+   */
+  struct {
+    std::string type;
+    int w, h, alpha;
+  } extra_overlays[MAX_EXTRA_OVERLAYS];
+  int num_extra_overlays = 0;
+  /* With letterbox the aspect ratio of the capture (or of the crops) is kept:
+   * the image is scaled into a centered region of the model input and the
+   * rest stays black. The VPE writes into its region of the output buffers
+   * through its compose rectangle, crop_lb is the region of crop_buf.
+   */
+  bool letterbox = false;
+  v4l2_rect crop_lb;
+  CaptureWriter recorder;
+  CaptureWriter display_dump;
+  bool frame_id = false;
+  capture_frame_info_t overlay_capture = {};
+  /* VPE output buffers that were not given back to the VPE because a client
+   * of the exporter held them, they are queued once released
+   */
+  FrameExporter exporter;
+  bool export_deferred[VIDEO_MAX_FRAME] = {};
+  // VPE output buffers replaced by set_output_size that clients still hold
+  BufferPool bo_vpe_out_retired;
+  // the buffer of the first overlay that goes to the screen with the flip
+  DmaBuffer *overlay_buffer();
   void init_vpe_stream();
+  void requeue_vpe_output(int index);
+  void export_poll();
+  void export_buffers();
+  bool vpe_full_frame();
+  void setup_letterbox();
+  bool alloc_vpe_out_buffers(BufferPool &pool);
+  bool alloc_overlay_buffers();
+  void *regrab_image();
+  void *cpu_crop_image(const v4l2_rect &r);
   void turn_off();
 
 };
@@ -0,0 +1,222 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <assert.h>
+#include "cascade.h"
+#include "crop_kernels.h"
+#include "topk.h"
+#include "error.h"
+#include "../common/utils.h"
+
+using namespace std;
+using namespace tidl;
+using namespace chrono;
+
+ClassCascade::ClassCascade() {
+  e_dsp = nullptr;
+  num_labels = 0;
+  min_prob = 0;
+  verbose = false;
+  busy = false;
+  quit = false;
+  image_w = image_h = 0;
+  num_det_frames = 0;
+  num_crops = 0;
+}
+
+ClassCascade::~ClassCascade() {
+  if (worker.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      quit = true;
+    }
+    batch_cv.notify_all();
+    worker.join();
+  }
+  FreeMemory(eops);
+  for (auto eop : eops) delete eop;
+  delete e_dsp;
+}
+
+/* Load the classification network on num_dsps DSPs. Each DSP gets two EOPs
+ * so that scaling a box into one input buffer overlaps with the DSP working
+ * on the other.
+ */
+bool ClassCascade::init(const string &config_file, uint32_t num_dsps,
+                        int _num_labels, float _min_prob, bool _verbose) {
+  if (num_dsps == 0) {
+    ERROR("The classification stage of the cascade needs at least one DSP");
+    return false;
+  }
+  if (!c.ReadFromFile(config_file)) {
+    ERROR("Error in cascade configuration file: %s", config_file.c_str());
+    return false;
+  }
+  c.enableApiTrace = _verbose;
+  c.runFullNet = true;
+  num_labels = _num_labels;
+  min_prob = _min_prob;
+  verbose = _verbose;
+
+  DeviceIds ids;
+  for (uint32_t i = 0; i < num_dsps; i++)
+    ids.insert(static_cast<DeviceId>(i));
+  e_dsp = new Executor(DeviceType::DSP, ids, c);
+
+  uint32_t buffer_factor = 2;
+  for (uint32_t j = 0; j < buffer_factor; j++)
+    for (uint32_t i = 0; i < num_dsps; i++)
+      eops.push_back(new ExecutionObjectPipeline({(*e_dsp)[i]}));
+  AllocateMemory(eops);
+  start.resize(eops.size());
+  worker = thread(&ClassCascade::run, this);
+
+  MSG("Cascade: %s on %d DSP(s), %dx%d input, %d EOPs", config_file.c_str(),
+      num_dsps, c.inWidth, c.inHeight, (int) eops.size());
+  return true;
+}
+
+/* Hand the boxes of one detection frame to the thread of the cascade and
+ * return those of the frame before in done, each with its id (-1 if the
+ * classifier is not sure). image is the planar BGR input of the detection
+ * network (width x height) that the boxes were found in, it is copied. Only
+ * waits if the DSPs are not done with the frame before yet.
+ */
+int ClassCascade::classify(const uint8_t *_image, int width, int height,
+                           const CascadeBox *boxes, int num_boxes,
+                           CascadeBox *done, int max_done) {
+  std::unique_lock<std::mutex> guard(lock);
+  batch_cv.wait(guard, [this] { return !busy; });
+
+  int num_done = min((int) batch.size(), max_done);
+  copy(batch.begin(), batch.begin() + num_done, done);
+
+  batch.assign(boxes, boxes + num_boxes);
+  if (num_boxes > 0) {
+    image.assign(_image, _image + width * height * 3);
+    image_w = width;
+    image_h = height;
+    busy = true;
+    guard.unlock();
+    batch_cv.notify_all();
+  }
+  return num_done;
+}
+
+// The thread of the cascade, one batch after the other
+void ClassCascade::run() {
+  std::unique_lock<std::mutex> guard(lock);
+  for (;;) {
+    batch_cv.wait(guard, [this] { return busy || quit; });
+    if (quit)
+      return;
+    guard.unlock();
+    classify_batch();
+    guard.lock();
+    busy = false;
+    batch_cv.notify_all();
+  }
+}
+
+// Classify the boxes of the batch, on the EOPs in turn
+void ClassCascade::classify_batch() {
+  auto batch_start = steady_clock::now();
+  int num_eops = eops.size();
+  int num_boxes = batch.size();
+  int owner[num_eops];
+  for (int e = 0; e < num_eops; e++) owner[e] = -1;
+
+  for (int b = 0; b < num_boxes; b++) {
+    int e = b % num_eops;
+    ExecutionObjectPipeline *eop = eops[e];
+
+    // the EOP still holds a box from earlier in this frame
+    if (owner[e] >= 0 && eop->ProcessFrameWait())
+      collect(e, batch[owner[e]]);
+
+    CascadeBox &box = batch[b];
+    crop_resize_planar(image.data(), image_w, image_h, box.xmin, box.ymin,
+                       box.xmax - box.xmin, box.ymax - box.ymin,
+                       (uint8_t *) eop->GetInputBufferPtr(), c.inWidth,
+                       c.inHeight, 3);
+    eop->SetFrameIndex(b);
+    start[e] = steady_clock::now();
+    eop->ProcessFrameStartAsync();
+    owner[e] = b;
+  }
+
+  for (int e = 0; e < num_eops; e++)
+    if (owner[e] >= 0 && eops[e]->ProcessFrameWait())
+      collect(e, batch[owner[e]]);
+
+  batch_latency.add(duration<double, milli>(steady_clock::now() -
+                                            batch_start).count());
+}
+
+void ClassCascade::collect(int e, CascadeBox &box) {
+  ExecutionObjectPipeline *eop = eops[e];
+  crop_latency.add(duration<double, milli>(steady_clock::now() -
+                                           start[e]).count());
+  num_crops++;
+
+  const uint8_t *out = (const uint8_t *) eop->GetOutputBufferPtr();
+  int out_size = eop->GetOutputBufferSizeInBytes();
+  // same background handling as the classification demo
+  int background_offset = out_size == num_labels + 1 ? 1 : 0;
+
+  topk_result_t top;
+  topk_u8(out, out_size, 1, &top);
+  box.id = top.idx[0] - background_offset;
+  box.prob = (float) top.val[0] / 255;
+  if (box.id >= num_labels || box.prob < min_prob) box.id = -1;
+}
+
+/* Latency of one detection frame, from ProcessFrameStartAsync to the end of
+ * ProcessFrameWait
+ */
+void ClassCascade::add_detection(double latency_ms) {
+  if (!num_det_frames) first_frame = steady_clock::now();
+  det_latency.add(latency_ms);
+  num_det_frames++;
+}
+
+void ClassCascade::report() {
+  {
+    // the statistics of the last batch
+    std::unique_lock<std::mutex> guard(lock);
+    batch_cv.wait(guard, [this] { return !busy; });
+  }
+  double secs = duration<double>(steady_clock::now() - first_frame).count();
+  MSG("\n********** Cascade statistics **********");
+  det_latency.report("detection (EVE)");
+  crop_latency.report("classification / crop");
+  batch_latency.report("classification / frame");
+  if (secs > 0)
+    MSG("throughput: detection %.2f frames/s, classification %.2f crops/s",
+        num_det_frames / secs, num_crops / secs);
+}
@@ -0,0 +1,110 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef CASCADE_H
+#define CASCADE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "executor.h"
+#include "execution_object_pipeline.h"
+#include "configuration.h"
+#include "perf_stats.h"
+
+/* One detection that is passed to the classifier. The box is in pixels of
+ * the detection network input with the label and score of the detection,
+ * id/prob are filled in by the classifier.
+ */
+struct CascadeBox {
+  int xmin, ymin, xmax, ymax;
+  int label;
+  float score;
+  int id;
+  float prob;
+};
+
+/* Second stage of the detection -> classification cascade. The detection
+ * network runs on EVE; the boxes of a frame are classified on the DSPs by a
+ * thread of the cascade, which scales every box out of a copy of the
+ * detection network input into the input buffer of a classification EOP.
+ * As with the EOP ring of the frame loop the results come one frame later:
+ * classify() hands over the boxes of a frame and returns those of the frame
+ * before, while EVE and the frame loop go on with the frames that follow.
+ */
+class ClassCascade {
+public:
+  ClassCascade();
+  ~ClassCascade();
+  bool init(const std::string &config_file, uint32_t num_dsps,
+            int num_labels, float min_prob, bool verbose);
+  int classify(const uint8_t *image, int width, int height,
+               const CascadeBox *boxes, int num_boxes, CascadeBox *done,
+               int max_done);
+  void add_detection(double latency_ms);
+  void report();
+
+private:
+  void run();
+  void classify_batch();
+  void collect(int e, CascadeBox &box);
+
+  tidl::Configuration c;
+  tidl::Executor *e_dsp;
+  std::vector<tidl::ExecutionObjectPipeline *> eops;
+  std::vector<std::chrono::steady_clock::time_point> start;
+  int num_labels;
+  // top-1 output / 255 below which a box gets no class
+  float min_prob;
+  bool verbose;
+
+  /* The batch the thread works on: the boxes and the frame they are in.
+   * The frame loop only touches it while busy is not set.
+   */
+  std::thread worker;
+  std::mutex lock;
+  std::condition_variable batch_cv;
+  bool busy;
+  bool quit;
+  std::vector<uint8_t> image;
+  int image_w, image_h;
+  std::vector<CascadeBox> batch;
+
+  LatencyStats det_latency;
+  LatencyStats crop_latency;
+  LatencyStats batch_latency;
+  uint64_t num_det_frames;
+  uint64_t num_crops;
+  std::chrono::steady_clock::time_point first_frame;
+};
+
+#endif // CASCADE_H
@@ -30,9 +30,39 @@
 #define CMEM_BUF_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <linux/dma-buf.h>
 
 void init_cmem();
 int alloc_cmem_buffer(unsigned int size, unsigned int align, void **cmem_buf);
 void free_cmem_buffer(void *cmem_buffer);
 int dma_buf_do_cache_operation(int dma_buf_fd, uint32_t cache_operation);
+// CPU mappings of the CMEM allocations that follow are cached (the default)
+void set_cmem_cached(bool cached);
+bool get_cmem_cached();
+
+/* Brackets one CPU access to a buffer that a device also reads or writes,
+ * with DMA_BUF_SYNC_READ, DMA_BUF_SYNC_WRITE or DMA_BUF_SYNC_RW. Lines
+ * written by a device are invalidated on construction, lines written by the
+ * CPU are written back on destruction. A sub-range of a CMEM allocation (a
+ * slab sub-allocation) is maintained on its own instead of the whole dmabuf.
+ * Does nothing for uncached CMEM and when default constructed.
+ */
+class CpuAccess {
+public:
+  CpuAccess() : fd(-1), ptr(NULL), size(0), flags(0) {}
+  CpuAccess(int dma_buf_fd, uint32_t flags);
+  CpuAccess(void *cmem_ptr, size_t size, uint32_t flags);
+  CpuAccess(CpuAccess &&other);
+  CpuAccess(const CpuAccess &) = delete;
+  CpuAccess &operator=(const CpuAccess &) = delete;
+  ~CpuAccess();
+
+private:
+  void begin();
+  int fd;
+  void *ptr;
+  size_t size;
+  uint32_t flags;
+};
 #endif //CMEM_BUF_H
@@ -0,0 +1,241 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <unistd.h>
+#include <algorithm>
+#include <ti/cmem.h>
+#include "cmem_slab.h"
+#include "cmem_buf.h"
+#include "error.h"
+
+CmemSlab cmem_slab;
+
+static CMEM_AllocParams slab_alloc_params = {
+  CMEM_HEAP,    /* type */
+  CMEM_CACHED,  /* flags */
+  SLAB_ALIGN    /* alignment */
+};
+
+CmemSlab::CmemSlab() : base(NULL), total(0), fd(-1), used_bytes(0),
+  peak_bytes(0), num_failed(0), exported_bytes(0), peak_exported_bytes(0),
+  num_reused(0) {}
+
+/* Reserve the region. Without it (bytes of 0 or CMEM out of memory) alloc()
+ * always fails and the callers fall back to allocations of their own.
+ */
+bool CmemSlab::init(size_t bytes)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  if (base || bytes == 0)
+    return base != NULL;
+
+  init_cmem();
+  slab_alloc_params.flags = get_cmem_cached() ? CMEM_CACHED : CMEM_NONCACHED;
+  base = (uint8_t *) CMEM_alloc2(CMEM_CMABLOCKID, bytes, &slab_alloc_params);
+  if (!base) {
+    ERROR("Could not reserve a CMEM region of %zu bytes", bytes);
+    return false;
+  }
+  fd = CMEM_export_dmabuf(base);
+  total = bytes;
+  blocks.clear();
+  blocks.push_back({0, bytes, false});
+  MSG("CMEM slab of %zu KB reserved", bytes >> 10);
+  return true;
+}
+
+// first fit, the rest of the free block stays free
+void *CmemSlab::alloc(size_t size, size_t align)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  if (!base || size == 0)
+    return NULL;
+  if (align == 0)
+    align = 1;
+
+  for (size_t i = 0; i < blocks.size(); i++) {
+    Block b = blocks[i];
+    if (b.used)
+      continue;
+    size_t start = (b.offset + align - 1) / align * align;
+    if (start + size > b.offset + b.size)
+      continue;
+
+    // the block becomes [pad][size][rest]
+    size_t pad = start - b.offset;
+    size_t rest = b.offset + b.size - start - size;
+    blocks[i] = {start, size, true};
+    if (rest > 0)
+      blocks.insert(blocks.begin() + i + 1, {start + size, rest, false});
+    if (pad > 0)
+      blocks.insert(blocks.begin() + i, {b.offset, pad, false});
+
+    used_bytes += size;
+    if (used_bytes > peak_bytes)
+      peak_bytes = used_bytes;
+    return base + start;
+  }
+  num_failed++;
+  return NULL;
+}
+
+// merge with the free neighbours
+void CmemSlab::free(void *ptr)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  if (!base || !ptr)
+    return;
+
+  size_t offset = (uint8_t *) ptr - base;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    if (blocks[i].offset != offset || !blocks[i].used)
+      continue;
+    used_bytes -= blocks[i].size;
+    blocks[i].used = false;
+    if (i + 1 < blocks.size() && !blocks[i + 1].used) {
+      blocks[i].size += blocks[i + 1].size;
+      blocks.erase(blocks.begin() + i + 1);
+    }
+    if (i > 0 && !blocks[i - 1].used) {
+      blocks[i - 1].size += blocks[i].size;
+      blocks.erase(blocks.begin() + i);
+    }
+    return;
+  }
+  ERROR("%p is not a CMEM slab buffer", ptr);
+}
+
+bool CmemSlab::contains(const void *ptr) const
+{
+  return base && (const uint8_t *) ptr >= base &&
+         (const uint8_t *) ptr < base + total;
+}
+
+size_t CmemSlab::offset_of(const void *ptr) const
+{
+  return (const uint8_t *) ptr - base;
+}
+
+int CmemSlab::alloc_exported(size_t size, void **ptr)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto &e : exported) {
+    if (!e.used && e.size == size) {
+      e.used = true;
+      *ptr = e.ptr;
+      num_reused++;
+      return e.fd;
+    }
+  }
+
+  Exported e;
+  e.fd = alloc_cmem_buffer(size, SLAB_ALIGN, &e.ptr);
+  if (e.fd < 0) {
+    if (e.ptr)
+      free_cmem_buffer(e.ptr);
+    *ptr = NULL;
+    return -1;
+  }
+  e.size = size;
+  e.used = true;
+  exported.push_back(e);
+  exported_bytes += size;
+  if (exported_bytes > peak_exported_bytes)
+    peak_exported_bytes = exported_bytes;
+  *ptr = e.ptr;
+  return e.fd;
+}
+
+// the allocation and its dmabuf are kept for the next buffer of that size
+void CmemSlab::free_exported(void *ptr)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto &e : exported) {
+    if (e.ptr == ptr) {
+      e.used = false;
+      return;
+    }
+  }
+  ERROR("%p is not an exported CMEM slab buffer", ptr);
+}
+
+void CmemSlab::usage(size_t *used, size_t *size, size_t *exported_size)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  *used = used_bytes;
+  *size = total;
+  *exported_size = exported_bytes;
+}
+
+void CmemSlab::report()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  size_t free_bytes = 0, largest = 0;
+  int num_free = 0;
+  for (auto &b : blocks) {
+    if (b.used)
+      continue;
+    free_bytes += b.size;
+    largest = std::max(largest, b.size);
+    num_free++;
+  }
+  // share of the free space that is not in the largest free block
+  float frag = free_bytes ? 100.0f * (free_bytes - largest) / free_bytes : 0;
+
+  MSG("CMEM slab: %zu of %zu KB used, peak %zu KB, %d free blocks, " \
+      "largest %zu KB, fragmentation %.1f%%, %u allocations did not fit",
+      used_bytes >> 10, total >> 10, peak_bytes >> 10, num_free,
+      largest >> 10, frag, num_failed);
+  MSG("CMEM exported buffers: %zu of them, %zu KB, peak %zu KB, %u reused",
+      exported.size(), exported_bytes >> 10, peak_exported_bytes >> 10,
+      num_reused);
+}
+
+/* Give everything back to CMEM. Buffers that are still in use by a driver
+ * are released by it when their dmabuf is closed.
+ */
+void CmemSlab::release()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto &e : exported) {
+    close(e.fd);
+    free_cmem_buffer(e.ptr);
+  }
+  exported.clear();
+  exported_bytes = 0;
+
+  if (base) {
+    close(fd);
+    CMEM_free(base, &slab_alloc_params);
+    base = NULL;
+    fd = -1;
+    total = 0;
+    blocks.clear();
+    used_bytes = 0;
+  }
+}
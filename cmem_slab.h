@@ -0,0 +1,99 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef CMEM_SLAB_H
+#define CMEM_SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+// alignment of the sub-allocations, a page so they can be DSS framebuffers
+#define SLAB_ALIGN 4096
+
+/* One contiguous CMEM region that is reserved at startup and sub-allocated,
+ * so that the buffers of a run do not each take (and on a crash leave) a
+ * CMEM allocation of their own. CMEM exports a dmabuf per allocation only,
+ * so buffers that V4L2 imports get their own allocation from
+ * alloc_exported(). Those are kept on free and handed out again for the
+ * same size. All of it goes back to CMEM with release(), also at exit.
+ * Thread safe.
+ */
+class CmemSlab {
+public:
+  CmemSlab();
+  bool init(size_t bytes);
+  bool enabled() const { return base != NULL; }
+
+  // sub-allocation of the region, NULL if it does not fit
+  void *alloc(size_t size, size_t align = SLAB_ALIGN);
+  void free(void *ptr);
+  bool contains(const void *ptr) const;
+  size_t offset_of(const void *ptr) const;
+  // dmabuf of the whole region
+  int region_fd() const { return fd; }
+
+  // a CMEM allocation with its own dmabuf, returns the fd or -1
+  int alloc_exported(size_t size, void **ptr);
+  void free_exported(void *ptr);
+
+  void report();
+  // bytes of the region in use and of the allocations with their own dmabuf
+  void usage(size_t *used, size_t *size, size_t *exported_size);
+  void release();
+
+private:
+  struct Block {
+    size_t offset;
+    size_t size;
+    bool used;
+  };
+  struct Exported {
+    void *ptr;
+    int fd;
+    size_t size;
+    bool used;
+  };
+  std::mutex lock;
+  uint8_t *base;
+  size_t total;
+  int fd;
+  std::vector<Block> blocks;  // the whole region, sorted by offset
+  size_t used_bytes;
+  size_t peak_bytes;
+  uint32_t num_failed;
+  std::vector<Exported> exported;
+  size_t exported_bytes;
+  size_t peak_exported_bytes;
+  uint32_t num_reused;
+};
+
+extern CmemSlab cmem_slab;
+
+#endif // CMEM_SLAB_H
@@ -0,0 +1,157 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <algorithm>
+#include "crop_kernels.h"
+
+/* Source coordinates are 16.16 fixed point, the interpolation weights use
+ * the top 8 bits of the fraction.
+ */
+#define FIX_SHIFT 16
+#define FIX_ONE   (1 << FIX_SHIFT)
+
+/* Sample (x, y) of plane p is at src[p*plane_step + y*row_step + x*pixel_step],
+ * which covers both planar and packed (interleaved) sources.
+ */
+static void crop_resize(const uint8_t *src, int src_w, int src_h,
+                        int plane_step, int row_step, int pixel_step,
+                        int x, int y, int w, int h,
+                        uint8_t *dst, int dst_w, int dst_h, int num_planes)
+{
+  int x1 = std::min(x + w, src_w);
+  int y1 = std::min(y + h, src_h);
+  x = std::max(x, 0);
+  y = std::max(y, 0);
+  w = x1 - x;
+  h = y1 - y;
+  if (w <= 0 || h <= 0 || dst_w <= 0 || dst_h <= 0) return;
+
+  int dst_plane = dst_w * dst_h;
+  int32_t step_x = (int32_t) (((int64_t) w << FIX_SHIFT) / dst_w);
+  int32_t step_y = (int32_t) (((int64_t) h << FIX_SHIFT) / dst_h);
+
+  for (int dy = 0; dy < dst_h; dy++) {
+    // sample at pixel centers
+    int32_t sy = (y << FIX_SHIFT) + dy * step_y + step_y / 2 - FIX_ONE / 2;
+    sy = std::max(sy, y << FIX_SHIFT);
+    int y0 = sy >> FIX_SHIFT;
+    int yn = std::min(y0 + 1, y1 - 1);
+    uint32_t fy = (sy >> (FIX_SHIFT - 8)) & 0xff;
+
+    for (int dx = 0; dx < dst_w; dx++) {
+      int32_t sx = (x << FIX_SHIFT) + dx * step_x + step_x / 2 - FIX_ONE / 2;
+      sx = std::max(sx, x << FIX_SHIFT);
+      int x0 = (sx >> FIX_SHIFT) * pixel_step;
+      int xn = std::min((sx >> FIX_SHIFT) + 1, x1 - 1) * pixel_step;
+      uint32_t fx = (sx >> (FIX_SHIFT - 8)) & 0xff;
+
+      for (int p = 0; p < num_planes; p++) {
+        const uint8_t *r0 = src + p * plane_step + y0 * row_step;
+        const uint8_t *r1 = src + p * plane_step + yn * row_step;
+        uint32_t top = r0[x0] * (256 - fx) + r0[xn] * fx;
+        uint32_t bot = r1[x0] * (256 - fx) + r1[xn] * fx;
+        dst[p * dst_plane + dy * dst_w + dx] =
+          (uint8_t) ((top * (256 - fy) + bot * fy + (1 << 15)) >> 16);
+      }
+    }
+  }
+}
+
+void crop_resize_planar(const uint8_t *src, int src_w, int src_h,
+                        int x, int y, int w, int h,
+                        uint8_t *dst, int dst_w, int dst_h, int num_planes)
+{
+  crop_resize(src, src_w, src_h, src_w * src_h, src_w, 1, x, y, w, h,
+              dst, dst_w, dst_h, num_planes);
+}
+
+void resize_packed_to_planar(const uint8_t *src, int src_w, int src_h,
+                             int bytes_pp, uint8_t *dst, int dst_w, int dst_h,
+                             int num_planes)
+{
+  crop_resize(src, src_w, src_h, 1, src_w * bytes_pp, bytes_pp,
+              0, 0, src_w, src_h, dst, dst_w, dst_h, num_planes);
+}
+
+static inline uint8_t clamp_u8(int v)
+{
+  return (uint8_t) (v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+void crop_resize_yuyv_to_bgrx(const uint8_t *src, int src_w, int src_h,
+                              int x, int y, int w, int h,
+                              uint8_t *dst, int dst_w, int dst_h,
+                              int dst_stride)
+{
+  int x1 = std::min(x + w, src_w);
+  int y1 = std::min(y + h, src_h);
+  x = std::max(x, 0);
+  y = std::max(y, 0);
+  w = x1 - x;
+  h = y1 - y;
+  if (w <= 0 || h <= 0 || dst_w <= 0 || dst_h <= 0) return;
+
+  int row_step = src_w * 2;
+  int32_t step_x = (int32_t) (((int64_t) w << FIX_SHIFT) / dst_w);
+  int32_t step_y = (int32_t) (((int64_t) h << FIX_SHIFT) / dst_h);
+
+  for (int dy = 0; dy < dst_h; dy++) {
+    int32_t sy = (y << FIX_SHIFT) + dy * step_y + step_y / 2 - FIX_ONE / 2;
+    sy = std::max(sy, y << FIX_SHIFT);
+    int y0 = sy >> FIX_SHIFT;
+    int yn = std::min(y0 + 1, y1 - 1);
+    uint32_t fy = (sy >> (FIX_SHIFT - 8)) & 0xff;
+    const uint8_t *r0 = src + y0 * row_step;
+    const uint8_t *r1 = src + yn * row_step;
+    uint8_t *out = dst + dy * dst_stride;
+
+    for (int dx = 0; dx < dst_w; dx++) {
+      int32_t sx = (x << FIX_SHIFT) + dx * step_x + step_x / 2 - FIX_ONE / 2;
+      sx = std::max(sx, x << FIX_SHIFT);
+      int x0 = sx >> FIX_SHIFT;
+      int xn = std::min(x0 + 1, x1 - 1);
+      uint32_t fx = (sx >> (FIX_SHIFT - 8)) & 0xff;
+
+      // luma is interpolated, chroma is taken from the nearest pixel pair
+      uint32_t top = r0[x0 * 2] * (256 - fx) + r0[xn * 2] * fx;
+      uint32_t bot = r1[x0 * 2] * (256 - fx) + r1[xn * 2] * fx;
+      int luma = (int) ((top * (256 - fy) + bot * fy + (1 << 15)) >> 16);
+      const uint8_t *pair = (fy < 128 ? r0 : r1) + (x0 & ~1) * 2;
+      int c = luma - 16;
+      int d = pair[1] - 128;
+      int e = pair[3] - 128;
+
+      // BT.601, limited range
+      out[0] = clamp_u8((298 * c + 516 * d + 128) >> 8);
+      out[1] = clamp_u8((298 * c - 100 * d - 208 * e + 128) >> 8);
+      out[2] = clamp_u8((298 * c + 409 * e + 128) >> 8);
+      out[3] = 255;
+      out += 4;
+    }
+  }
+}
@@ -0,0 +1,61 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef CROP_KERNELS_H
+#define CROP_KERNELS_H
+
+#include <stdint.h>
+
+/* Bilinear scale of the w x h region at (x, y) of a planar image (num_planes
+ * planes of src_w x src_h bytes, e.g. the BGR input of a TIDL network) into a
+ * planar dst_w x dst_h image. The region is clipped to the source. Writes
+ * straight into dst, no memory is allocated.
+ */
+void crop_resize_planar(const uint8_t *src, int src_w, int src_h,
+                        int x, int y, int w, int h,
+                        uint8_t *dst, int dst_w, int dst_h, int num_planes);
+
+/* Bilinear scale of a packed image of bytes_pp bytes per pixel (e.g. the
+ * BGRx output of the VPE) into the first num_planes planes of a planar
+ * dst_w x dst_h image.
+ */
+void resize_packed_to_planar(const uint8_t *src, int src_w, int src_h,
+                             int bytes_pp, uint8_t *dst, int dst_w, int dst_h,
+                             int num_planes);
+
+/* Bilinear scale of the w x h region at (x, y) of a YUYV capture into a
+ * packed BGRx image of dst_w x dst_h, converting with BT.601 limited range.
+ * Rows of dst are dst_stride bytes apart, so that dst can be a region of a
+ * larger image.
+ */
+void crop_resize_yuyv_to_bgrx(const uint8_t *src, int src_w, int src_h,
+                              int x, int y, int w, int h,
+                              uint8_t *dst, int dst_w, int dst_h,
+                              int dst_stride);
+
+#endif // CROP_KERNELS_H
@@ -49,7 +49,6 @@ extern "C" {
 #include "error.h"
 #include "disp_obj.h"
 #include "save_utils.h"
-#include "cmem_buf.h"
 
 /* align x to next highest multiple of 2^n */
 #define ALIGN2(x,n)   (((x) + ((1 << (n)) - 1)) & ~((1 << (n)) - 1))
@@ -70,6 +69,13 @@ DRMDeviceInfo::DRMDeviceInfo() {
 	height=0;
 	bo_flags = OMAP_BO_SCANOUT;
 	fd = 0;
+	for (int i = 0; i < MAX_DRM_PLANES; i++) {
+		num_buffers[i] = 0;
+		plane_data_buffer[i] = NULL;
+		plane_buf[i] = -1;
+		plane_alpha[i] = 255;
+		plane_zorder[i] = i + 1;
+	}
 }
 
 
@@ -78,176 +84,42 @@ DRMDeviceInfo::~DRMDeviceInfo() {
     free_vid_buffers(i);
 }
 
-/* If the use case need the buffer to be accessed by CPU for some processings,
- * then CMEM buffer can be used as they support cache operations by CPU.
- * omap_drm buffers doesn't support cache read. CPU can take 10x to 60x
- * more cycles to operate on non cached buffer.
+/* Show the buffers of pool (the VPE output) on plane channel_number. They
+ * stay owned by the pool, which has to outlive their use by the display.
  */
-DmaBuffer *DRMDeviceInfo::alloc_buffer(unsigned int fourcc, unsigned int w,
-          unsigned int h, unsigned int n, unsigned int bytes_pp)
+bool DRMDeviceInfo::export_buffer(BufferPool &pool, int channel_number)
 {
-	DmaBuffer *buf;
-	unsigned int bo_handles[4] = {0}, offsets[4] = {0};
-	int ret;
-
-	buf = (class DmaBuffer *) calloc(1, sizeof(class DmaBuffer));
-	if (!buf) {
-		ERROR("allocation failed");
-		return NULL;
-	}
-
-	buf->fourcc = fourcc;
-	buf->width = w;
-	buf->height = h;
-	buf->pitches[0] = w*bytes_pp;
-
-  buf->bo = (struct omap_bo **) calloc(4, sizeof(omap_bo *));
-
-  if (use_cmem) {
-
-    MSG("\nAllocating memory from CMEM pool\n");
-    buf->buf_mem_addr = (void **) calloc(4, sizeof(unsigned int));
-    buf->fd[0] = alloc_cmem_buffer(w*h*bytes_pp, 1, &buf->buf_mem_addr[0]);
-    if(buf->fd[0] < 0){
-			free_cmem_buffer(buf->buf_mem_addr[0]);
-			printf(" Cannot export CMEM buffer\n");
-			return NULL;
-		}
-
-    /* Get the omap bo from the fd allocted using CMEM */
-    buf->bo[0] = omap_bo_from_dmabuf(dev, buf->fd[0]);
-    if (buf->bo[0]){
-      bo_handles[0] = omap_bo_handle(buf->bo[0]);
-    }
-  }
-  else {
-  	MSG("\nAllocating memory from OMAP DRM pool\n");
-
-  	//You can use DRM ioctl as well to allocate buffers (DRM_IOCTL_MODE_CREATE_DUMB)
-  	//and drmPrimeHandleToFD() to get the buffer descriptors
-  	buf->bo[0] = omap_bo_new(dev,w*h*bytes_pp, bo_flags | OMAP_BO_WC);
-  	if (buf->bo[0]){
-  		bo_handles[0] = omap_bo_handle(buf->bo[0]);
-  	}
-  	buf->fd[0] = omap_bo_dmabuf(buf->bo[0]);
+  if (!pool.add_framebuffers(fd)) {
+    ERROR("Could not add the framebuffers of plane %d", channel_number);
+    return false;
   }
-  print_omap_bo(buf->bo[0]);
-
-	ret = drmModeAddFB2(fd, buf->width, buf->height, fourcc,
-		bo_handles, buf->pitches, offsets, &buf->fb_id, 0);
-
-  buf->buf_mem_addr = (void **) calloc(4, sizeof(unsigned int));
-  buf->buf_mem_addr[0] = omap_bo_map(buf->bo[0]);
-
-  MSG("fd = %d - buf->width = %d - buf->height = %d - fourcc = %d", fd, buf->width, buf->height, fourcc);
-  for (int i=0;i<4;i++)
-    MSG("%d: bo_handles = %d - buf->pitches = %d - offsets = %d - &buf->fb_id = %d", i, bo_handles[i], buf->pitches[i], offsets[i], buf->fb_id);
-
-	if (ret) {
-		ERROR("drmModeAddFB2 failed: %s (%d)", strerror(errno), ret);
-		return NULL;
-	}
-
-	return buf;
-}
-
-
-/* If the use case need the buffer to be accessed by CPU for some processings,
- * then CMEM buffer can be used as they support cache operations by CPU.
- * omap_drm buffers doesn't support cache read. CPU can take 10x to 60x
- * more cycles to operate on non cached buffer.
- */
-bool DRMDeviceInfo::export_buffer(DmaBuffer **db, int num_bufs, int bytes_pp,
-                                  int channel_number)
-{
-  if (db) {
-    for (int i=0; i<num_bufs; i++) {
-      unsigned int bo_handles[4] = {0}, offsets[4] = {0};
-      int ret;
-    	db[i]->pitches[0] = db[i]->width*bytes_pp;
-      if (use_cmem) {
-
-        /* Get the omap bo from the fd allocted using CMEM */
-        db[i]->bo[0] = omap_bo_from_dmabuf(dev, db[i]->fd[0]);
-        if (db[i]->bo[0]) {
-          bo_handles[0] = omap_bo_handle(db[i]->bo[0]);
-        }
-      }
-      else {
-      	if (db[i]->bo[0]){
-      		bo_handles[0] = omap_bo_handle(db[i]->bo[0]);
-      	}
-        else {
-          ERROR("Passed unallocated buffers to export_buffer function");
-          return false;
-        }
-      }
-    	ret = drmModeAddFB2(fd, db[i]->width, db[i]->height, db[i]->fourcc,
-    		bo_handles, db[i]->pitches, offsets, &db[i]->fb_id, 0);
-
-    	if (ret) {
-    		ERROR("drmModeAddFB2 failed: %s (%d)", strerror(errno), ret);
-    		return false;
-    	}
-      MSG("%d: bo_handles = %d - offsets = %d ", i, bo_handles[0], offsets[0]);
-      MSG("%d", ret);
-    }
-    MSG("fd = %d", fd);
-    for (int i=0;i<num_bufs;i++) {
-      MSG("%d: buf->width = %d - buf->height = %d - buf->fourcc = %d - buf->pitches = %d -" \
-          " buf->fb_id = %d", i, db[i]->width, db[i]->height, db[i]->fourcc, db[i]->pitches[0], db[i]->fb_id);
-    }
-
-  }
-  plane_data_buffer[channel_number] = db;
-	return true;
+  plane_data_buffer[channel_number] = pool.data();
+  return true;
 }
 
 void DRMDeviceInfo::free_vid_buffers(unsigned int channel)
 {
-	unsigned int i;
-
-	if (plane_data_buffer[channel] == NULL) return;
-	for (i = 0; i < num_buffers[channel]; i++) {
-		if (plane_data_buffer[channel][i]) {
-			close(plane_data_buffer[channel][i]->fd[0]);
-			omap_bo_del(plane_data_buffer[channel][i]->bo[0]);
-			free(plane_data_buffer[channel][i]);
-		}
-	}
-	free(plane_data_buffer[channel]);
+	plane_pool[channel].release();
+	plane_data_buffer[channel] = NULL;
+	num_buffers[channel] = 0;
 }
 
-
+/* n framebuffers for plane channel, from the CMEM slab if there is room */
 bool DRMDeviceInfo::get_vid_buffers(unsigned int n,
 		unsigned int fourcc, unsigned int w, unsigned int h, unsigned int bytes_pp,
     unsigned int channel)
 {
-	unsigned int i = 0;
-
-	plane_data_buffer[channel] = (DmaBuffer **) calloc(n,
-    sizeof(*plane_data_buffer[channel]));
-	if (!plane_data_buffer[channel]) {
-		ERROR("allocation failed");
-		goto fail;
-	}
-
-  num_buffers[channel] = n;
-
-	for (i = 0; i < n; i++) {
-		plane_data_buffer[channel][i] = alloc_buffer(fourcc, w, h, n, bytes_pp);
-		if (!plane_data_buffer[channel][i]) {
-			ERROR("allocation failed");
-			goto fail;
-		}
+	if (!plane_pool[channel].alloc(dev, n, fourcc, w, h, bytes_pp,
+	                               use_cmem ? BUF_CMEM_SLAB : BUF_OMAP) ||
+	    !plane_pool[channel].add_framebuffers(fd)) {
+		free_vid_buffers(channel);
+		return false;
 	}
+	plane_data_buffer[channel] = plane_pool[channel].data();
+	num_buffers[channel] = n;
 	return true;
-
-fail:
-	return false;
 }
 
-
 /*********************METHODS FOR PROPERTY MANAGEMENT***********************/
 
 unsigned int DRMDeviceInfo::get_drm_prop_val(drmModeObjectPropertiesPtr props,
@@ -321,7 +193,6 @@ void DRMDeviceInfo::drm_add_plane_property(drmModeAtomicReqPtr req,
 	unsigned int crtc_w_val = width;
 	unsigned int crtc_h_val = height;
 	drmModeObjectProperties *props;
-	unsigned int _zorder_val = 1;
 
 	for(i = 0; i < num_planes; i++){
 
@@ -341,7 +212,8 @@ void DRMDeviceInfo::drm_add_plane_property(drmModeAtomicReqPtr req,
 		prop_crtcid = find_drm_prop_id(props, "CRTC_ID");
 
 		// storing zorder val to restore it before quitting the demo
-		zorder_val[i] = get_drm_prop_val(props, "zorder");
+		if (!props_saved)
+			zorder_val[i] = get_drm_prop_val(props, "zorder");
 
 		add_property(fd, req, props, plane_id[i], "FB_ID", plane_data_buffer[i][0]->fb_id);
 
@@ -367,6 +239,14 @@ void DRMDeviceInfo::drm_add_plane_property(drmModeAtomicReqPtr req,
   		add_property(fd, req, props, plane_id[i], "SRC_W", plane0->width << 16);
   		add_property(fd, req, props, plane_id[i], "SRC_H", plane0->height << 16);
     }
+    else if (i > 1) {
+      // additional overlays are sized by their own buffers
+      add_property(fd, req, props, plane_id[i], "SRC_H",
+                   plane_data_buffer[i][0]->height << 16);
+      add_property(fd, req, props, plane_id[i], "SRC_W",
+                   plane_data_buffer[i][0]->width << 16);
+      add_property(fd, req, props, plane_id[i], "global_alpha", plane_alpha[i]);
+    }
     else {
       // if we are doing a segmentation demo that needs the TIDL output and
       // DSS plane1 input to be shared
@@ -380,7 +260,7 @@ void DRMDeviceInfo::drm_add_plane_property(drmModeAtomicReqPtr req,
       }
       add_property(fd, req, props, plane_id[i], "global_alpha", alpha);
     }
-		add_property(fd, req, props, plane_id[i], "zorder", _zorder_val++);
+		add_property(fd, req, props, plane_id[i], "zorder", plane_zorder[i]);
 
 	}
 }
@@ -543,8 +423,14 @@ int DRMDeviceInfo::drm_init_device(int n_planes)
 	// /* Store display resolution so GUI can be configured */
 	// status.display_xres = width;
 	// status.display_yres = height;
+  if (n_planes > MAX_DRM_PLANES - 1) {
+    ERROR("At most %d planes can be used, %d requested", MAX_DRM_PLANES - 1,
+          n_planes);
+    return -1;
+  }
   num_planes = n_planes;
-	drm_reserve_plane(plane_id, num_planes);
+	if (drm_reserve_plane(plane_id, num_planes) != 0)
+		return -1;
 
 	return 0;
 }
@@ -563,7 +449,8 @@ int DRMDeviceInfo::drm_init_dss(ImageParams *plane0, ImageParams *plane1,
   char trans_key_mode = 1;
 
 	fp = fopen("/proc/sys/kernel/hostname", "r");
-	fscanf(fp, "%s", str);
+	fscanf(fp, "%9s", str);
+	fclose(fp);
 
 	/* terminate the string after the processor name. "-evm" extension is
 	 * ignored in case the demo gets supported on other boards like idk etc
@@ -587,10 +474,12 @@ int DRMDeviceInfo::drm_init_dss(ImageParams *plane0, ImageParams *plane1,
   	return -1;
   }
 
-	zorder_val_primary_plane = get_drm_prop_val(
-		props, "zorder");
-	trans_key_mode_val = get_drm_prop_val( props,
-		"trans-key-mode");
+	if (!props_saved) {
+		zorder_val_primary_plane = get_drm_prop_val(
+			props, "zorder");
+		trans_key_mode_val = get_drm_prop_val( props,
+			"trans-key-mode");
+	}
 
 	add_property(fd, req, props, crtc_id,
 		"trans-key-mode", trans_key_mode);
@@ -620,6 +509,7 @@ int DRMDeviceInfo::drm_init_dss(ImageParams *plane0, ImageParams *plane1,
 	}
 
 	drmModeAtomicFree(req);
+	props_saved = true;
 	return 0;
 }
 
@@ -641,17 +531,23 @@ void DRMDeviceInfo::drm_exit_device()
 }
 
 
+// user data of the page flip events of disp_frame
+struct flip_wait {
+	int waiting;
+	DRMDeviceInfo *dev;
+};
+
 static void page_flip_handler(int fd, unsigned int frame,
 							  unsigned int sec, unsigned int usec,
 							  void *data)
 {
-	int *waiting_for_flip = (int *)data;
-	*waiting_for_flip = 0;
+	struct flip_wait *wait = (struct flip_wait *)data;
+	wait->waiting = 0;
+	// the event is stamped with CLOCK_MONOTONIC, as are the captures
+	wait->dev->last_flip_us = (uint64_t) sec * 1000000 + usec;
 
 	(void) fd;
 	(void) frame;
-	(void) sec;
-	(void) usec;
 }
 
 /* If the user would like this library to control the queue/dequeue of the
@@ -659,8 +555,9 @@ static void page_flip_handler(int fd, unsigned int frame,
  */
 void DRMDeviceInfo::disp_frame(VIPObj *vip, int *exported_fds) {
   fd_set fds;
-	int ret, frame_num, waiting_for_flip = 1;
-	class DmaBuffer *buf[2] = {NULL, NULL};
+	int ret, frame_num;
+	struct flip_wait wait = {1, this};
+	class DmaBuffer *buf[MAX_DRM_PLANES] = {NULL};
 	drmModeAtomicReqPtr req = drmModeAtomicAlloc();
   drmEventContext evctx = {
 		.version = DRM_EVENT_CONTEXT_VERSION,
@@ -675,7 +572,7 @@ void DRMDeviceInfo::disp_frame(VIPObj *vip, int *exported_fds) {
     ret = drmModeAtomicCommit(fd, req, DRM_MODE_ATOMIC_TEST_ONLY, 0);
     if (!ret){
       drmModeAtomicCommit(fd, req,
-        DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK, &waiting_for_flip);
+        DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK, &wait);
     }
     else {
       ERROR("failed to add plane atomically: %s", strerror(errno));
@@ -688,7 +585,7 @@ void DRMDeviceInfo::disp_frame(VIPObj *vip, int *exported_fds) {
   FD_ZERO(&fds);
 	FD_SET(fd, &fds);
 
-	while (waiting_for_flip) {
+	while (wait.waiting) {
 		ret = select(fd + 1, &fds, NULL, NULL, NULL);
 		if (ret < 0) {
 			ERROR("select err: %s\n", strerror(errno));
@@ -712,8 +609,9 @@ void DRMDeviceInfo::disp_frame(VIPObj *vip, int *exported_fds) {
  */
 void DRMDeviceInfo::disp_frame(int frame_num) {
   fd_set fds;
-	int ret, waiting_for_flip = 1;
-	class DmaBuffer *buf[2] = {NULL, NULL};
+	int ret;
+	struct flip_wait wait = {1, this};
+	class DmaBuffer *buf[MAX_DRM_PLANES] = {NULL};
 	drmModeAtomicReqPtr req = drmModeAtomicAlloc();
   drmEventContext evctx = {
 		.version = DRM_EVENT_CONTEXT_VERSION,
@@ -721,17 +619,21 @@ void DRMDeviceInfo::disp_frame(int frame_num) {
 		.page_flip_handler = page_flip_handler,
 	};
 
+  last_flip_us = 0;
+  // all planes flip together with one commit
   for (int i=0; i < (int) num_planes; i++) {
-    buf[i] = plane_data_buffer[i][frame_num];
+    int b = (i > 0 && plane_buf[i] >= 0) ? plane_buf[i] : frame_num;
+    buf[i] = plane_data_buffer[i][b];
     drmModeAtomicAddProperty(req, plane_id[i], prop_fbid, buf[i]->fb_id);
-    ret = drmModeAtomicCommit(fd, req, DRM_MODE_ATOMIC_TEST_ONLY, 0);
-    if (!ret){
-      drmModeAtomicCommit(fd, req,
-        DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK, &waiting_for_flip);
-    }
-    else {
-      ERROR("failed to add plane atomically: %s", strerror(errno));
-    }
+  }
+  ret = drmModeAtomicCommit(fd, req, DRM_MODE_ATOMIC_TEST_ONLY, 0);
+  if (!ret){
+    ret = drmModeAtomicCommit(fd, req,
+      DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK, &wait);
+  }
+  if (ret) {
+    ERROR("failed to add planes atomically: %s", strerror(errno));
+    wait.waiting = 0;
   }
 
 	drmModeAtomicFree(req);
@@ -739,7 +641,7 @@ void DRMDeviceInfo::disp_frame(int frame_num) {
   FD_ZERO(&fds);
 	FD_SET(fd, &fds);
 
-	while (waiting_for_flip) {
+	while (wait.waiting) {
 		ret = select(fd + 1, &fds, NULL, NULL, NULL);
 		if (ret < 0) {
 			ERROR("select err: %s\n", strerror(errno));
@@ -29,6 +29,7 @@
 #include <xf86drmMode.h>
 #include <linux/videodev2.h>
 #include <string>
+#include "buffer_pool.h"
 #define PAGE_SHIFT 12
 #define MAX_DRM_PLANES 5
 #define CAP_WIDTH 800
@@ -37,22 +38,6 @@
 #define PIP_POS_Y  25
 #define MAX_ZORDER_VAL 3 //For AM57x device, max zoder value is 3
 
-class DmaBuffer {
-public:
-	uint32_t fourcc, width, height;
-	int num_buffer_objects;
-	void *cmem_buf;
-	/* The [4]'s are due to the fact that the DSS can  support up to 4 planes of
-	 * operation. If the user wants to populate the second plane, they may place
-	 * the data in [1], [2], or [3]
-	 */
-	struct omap_bo **bo;
-	void **buf_mem_addr;
-	uint32_t pitches[4];
-	int fd[4];		/* dmabuf */
-	unsigned fb_id;
-};
-
 class ConnectorInfo {
 public:
 	unsigned int id;
@@ -70,13 +55,11 @@ public:
 class DRMDeviceInfo
 {
 public:
-	DmaBuffer *alloc_buffer(unsigned int fourcc, unsigned int w,
-								          unsigned int h, unsigned int n, unsigned int bytes_pp);
 	void free_vid_buffers(unsigned int channel);
 	bool get_vid_buffers(unsigned int _n, unsigned int _fourcc, unsigned int _w,
-											 unsigned int _h, unsigned int channel,
-											 unsigned int bytes_pp);
-	bool export_buffer(DmaBuffer **db, int num_bufs, int bytes_pp, int channel_number);
+											 unsigned int _h, unsigned int bytes_pp,
+											 unsigned int channel);
+	bool export_buffer(BufferPool &pool, int channel_number);
   DRMDeviceInfo();
 	~DRMDeviceInfo();
 
@@ -108,19 +91,29 @@ public:
 	char name[4];
 	unsigned int bo_flags;
 
-	/* There are two buffers for the two planes that will exist in the DSS
-	 * plane_data_buffer[0]
+	/* There is one set of buffers for every plane that is used in the DSS:
+	 * plane_data_buffer[0] is the video, the others are overlays. The
+	 * overlay buffers are owned by plane_pool, the video buffers by the
+	 * pool that was exported to the display.
+	 */
+	unsigned int num_buffers[MAX_DRM_PLANES];
+	DmaBuffer **plane_data_buffer[MAX_DRM_PLANES];
+	BufferPool plane_pool[MAX_DRM_PLANES];
+	/* Overlays that are not redrawn with every video frame keep showing
+	 * buffer plane_buf[i], -1 makes plane i follow the video frame
 	 */
-	unsigned int num_buffers[2];
-	DmaBuffer **plane_data_buffer[2];
-	struct omap_device *dev;
+	int plane_buf[MAX_DRM_PLANES];
+	// global alpha and zorder of every plane beyond the first overlay
+	int plane_alpha[MAX_DRM_PLANES];
+	unsigned int plane_zorder[MAX_DRM_PLANES];
+	struct omap_device *dev = NULL;
 	unsigned int crtc_id;
-	unsigned int plane_id[2];
+	unsigned int plane_id[MAX_DRM_PLANES];
 	unsigned int prop_fbid;
 	unsigned int prop_crtcid;
 	uint64_t zorder_val_primary_plane;
 	uint64_t trans_key_mode_val;
-	uint32_t zorder_val[MAX_DRM_PLANES-1];
+	uint32_t zorder_val[MAX_DRM_PLANES];
 
   unsigned int main_cam;
   unsigned int num_planes = 0;
@@ -130,4 +123,8 @@ public:
   bool pip;
   bool jpeg;
   bool exit;
+	// CLOCK_MONOTONIC time in us of the flip of the last disp_frame, 0 if none
+	uint64_t last_flip_us = 0;
+	// the properties to restore at exit have been read by drm_init_dss
+	bool props_saved = false;
 };
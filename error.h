@@ -31,6 +31,7 @@
 
 #include <stdio.h>
 #include <errno.h>
+#include "async_log.h"
 
 #define ERROR(fmt, ...) \
     do { fprintf(stderr, "ERROR:%s %s:%d: " fmt "\n", __FILE__, __func__, __LINE__,\
@@ -39,9 +40,12 @@
 #define MSG(fmt, ...) \
     do { fprintf(stderr, fmt "\n", ##__VA_ARGS__); } while (0)
 
-/* Dynamic debug. */
+/* Dynamic debug, compiled in with LOG_LEVEL >= LOGLVL_DEBUG and written
+ * right away. Messages of the frame loop go through LOGD() instead.
+ */
 #define DBG(fmt, ...) \
-  do { fprintf(stderr, fmt "\n", ##__VA_ARGS__); } while (0)
+  do { if (LOG_LEVEL >= LOGLVL_DEBUG && async_log_level >= LOGLVL_DEBUG) \
+    fprintf(stderr, fmt "\n", ##__VA_ARGS__); } while (0)
 
 #define FOURCC(a, b, c, d) ((uint32_t)(uint8_t)(a) | \
     ((uint32_t)(uint8_t)(b) << 8) | ((uint32_t)(uint8_t)(c) << 16) | \
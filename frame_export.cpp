@@ -0,0 +1,504 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/dma-buf.h>
+#include "frame_export.h"
+#include "error.h"
+
+static bool socket_address(const std::string &path, struct sockaddr_un &addr)
+{
+  if (path.size() >= sizeof(addr.sun_path)) {
+    ERROR("frame export: socket path %s is too long", path.c_str());
+    return false;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+  return true;
+}
+
+// one message, with fds attached if num_fds > 0
+static bool send_msg(int sock, const frame_export_msg_t &msg, const int *fds,
+                     int num_fds)
+{
+  char control[CMSG_SPACE(sizeof(int) * FRAME_EXPORT_MAX_BUFFERS)];
+  struct iovec iov = {(void *) &msg, sizeof(msg)};
+  struct msghdr hdr;
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+  if (num_fds > 0) {
+    memset(control, 0, sizeof(control));
+    hdr.msg_control = control;
+    hdr.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
+  }
+  return sendmsg(sock, &hdr, MSG_DONTWAIT | MSG_NOSIGNAL) == sizeof(msg);
+}
+
+static double now_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void sync_buffer(int fd, uint64_t flags)
+{
+  // not every exporter implements it, e.g. uncached memory
+  struct dma_buf_sync sync = {flags};
+  ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+}
+
+FrameExporter::FrameExporter() : listen_fd(-1), frames(0), sent(0),
+  skipped(0), clients_total(0), clients_dropped(0)
+{
+  memset(&format, 0, sizeof(format));
+  for (int c = 0; c < FRAME_EXPORT_MAX_CLIENTS; c++)
+    client_fd[c] = -1;
+  for (int i = 0; i < FRAME_EXPORT_MAX_BUFFERS; i++) {
+    held_by[i] = 0;
+    held_since[i] = 0;
+    retired_by[i] = 0;
+    retired_since[i] = 0;
+    fds[i] = -1;
+  }
+}
+
+bool FrameExporter::open(const std::string &path)
+{
+  struct sockaddr_un addr;
+
+  close();
+  if (!socket_address(path, addr))
+    return false;
+  // a socket left behind by an earlier run
+  unlink(path.c_str());
+  listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                     0);
+  if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *) &addr,
+                            sizeof(addr)) < 0 ||
+      listen(listen_fd, FRAME_EXPORT_MAX_CLIENTS) < 0) {
+    ERROR("frame export: could not listen on %s: %s", path.c_str(),
+          strerror(errno));
+    close();
+    return false;
+  }
+  socket_path = path;
+  MSG("Exporting the frames on %s", path.c_str());
+  return true;
+}
+
+void FrameExporter::close()
+{
+  for (int c = 0; c < FRAME_EXPORT_MAX_CLIENTS; c++)
+    if (client_fd[c] >= 0)
+      drop(c);
+  if (listen_fd >= 0)
+    ::close(listen_fd);
+  listen_fd = -1;
+  if (socket_path != "")
+    unlink(socket_path.c_str());
+  socket_path = "";
+}
+
+void FrameExporter::set_buffers(const int *_fds, int num,
+                                const frame_export_msg_t &fmt)
+{
+  uint32_t generation = format.generation + 1;
+
+  if (num > FRAME_EXPORT_MAX_BUFFERS) {
+    ERROR("frame export: %d buffers, only the first %d are exported", num,
+          FRAME_EXPORT_MAX_BUFFERS);
+    num = FRAME_EXPORT_MAX_BUFFERS;
+  }
+  if (retired_held())
+    LOGW("frame export: buffers of generation %u are still held and no "
+         "longer tracked", format.generation - 1);
+  format = fmt;
+  format.type = FRAME_EXPORT_BUFFERS;
+  format.generation = generation;
+  format.num_buffers = num;
+  for (int i = 0; i < FRAME_EXPORT_MAX_BUFFERS; i++) {
+    fds[i] = i < num ? _fds[i] : -1;
+    retired_by[i] = held_by[i];
+    retired_since[i] = held_since[i];
+    held_by[i] = 0;
+  }
+  for (int c = 0; c < FRAME_EXPORT_MAX_CLIENTS; c++)
+    if (client_fd[c] >= 0 && !send_buffers(c))
+      drop(c);
+}
+
+bool FrameExporter::send_buffers(int c)
+{
+  if (format.num_buffers == 0)
+    return true;
+  if (!send_msg(client_fd[c], format, fds, format.num_buffers)) {
+    LOGW("frame export: buffers could not be sent to client %d: %s", c,
+         strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+void FrameExporter::accept_clients()
+{
+  for (;;) {
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+    int c = 0;
+    while (c < FRAME_EXPORT_MAX_CLIENTS && client_fd[c] >= 0)
+      c++;
+    if (c == FRAME_EXPORT_MAX_CLIENTS) {
+      LOGW("frame export: more than %d clients, connection refused",
+           FRAME_EXPORT_MAX_CLIENTS);
+      ::close(fd);
+      continue;
+    }
+    client_fd[c] = fd;
+    clients_total++;
+    LOGI("frame export: client %d connected", c);
+    if (!send_buffers(c))
+      drop(c);
+  }
+}
+
+void FrameExporter::receive(int c)
+{
+  frame_export_msg_t msg;
+
+  for (;;) {
+    ssize_t n = recv(client_fd[c], &msg, sizeof(msg), MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return;
+    if (n <= 0) {
+      drop(c);
+      return;
+    }
+    // releases of the generations before the last but one are stale
+    if (n != sizeof(msg) || msg.type != FRAME_EXPORT_RELEASE ||
+        msg.index >= FRAME_EXPORT_MAX_BUFFERS)
+      continue;
+    if (msg.generation == format.generation)
+      held_by[msg.index] &= ~(1u << c);
+    else if (msg.generation == format.generation - 1)
+      retired_by[msg.index] &= ~(1u << c);
+  }
+}
+
+// whatever the client held is given back with it
+void FrameExporter::drop(int c)
+{
+  ::close(client_fd[c]);
+  client_fd[c] = -1;
+  for (int i = 0; i < FRAME_EXPORT_MAX_BUFFERS; i++) {
+    held_by[i] &= ~(1u << c);
+    retired_by[i] &= ~(1u << c);
+  }
+  LOGI("frame export: client %d disconnected", c);
+}
+
+void FrameExporter::poll()
+{
+  if (listen_fd < 0)
+    return;
+  accept_clients();
+  for (int c = 0; c < FRAME_EXPORT_MAX_CLIENTS; c++)
+    if (client_fd[c] >= 0)
+      receive(c);
+
+  double now = now_ms();
+  for (uint32_t i = 0; i < FRAME_EXPORT_MAX_BUFFERS; i++) {
+    uint32_t late = 0;
+    if (held_by[i] && now - held_since[i] >= FRAME_EXPORT_HOLD_TIMEOUT_MS)
+      late |= held_by[i];
+    if (retired_by[i] && now - retired_since[i] >= FRAME_EXPORT_HOLD_TIMEOUT_MS)
+      late |= retired_by[i];
+    for (int c = 0; c < FRAME_EXPORT_MAX_CLIENTS; c++) {
+      if (!(late & (1u << c)))
+        continue;
+      LOGW("frame export: client %d held buffer %u for over %d ms, dropped",
+           c, i, FRAME_EXPORT_HOLD_TIMEOUT_MS);
+      clients_dropped++;
+      drop(c);
+    }
+  }
+}
+
+bool FrameExporter::retired_held() const
+{
+  for (int i = 0; i < FRAME_EXPORT_MAX_BUFFERS; i++)
+    if (retired_by[i])
+      return true;
+  return false;
+}
+
+void FrameExporter::wait_retired()
+{
+  while (listen_fd >= 0 && retired_held()) {
+    usleep(1000);
+    poll();
+  }
+}
+
+void FrameExporter::publish(int index, uint32_t sequence, uint64_t capture_us)
+{
+  if (listen_fd < 0 || index < 0 || index >= (int) format.num_buffers)
+    return;
+
+  int num_clients = 0, num_held = 0;
+  for (int c = 0; c < FRAME_EXPORT_MAX_CLIENTS; c++)
+    num_clients += client_fd[c] >= 0;
+  for (uint32_t i = 0; i < format.num_buffers; i++)
+    num_held += held_by[i] != 0;
+  if (num_clients == 0)
+    return;
+  frames++;
+  if (num_held >= FRAME_EXPORT_HELD_BUFFERS) {
+    skipped += num_clients;
+    return;
+  }
+
+  frame_export_msg_t msg = format;
+  msg.type = FRAME_EXPORT_FRAME;
+  msg.num_buffers = 0;
+  msg.index = index;
+  msg.sequence = sequence;
+  msg.capture_us = capture_us;
+  msg.frame = frames;
+  for (int c = 0; c < FRAME_EXPORT_MAX_CLIENTS; c++) {
+    if (client_fd[c] < 0)
+      continue;
+    if (send_msg(client_fd[c], msg, NULL, 0)) {
+      held_by[index] |= 1u << c;
+      sent++;
+    }
+    // the client did not read the frames before, it misses this one
+    else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      skipped++;
+    else
+      drop(c);
+  }
+  held_since[index] = now_ms();
+}
+
+void FrameExporter::report(const char *name) const
+{
+  if (clients_total == 0)
+    return;
+  MSG("%s: %llu frames to %llu clients, %llu sent, %llu skipped while %d "
+      "buffers were held, %llu clients dropped for holding one for over "
+      "%d ms", name, (unsigned long long) frames,
+      (unsigned long long) clients_total, (unsigned long long) sent,
+      (unsigned long long) skipped, FRAME_EXPORT_HELD_BUFFERS,
+      (unsigned long long) clients_dropped, FRAME_EXPORT_HOLD_TIMEOUT_MS);
+}
+
+FrameImporter::FrameImporter() : sock(-1)
+{
+  memset(&format, 0, sizeof(format));
+  memset(&old_format, 0, sizeof(old_format));
+  for (int i = 0; i < FRAME_EXPORT_MAX_BUFFERS; i++) {
+    fds[i] = old_fds[i] = -1;
+    maps[i] = old_maps[i] = NULL;
+  }
+}
+
+bool FrameImporter::connect(const std::string &path)
+{
+  struct sockaddr_un addr;
+
+  close();
+  if (!socket_address(path, addr))
+    return false;
+  sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (sock < 0 || ::connect(sock, (struct sockaddr *) &addr,
+                            sizeof(addr)) < 0) {
+    ERROR("frame export: could not connect to %s: %s", path.c_str(),
+          strerror(errno));
+    close();
+    return false;
+  }
+  return true;
+}
+
+void FrameImporter::close()
+{
+  unmap_buffers();
+  if (sock >= 0)
+    ::close(sock);
+  sock = -1;
+}
+
+static void unmap_set(frame_export_msg_t &fmt, int *fds, uint8_t **maps)
+{
+  for (int i = 0; i < FRAME_EXPORT_MAX_BUFFERS; i++) {
+    if (maps[i])
+      munmap(maps[i], fmt.size);
+    if (fds[i] >= 0)
+      ::close(fds[i]);
+    maps[i] = NULL;
+    fds[i] = -1;
+  }
+  fmt.num_buffers = 0;
+}
+
+void FrameImporter::unmap_buffers()
+{
+  unmap_set(old_format, old_fds, old_maps);
+  unmap_set(format, fds, maps);
+}
+
+/* The buffers before stay mapped as the old generation, frames of them
+ * may not be released yet
+ */
+bool FrameImporter::map_buffers(const frame_export_msg_t &msg,
+                                const int *new_fds)
+{
+  unmap_set(old_format, old_fds, old_maps);
+  old_format = format;
+  for (int i = 0; i < FRAME_EXPORT_MAX_BUFFERS; i++) {
+    old_fds[i] = fds[i];
+    old_maps[i] = maps[i];
+    fds[i] = -1;
+    maps[i] = NULL;
+  }
+  format = msg;
+  for (uint32_t i = 0; i < msg.num_buffers; i++)
+    fds[i] = new_fds[i];
+  for (uint32_t i = 0; i < msg.num_buffers; i++) {
+    void *p = mmap(NULL, msg.size, PROT_READ, MAP_SHARED, fds[i], 0);
+    if (p == MAP_FAILED) {
+      ERROR("frame export: buffer %u could not be mapped: %s", i,
+            strerror(errno));
+      return false;
+    }
+    maps[i] = (uint8_t *) p;
+  }
+  return true;
+}
+
+const uint8_t *FrameImporter::next(frame_export_msg_t &frame, int timeout_ms)
+{
+  char control[CMSG_SPACE(sizeof(int) * FRAME_EXPORT_MAX_BUFFERS)];
+  int new_fds[FRAME_EXPORT_MAX_BUFFERS];
+
+  while (sock >= 0) {
+    struct pollfd pfd = {sock, POLLIN, 0};
+    if (::poll(&pfd, 1, timeout_ms) == 0)
+      return NULL;
+
+    struct iovec iov = {&frame, sizeof(frame)};
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+    ssize_t n = recvmsg(sock, &hdr, MSG_CMSG_CLOEXEC);
+    if (n < 0 && errno == EINTR)
+      continue;
+
+    int num_fds = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg;
+         cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+      if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        continue;
+      int num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      memcpy(new_fds + num_fds, CMSG_DATA(cmsg), sizeof(int) * num);
+      num_fds += num;
+    }
+    if (n != sizeof(frame)) {
+      // the exporter is gone
+      for (int i = 0; i < num_fds; i++)
+        ::close(new_fds[i]);
+      close();
+      return NULL;
+    }
+
+    if (frame.type == FRAME_EXPORT_BUFFERS &&
+        num_fds == (int) frame.num_buffers) {
+      if (!map_buffers(frame, new_fds)) {
+        close();
+        return NULL;
+      }
+      continue;
+    }
+    for (int i = 0; i < num_fds; i++)
+      ::close(new_fds[i]);
+    if (frame.type == FRAME_EXPORT_BUFFERS) {
+      ERROR("frame export: %d of %u buffers received", num_fds,
+            frame.num_buffers);
+      close();
+      return NULL;
+    }
+    if (frame.type != FRAME_EXPORT_FRAME ||
+        frame.generation != format.generation ||
+        frame.index >= format.num_buffers)
+      continue;
+    sync_buffer(fds[frame.index], DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ);
+    return maps[frame.index];
+  }
+  return NULL;
+}
+
+void FrameImporter::release(const frame_export_msg_t &frame)
+{
+  if (sock < 0)
+    return;
+  if (frame.generation == format.generation &&
+      frame.index < format.num_buffers)
+    sync_buffer(fds[frame.index], DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ);
+  else if (frame.generation == old_format.generation &&
+           frame.index < old_format.num_buffers)
+    sync_buffer(old_fds[frame.index], DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ);
+  else
+    return;
+  frame_export_msg_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.type = FRAME_EXPORT_RELEASE;
+  msg.generation = frame.generation;
+  msg.index = frame.index;
+  send(sock, &msg, sizeof(msg), MSG_NOSIGNAL);
+}
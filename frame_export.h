@@ -0,0 +1,162 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef FRAME_EXPORT_H
+#define FRAME_EXPORT_H
+
+#include <stdint.h>
+#include <string>
+
+/* The output buffers of the VPE for other processes (--export-frames
+ * <socket>), without a copy and without a second open of the camera. A
+ * FrameExporter listens on a SOCK_SEQPACKET Unix domain socket and sends
+ * every client:
+ *
+ *   BUFFERS  the format and the dmabuf fds of all buffers (SCM_RIGHTS), on
+ *            connect and again whenever the buffers are replaced; the
+ *            generation counts the sets
+ *   FRAME    the index of the buffer that holds the next capture
+ *
+ * The buffer of a FRAME belongs to the client until it sends RELEASE with
+ * the same generation and index. CamDisp does not give a buffer back to the
+ * VPE while a client holds it, at most FRAME_EXPORT_HELD_BUFFERS of them
+ * are held at a time; frames beyond that are skipped for the clients, the
+ * frame loop never waits on them. A client that holds a buffer for longer
+ * than FRAME_EXPORT_HOLD_TIMEOUT_MS is dropped. The holds of the buffers of
+ * the generation before are still tracked after set_buffers, so that their
+ * owner can keep them until the clients let go of them (retired_held).
+ *
+ * FrameImporter is the client side, bench/frame_sink.cpp an example.
+ */
+#define FRAME_EXPORT_MAX_BUFFERS      16
+#define FRAME_EXPORT_MAX_CLIENTS      8
+#define FRAME_EXPORT_HELD_BUFFERS     2
+#define FRAME_EXPORT_HOLD_TIMEOUT_MS  2000
+
+enum frame_export_msg_type_t {
+  FRAME_EXPORT_BUFFERS = 1,
+  FRAME_EXPORT_FRAME = 2,
+  FRAME_EXPORT_RELEASE = 3,
+};
+
+typedef struct frame_export_msg_t_ {
+  uint32_t type;
+  uint32_t generation;
+  uint32_t index;        // FRAME, RELEASE: the buffer
+  uint32_t num_buffers;  // BUFFERS: fds attached, in the order of the index
+  uint32_t fourcc;
+  uint32_t width;
+  uint32_t height;
+  uint32_t stride;       // bytes per line
+  uint32_t size;         // bytes of a buffer
+  uint32_t sequence;     // FRAME: V4L2 sequence of the capture
+  uint64_t capture_us;   // FRAME: V4L2 timestamp, CLOCK_MONOTONIC
+  uint64_t frame;        // FRAME: count of the frames published
+} frame_export_msg_t;
+
+class FrameExporter {
+public:
+  FrameExporter();
+  ~FrameExporter() { close(); }
+  FrameExporter(const FrameExporter &) = delete;
+  FrameExporter &operator=(const FrameExporter &) = delete;
+
+  bool open(const std::string &path);
+  bool is_open() const { return listen_fd >= 0; }
+  void close();
+  /* The buffers with the format of fmt, sent to every client. What the
+   * clients held of the buffers before stays retired_held until they release
+   * it or are dropped; wait_retired first if that may still be the case.
+   */
+  void set_buffers(const int *fds, int num, const frame_export_msg_t &fmt);
+  bool retired_held() const;
+  // Polls until no buffer of the generation before is held, bounded by the
+  // hold timeout
+  void wait_retired();
+  // Accepts clients and takes their releases, never waits
+  void poll();
+  // Buffer index holds a capture, sent to every client if none is held
+  void publish(int index, uint32_t sequence, uint64_t capture_us);
+  bool is_held(int index) const { return held_by[index] != 0; }
+  void report(const char *name) const;
+
+private:
+  void accept_clients();
+  void receive(int c);
+  void drop(int c);
+  bool send_buffers(int c);
+  int listen_fd;
+  std::string socket_path;
+  int client_fd[FRAME_EXPORT_MAX_CLIENTS];
+  // clients that hold each buffer as a bit mask, and since when
+  uint32_t held_by[FRAME_EXPORT_MAX_BUFFERS];
+  double held_since[FRAME_EXPORT_MAX_BUFFERS];
+  // the same for the buffers of the generation before
+  uint32_t retired_by[FRAME_EXPORT_MAX_BUFFERS];
+  double retired_since[FRAME_EXPORT_MAX_BUFFERS];
+  int fds[FRAME_EXPORT_MAX_BUFFERS];
+  frame_export_msg_t format;
+  uint64_t frames, sent, skipped, clients_total, clients_dropped;
+};
+
+class FrameImporter {
+public:
+  FrameImporter();
+  ~FrameImporter() { close(); }
+  FrameImporter(const FrameImporter &) = delete;
+  FrameImporter &operator=(const FrameImporter &) = delete;
+
+  bool connect(const std::string &path);
+  void close();
+  /* Waits up to timeout_ms (-1 for ever) for the next frame and returns its
+   * pixels, readable until release(frame), also when the exporter replaced
+   * the buffers in between. NULL on a timeout and once the exporter is gone,
+   * see is_connected().
+   */
+  const uint8_t *next(frame_export_msg_t &frame, int timeout_ms);
+  void release(const frame_export_msg_t &frame);
+  bool is_connected() const { return sock >= 0; }
+  // the format of the current buffers, valid after the first frame
+  const frame_export_msg_t &get_format() const { return format; }
+  // the dmabuf of a buffer, to pass on to another device
+  int buffer_fd(int index) const { return fds[index]; }
+
+private:
+  bool map_buffers(const frame_export_msg_t &msg, const int *new_fds);
+  void unmap_buffers();
+  int sock;
+  frame_export_msg_t format;
+  int fds[FRAME_EXPORT_MAX_BUFFERS];
+  uint8_t *maps[FRAME_EXPORT_MAX_BUFFERS];
+  // the generation before, mapped for the frames not released yet
+  frame_export_msg_t old_format;
+  int old_fds[FRAME_EXPORT_MAX_BUFFERS];
+  uint8_t *old_maps[FRAME_EXPORT_MAX_BUFFERS];
+};
+
+#endif // FRAME_EXPORT_H
@@ -0,0 +1,78 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include "frame_id.h"
+
+// least difference between the white and the black reference cells
+#define MIN_CONTRAST 32
+
+void frame_id_layout(int w, int h, int *x, int *y, int *cell)
+{
+  int c = w / ((FRAME_ID_CELLS + 2) * 2);
+  if (c > h / 24)
+    c = h / 24;
+  if (c < 2)
+    c = 2;
+  *cell = c;
+  *x = c;
+  *y = h - 2 * c;
+}
+
+static int parity(uint16_t id)
+{
+  int p = 0;
+  for (; id; id &= id - 1)
+    p ^= 1;
+  return p;
+}
+
+void frame_id_encode(uint16_t id, uint8_t cells[FRAME_ID_CELLS])
+{
+  cells[0] = 1;
+  cells[1] = 0;
+  for (int b = 0; b < FRAME_ID_BITS; b++)
+    cells[2 + b] = (id >> (FRAME_ID_BITS - 1 - b)) & 1;
+  cells[FRAME_ID_CELLS - 2] = parity(id);
+  cells[FRAME_ID_CELLS - 1] = !parity(id);
+}
+
+bool frame_id_decode(const float level[FRAME_ID_CELLS], uint16_t *id)
+{
+  if (level[0] - level[1] < MIN_CONTRAST)
+    return false;
+  float threshold = (level[0] + level[1]) / 2;
+  uint16_t v = 0;
+  for (int b = 0; b < FRAME_ID_BITS; b++)
+    v = (v << 1) | (level[2 + b] > threshold);
+  int p = level[FRAME_ID_CELLS - 2] > threshold;
+  int not_p = level[FRAME_ID_CELLS - 1] > threshold;
+  if (p == not_p || p != parity(v))
+    return false;
+  *id = v;
+  return true;
+}
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef FRAME_ID_H
+#define FRAME_ID_H
+
+#include <stdint.h>
+
+/* Frame ID code for glass-to-glass latency: a row of square cells that are
+ * white for 1 and black for 0, drawn into the overlay with --frame-id and
+ * read back by bench/frameid_decode from a capture of the screen. The row
+ * starts with a white and a black cell as the reference levels, then the 16
+ * bits of the ID, most significant first, then the even parity of the ID
+ * and its complement.
+ */
+#define FRAME_ID_BITS  16
+#define FRAME_ID_CELLS (FRAME_ID_BITS + 4)
+
+/* Where the code goes in a w x h overlay: the top left corner of the first
+ * cell and the size of a cell. It sits in the bottom left corner, on a black
+ * border of one cell.
+ */
+void frame_id_layout(int w, int h, int *x, int *y, int *cell);
+
+// 1 for the white cells of id, 0 for the black ones
+void frame_id_encode(uint16_t id, uint8_t cells[FRAME_ID_CELLS]);
+
+/* The ID from the brightness of every cell, false if the reference cells
+ * are not apart or the parity does not match
+ */
+bool frame_id_decode(const float level[FRAME_ID_CELLS], uint16_t *id);
+
+#endif // FRAME_ID_H
@@ -35,12 +35,13 @@
 #include <algorithm>
 #include <time.h>
 #include <unistd.h>
+#include <errno.h>
 
-#include <queue>
 #include <vector>
 #include <cstdio>
 #include <string>
 #include <chrono>
+#include <future>
 
 #include "capturevpedisplay.h"
 #include "executor.h"
@@ -52,6 +53,20 @@
 #include "../common/video_utils.h"
 #include "save_utils.h"
 #include "reader.h"
+#include "app_opts.h"
+#include "topk.h"
+#include "temporal_vote.h"
+#include "cascade.h"
+#include "crop_kernels.h"
+#include "tiling.h"
+#include "attention.h"
+#include "perf_stats.h"
+#include "cmem_slab.h"
+#include "async_log.h"
+#include "trace.h"
+#include "overlay_kernels.h"
+#include "metrics.h"
+#include "results_ring.h"
 
 using namespace std;
 using namespace tidl;
@@ -71,6 +86,14 @@ using namespace chrono;
 #define SEG_DEFAULT_INPUT_FRAMES  (9)
 #define SEG_DEFAULT_OBJECT_CLASSES_LIST_FILE "./configs/jseg21_objects.json"
 
+// most boxes that are drawn for one SSD frame
+#define MAX_SSD_BOXES 64
+// records of the --results-shm ring, about two seconds of frames
+#define RESULTS_RECORDS 64
+
+// for the time to first frame
+static chrono::steady_clock::time_point process_start;
+
 
 
 
@@ -79,6 +102,30 @@ using namespace chrono;
 //#define DEBUG_FILES
 
 std::unique_ptr<ObjectClasses> object_classes;
+// classification stage of the SSD cascade, if one was asked for
+std::unique_ptr<ClassCascade> cascade;
+// detections of the tiles of one capture, with --tiles
+static TileMerger tile_merger;
+// zoom window of the SSD input, with --attention
+static AttentionCrop attention;
+static TileMerger attention_merger;
+/* CPU time of the split of the VPE output into the TIDL input and of the
+ * overlay drawing, with cached (default) or --uncached CMEM
+ */
+static LatencyStats preprocess_time;
+static LatencyStats overlay_time;
+/* Capture to display latency: from the V4L2 timestamp of a capture to the
+ * page flip that shows the results of its network, and to the one that shows
+ * the capture itself on the video plane
+ */
+static LatencyStats capture_to_display;
+static LatencyStats capture_to_video;
+// from ProcessFrameStartAsync until ProcessFrameWait returned
+static LatencyStats eop_time;
+// boxes drawn by the SSD overlays
+static uint64_t num_detections;
+// results of the main network for other processes, with --results-shm
+static ResultsWriter results;
 uint32_t orig_width;
 uint32_t orig_height;
 uint32_t num_frames_file;
@@ -89,16 +136,56 @@ extern string labels_classes[];
 extern Rect rect_crop[];
 
 static int tf_postprocess(uchar *in, int out_size, int size, int roi_idx,
-                          int frame_idx, int f_id);
-static int ShowRegion(int roi_history[]);
+                          int frame_idx, int f_id, int *ids, float *probs);
 bool tf_expected_id(int id);
-// from most recent to oldest at top indices
-static int selclass_history[MAX_NUM_ROI][3];
+// decayed per-class scores of the last few observations of every ROI
+static TemporalVote class_vote;
+int TOP_CANDIDATES = 3;
+// per-frame probability a candidate needs before it is passed to the vote
+float CLASS_MIN_PROB = 0;
+
+/* A network that runs next to the one selected with -t, fed from the same
+ * capture. It has its own configuration, executors, cores and overlay plane,
+ * and is handed every rate-th capture.
+ */
+struct ExtraNet {
+  string net_type;
+  string config;
+  string objects_file;
+  uint32_t num_eves = 0;
+  uint32_t num_dsps = 0;
+  uint32_t first_eve = 0;
+  uint32_t first_dsp = 0;
+  uint32_t rate = 1;
+  int overlay = -1;
+  Configuration c;
+  Executor *e_eve = nullptr;
+  Executor *e_dsp = nullptr;
+  vector<ExecutionObjectPipeline *> eops;
+  uint32_t next_eop = 0;
+  std::unique_ptr<ObjectClasses> object_classes;
+  high_resolution_clock::time_point last_write;
+  float fps = 0;
+};
 
 bool RunConfiguration(const cmdline_opts_t& opts);
+static bool ParseNetSpec(const string& spec, ExtraNet& n);
+static bool SetupExtraNets(const cmdline_opts_t& opts, CamDisp& cam,
+                           vector<std::unique_ptr<ExtraNet>>& nets);
+static void RunExtraNet(ExtraNet& n, uint32_t frame_idx, const void *image,
+                        int img_w, int img_h, const cmdline_opts_t& opts,
+                        CamDisp& cam);
+Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c,
+                         int layers_group_id, uint32_t first_id = 0);
 Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c,
-                         int layers_group_id);
-Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c);
+                         uint32_t first_id = 0);
+bool CreatePipelines(const string& net_type, const Configuration& c,
+                     uint32_t num_eves, uint32_t num_dsps,
+                     uint32_t first_eve, uint32_t first_dsp,
+                     Executor*& e_eve, Executor*& e_dsp,
+                     vector<ExecutionObjectPipeline *>& eops);
+static void WarmUp(vector<ExecutionObjectPipeline *>& eops, int num, const string& name);
+static void SignalReady(const string& path);
 bool ReadFrameInput(ExecutionObjectPipeline& eop, uint32_t frame_idx,
                const Configuration& c, const cmdline_opts_t& opts,
                CamDisp &cap);
@@ -107,24 +194,45 @@ bool ReadFrameIO(ExecutionObjectPipeline& eop, uint32_t frame_idx,
               CamDisp &cap);
 bool WriteFrameOutputSSD(const ExecutionObjectPipeline& eop,
                       const Configuration& c, const cmdline_opts_t& opts,
-                      CamDisp& cam, float fps);
+                      CamDisp& cam, float fps, ObjectClasses& classes,
+                      ClassCascade *casc, int overlay = 0);
+int WriteFrameOutputSSDMapped(const ExecutionObjectPipeline& eop,
+                      const Configuration& c, const cmdline_opts_t& opts,
+                      CamDisp& cam, float fps, ObjectClasses& classes,
+                      TileMerger& merger, const v4l2_rect& src, bool last);
+static bool SSDLabelWanted(const string& label, bool cascade_filter);
+static void DrawSSDBox(Mat& frame, const ObjectClass& object_class,
+                       const string& text, int xmin, int ymin, int xmax,
+                       int ymax);
 // Create frame overlayed with pixel-level segmentation
 bool WriteFrameOutputSEG(const ExecutionObjectPipeline &eop,
                       const Configuration& c,
-                      const cmdline_opts_t& opts, CamDisp& cam, float fps);
+                      const cmdline_opts_t& opts, CamDisp& cam, float fps,
+                      int overlay = 0);
 void WriteFrameOutputCLASS(const ExecutionObjectPipeline* eop, CamDisp &cap,
                   const Configuration& c, uint32_t frame_idx, float fps, uint32_t num_eops,
                   uint32_t num_eves, uint32_t num_dsps);
-void OverlayFPS(Mat fps_screen, const Configuration& c, float fps, double scale);
-
 static void DisplayHelp();
+static void ReleaseCmem() { cmem_slab.release(); }
+
+// Set by SIGINT and SIGTERM: no more captures, the frames in flight finish
+static volatile sig_atomic_t stop_requested = 0;
+static void RequestStop(int)
+{
+    stop_requested = 1;
+}
+static void PublishMetrics(CamDisp& cam, double uptime_s, uint64_t frames,
+                           float fps, int num_eops, double eop_utilization);
 
 
 int main(int argc, char *argv[])
 {
-    // Catch ctrl-c to ensure a clean exit
-    signal(SIGABRT, exit);
-    signal(SIGTERM, exit);
+    process_start = chrono::steady_clock::now();
+    /* Catch ctrl-c to ensure a clean exit: the frame loop drains the EOPs
+     * and returns, the capture stops and the CMEM is released after that
+     */
+    signal(SIGINT, RequestStop);
+    signal(SIGTERM, RequestStop);
 
     // If there are no devices capable of offloading TIDL on the SoC, exit
     uint32_t num_eves = Executor::GetNumDevices(DeviceType::EVE);
@@ -137,11 +245,31 @@ int main(int argc, char *argv[])
 
     // Process arguments
     cmdline_opts_t opts;
-    if (! ProcessArgs(argc, argv, opts))
+    if (! ProcessAppArgs(argc, argv) || ! ProcessArgs(argc, argv, opts))
     {
         DisplayHelp();
         exit(EXIT_SUCCESS);
     }
+    // messages of the frame loop are written out by a background thread
+    async_log_start(app_opts.log_level);
+    atexit(async_log_stop);
+    if (app_opts.trace_file != "") {
+      if (!trace_start(app_opts.trace_file))
+        return EXIT_FAILURE;
+      atexit(trace_stop);
+    }
+    if (app_opts.metrics_socket != "") {
+      if (!metrics_start(app_opts.metrics_socket))
+        return EXIT_FAILURE;
+      atexit(metrics_stop);
+    }
+    set_cmem_cached(!app_opts.uncached);
+    // The display buffers come out of one CMEM region that is reserved now
+    // and given back on any exit
+    if (app_opts.cmem_slab > 0 &&
+        !cmem_slab.init((size_t) app_opts.cmem_slab << 20))
+        MSG("Allocating every display buffer from CMEM on its own");
+    atexit(ReleaseCmem);
 
     MSG("net_type %s\nconfig %s\nobject_classes_list_file %s\nnum_eves %d\n" \
         "num_dsps %d\noutput_prob_threshold %d", opts.net_type.c_str(), opts.config.c_str(),
@@ -186,10 +314,28 @@ int main(int argc, char *argv[])
           cout << "No object classes defined for this config." << endl;
           return EXIT_FAILURE;
       }
+      if (opts.net_type == "ssd" && app_opts.cascade_config != "") {
+        if (app_opts.cascade_labels == "") {
+          cout << "--cascade-labels is needed with --cascade-config" << endl;
+          return EXIT_FAILURE;
+        }
+        populate_labels(app_opts.cascade_labels.c_str());
+        populate_selected_items(app_opts.cascade_labels.c_str());
+        cascade = std::unique_ptr<ClassCascade>(new ClassCascade());
+      }
     }
     else {
       populate_labels(opts.object_classes_list_file.c_str());
       populate_selected_items(opts.object_classes_list_file.c_str());
+      if (app_opts.softmax_scale > 0)
+        topk_softmax_init(app_opts.softmax_scale);
+      // the vote filters out single-frame noise, so the per-frame
+      // threshold is only applied if one is asked for
+      CLASS_MIN_PROB = opts.output_prob_threshold / 100.0f;
+      if (!class_vote.init(NUM_ROI, app_opts.vote_window, TOP_CANDIDATES,
+                           IMAGE_CLASSES_NUM, app_opts.vote_decay,
+                           app_opts.vote_threshold))
+        return EXIT_FAILURE;
     }
 
     // Run network
@@ -204,19 +350,28 @@ int main(int argc, char *argv[])
     return EXIT_SUCCESS;
 }
 
+// Path of the TIDL configuration file of a network
+static string ConfigFile(const string& net_type, const string& config)
+{
+    // TODO : clean up
+    if (net_type == "class")
+      return config;
+    return "../test/testvecs/config/infer/tidl_config_" + config + ".txt";
+}
+
+// Set by SIGUSR1: switch to the other network of --switch-config
+static volatile sig_atomic_t switch_requested = 0;
+static void RequestSwitch(int)
+{
+    switch_requested = 1;
+}
+
 bool RunConfiguration(const cmdline_opts_t& opts)
 {
     // int prob_slider     = opts.output_prob_threshold;
     // Read the TI DL configuration file
     Configuration c;
-    std::string config_file;
-    // TODO : clean up
-    if (opts.net_type == "class")
-      config_file = opts.config;
-    else {
-      config_file = "../test/testvecs/config/infer/tidl_config_"
-                                + opts.config + ".txt";
-    }
+    std::string config_file = ConfigFile(opts.net_type, opts.config);
 
     bool status = c.ReadFromFile(config_file);
     if (!status)
@@ -225,13 +380,49 @@ bool RunConfiguration(const cmdline_opts_t& opts)
         return false;
     }
     c.enableApiTrace = opts.verbose;
-    if (opts.num_eves == 0 || opts.num_dsps == 0)
+    // With the cascade the DSPs are left to the classification network and
+    // the full detection network runs on the EVEs
+    uint32_t num_dsps = cascade ? 0 : opts.num_dsps;
+    if (opts.num_eves == 0 || num_dsps == 0)
         c.runFullNet = true;
+    if (cascade && opts.num_eves == 0) {
+        ERROR("the SSD cascade needs at least one EVE for detection");
+        return false;
+    }
+
+    // the network that the pipeline switches to with --switch-config
+    Configuration c_alt;
+    std::unique_ptr<ObjectClasses> alt_classes;
+    bool switch_nets = app_opts.switch_config != "";
+    if (switch_nets) {
+      string alt_file = ConfigFile(opts.net_type, app_opts.switch_config);
+      if (!c_alt.ReadFromFile(alt_file)) {
+        cerr << "Error in configuration file: " << alt_file << endl;
+        return false;
+      }
+      c_alt.enableApiTrace = opts.verbose;
+      if (opts.num_eves == 0 || num_dsps == 0)
+        c_alt.runFullNet = true;
+      if (opts.net_type != "class") {
+        alt_classes = std::unique_ptr<ObjectClasses>(new ObjectClasses(
+          app_opts.switch_objects != "" ? app_opts.switch_objects :
+                                          opts.object_classes_list_file));
+        if (alt_classes->GetNumClasses() == 0) {
+          ERROR("No object classes defined for %s",
+                app_opts.switch_config.c_str());
+          return false;
+        }
+      }
+      if (app_opts.attention) {
+        ERROR("--switch-config can not be combined with --attention");
+        return false;
+      }
+      signal(SIGUSR1, RequestSwitch);
+    }
 
     /* alpha_value of the second plane. 0 makes it clear and 255 makes it opaque
      * cam_w, cam_h should be just over the model
      */
-    CamDisp cam;
     int cap_w, cap_h, alpha_value;
 
     // optsarg is const, quick_display should be set to false if it was
@@ -255,156 +446,171 @@ bool RunConfiguration(const cmdline_opts_t& opts)
       quick_display = false;
     }
 
+    if (app_opts.capture != "" &&
+        sscanf(app_opts.capture.c_str(), "%dx%d", &cap_w, &cap_h) != 2) {
+      ERROR("--capture expects <width>x<height>, got %s",
+            app_opts.capture.c_str());
+      return false;
+    }
+
     // The quick display setting looks better with a darker second layer
     if (quick_display) alpha_value = 215;
     bool usb_capture = true;
 
-    if ((opts.input_file != "") && opts.input_file.length() == 1) {
-      string device_name = "/dev/video" + opts.input_file;
-      cam = CamDisp(cap_w, cap_h, c.inWidth, c.inHeight, alpha_value,
-        device_name, usb_capture, opts.net_type, quick_display);
+    string device_name = "/dev/video1";
+    if ((opts.input_file != "") && opts.input_file.length() == 1)
+      device_name = "/dev/video" + opts.input_file;
+    CamDisp cam(cap_w, cap_h, c.inWidth, c.inHeight, alpha_value,
+      device_name, usb_capture, opts.net_type, quick_display);
+    if (app_opts.letterbox) {
+      // The VPE output buffers and crop_buf keep their bars, which needs one
+      // letterbox rectangle for the whole run
+      if ((opts.net_type == "class" && NUM_ROI > 1 && app_opts.roi_crop != "cpu") ||
+          (app_opts.tiles != "" && app_opts.tile_crop != "cpu") ||
+          app_opts.attention || !app_opts.nets.empty()) {
+        ERROR("--letterbox needs CPU crops and can not be combined with "
+              "--attention or --net");
+        return false;
+      }
+      cam.set_letterbox(true);
     }
-    else {
-      cam = CamDisp(cap_w, cap_h, c.inWidth, c.inHeight, alpha_value,
-        "/dev/video1", usb_capture, opts.net_type, quick_display);
+    if (opts.net_type == "class" && NUM_ROI > 1) {
+      // Every capture is split into the regions of the ROI grid. They are
+      // read one after the other into consecutive EOPs, so that frame f_id
+      // holds region f_id % NUM_ROI. The display keeps the full frame, under
+      // the ROI rectangles of the overlay.
+      v4l2_rect rects[NUM_ROI];
+      setup_rect_crop();
+      for (int r = 0; r < NUM_ROI; r++) {
+        rects[r].left = rect_crop[r].x * cap_w / RES_X;
+        rects[r].top = rect_crop[r].y * cap_h / RES_Y;
+        rects[r].width = rect_crop[r].width * cap_w / RES_X;
+        rects[r].height = rect_crop[r].height * cap_h / RES_Y;
+      }
+      if (!cam.set_crops(rects, NUM_ROI, app_opts.roi_crop == "cpu", true))
+        return false;
     }
-    cam.init_capture_pipeline();
+    if (opts.net_type == "ssd" && app_opts.tiles != "") {
+      // Tiled detection: every capture is split into overlapping tiles that
+      // are read one after the other into consecutive EOPs, so that frame
+      // f_id holds tile f_id % num_tiles. The display keeps the full frame.
+      int cols, rows;
+      v4l2_rect rects[MAX_CROPS];
+      if (sscanf(app_opts.tiles.c_str(), "%dx%d", &cols, &rows) != 2 ||
+          cols * rows <= 0 || cols * rows > MAX_CROPS) {
+        ERROR("--tiles expects <cols>x<rows> with at most %d tiles, got %s",
+              MAX_CROPS, app_opts.tiles.c_str());
+        return false;
+      }
+      if (cascade) {
+        ERROR("--tiles can not be combined with the cascade");
+        return false;
+      }
+      if (!tile_layout(cap_w, cap_h, cols, rows, app_opts.tile_overlap, rects) ||
+          !cam.set_crops(rects, cols * rows, app_opts.tile_crop == "cpu", true))
+        return false;
+      cam.hold_overlay(0);
+      tile_merger.init(rects, cols * rows, cap_w, cap_h, app_opts.tile_nms);
+    }
+    if (opts.net_type == "ssd" && app_opts.attention) {
+      // The VPE crop follows the detections, it is changed for every frame
+      // while streaming. The display keeps the full frame.
+      if (cascade || tile_merger.num_tiles() > 0) {
+        ERROR("--attention can not be combined with the cascade or tiles");
+        return false;
+      }
+      v4l2_rect full = {0, 0, (uint32_t) cap_w, (uint32_t) cap_h};
+      if (!attention.init(cap_w, cap_h, c.inWidth, c.inHeight,
+                          app_opts.attention_pad, app_opts.attention_full,
+                          app_opts.attention_hold, app_opts.attention_zoom,
+                          app_opts.attention_smooth))
+        return false;
+      attention_merger.init(&full, 1, cap_w, cap_h, app_opts.tile_nms);
+      cam.hold_overlay(0);
+    }
+    vector<std::unique_ptr<ExtraNet>> extra_nets;
+    if (!SetupExtraNets(opts, cam, extra_nets))
+      return false;
+    if (app_opts.export_frames_socket != "" &&
+        !cam.export_frames(app_opts.export_frames_socket))
+      return false;
 
     try
     {
         // Create Executors with the approriate core type, number of cores
         // and configuration specified
-        // EVE will run layersGroupId 1 in the network, while
-        // DSP will run layersGroupId 2 in the network
         Executor *e_dsp, *e_eve;
-        MSG("Beginning to create executors for net_type %s", opts.net_type.c_str());
-        if (opts.net_type == "ssd" || opts.net_type == "class") {
-          e_dsp = CreateExecutor(DeviceType::DSP, opts.num_dsps, c, 2);
-          e_eve = CreateExecutor(DeviceType::EVE, opts.num_eves, c, 1);
-        }
-        else {
-          e_eve = CreateExecutor(DeviceType::EVE, opts.num_eves, c);
-          e_dsp = CreateExecutor(DeviceType::DSP, opts.num_dsps, c);
-        }
         vector<ExecutionObjectPipeline *> eops;
-        if (e_eve != nullptr && e_dsp != nullptr && (opts.net_type != "seg"))
-        {
-            // Construct ExecutionObjectPipeline that utilizes multiple
-            // ExecutionObjects to process a single frame, each ExecutionObject
-            // processes one layerGroup of the network
-            //
-            // Pipeline depth can enable more optimized pipeline execution:
-            // Given one EVE and one DSP as an example, with different
-            //     pipeline_depth, we have different execution behavior:
-            // If pipeline_depth is set to 1,
-            //    we create one EOP: eop0 (eve0, dsp0)
-            //    pipeline execution of multiple frames over time is as follows:
-            //    --------------------- time ------------------->
-            //    eop0: [eve0...][dsp0]
-            //    eop0:                [eve0...][dsp0]
-            //    eop0:                               [eve0...][dsp0]
-            //    eop0:                                              [eve0...][dsp0]
-            // If pipeline_depth is set to 2,
-            //    we create two EOPs: eop0 (eve0, dsp0), eop1(eve0, dsp0)
-            //    pipeline execution of multiple frames over time is as follows:
-            //    --------------------- time ------------------->
-            //    eop0: [eve0...][dsp0]
-            //    eop1:          [eve0...][dsp0]
-            //    eop0:                   [eve0...][dsp0]
-            //    eop1:                            [eve0...][dsp0]
-            // Additional benefit of setting pipeline_depth to 2 is that
-            //    it can also overlap host ReadFrameInput() with device processing:
-            //    --------------------- time ------------------->
-            //    eop0: [RF][eve0...][dsp0]
-            //    eop1:     [RF]     [eve0...][dsp0]
-            //    eop0:                    [RF][eve0...][dsp0]
-            //    eop1:                             [RF][eve0...][dsp0]
-            uint32_t pipeline_depth = 2;  // 2 EOs in EOP -> depth 2
-            for (uint32_t j = 0; j < pipeline_depth; j++)
-                for (uint32_t i = 0; i < max(opts.num_eves, opts.num_dsps); i++)
-                    eops.push_back(new ExecutionObjectPipeline(
-                      {(*e_eve)[i%opts.num_eves], (*e_dsp)[i%opts.num_dsps]}));
-        }
-        else if (opts.net_type == "ssd")
-        {
-            // Construct ExecutionObjectPipeline that utilizes a
-            // ExecutionObject to process a single frame, each ExecutionObject
-            // processes the full network
-            //
-            // Use duplicate EOPs to do double buffering on frame input/output
-            //    because each EOP has its own set of input/output buffers,
-            //    so that host ReadFrameInput() can overlap device processing
-            // Use one EO as an example, with different buffer_factor,
-            //    we have different execution behavior:
-            // If buffer_factor is set to 1 -> single buffering
-            //    we create one EOP: eop0 (eo0)
-            //    pipeline execution of multiple frames over time is as follows:
-            //    --------------------- time ------------------->
-            //    eop0: [RF][eo0.....][WF]
-            //    eop0:                   [RF][eo0.....][WF]
-            //    eop0:                                     [RF][eo0.....][WF]
-            // If buffer_factor is set to 2 -> double buffering
-            //    we create two EOPs: eop0 (eo0), eop1(eo0)
-            //    pipeline execution of multiple frames over time is as follows:
-            //    --------------------- time ------------------->
-            //    eop0: [RF][eo0.....][WF]
-            //    eop1:     [RF]      [eo0.....][WF]
-            //    eop0:                   [RF]  [eo0.....][WF]
-            //    eop1:                             [RF]  [eo0.....][WF]
-            uint32_t buffer_factor = 2;  // set to 1 for single buffering
-            for (uint32_t j = 0; j < buffer_factor; j++)
-            {
-                for (uint32_t i = 0; i < opts.num_eves; i++)
-                    eops.push_back(new ExecutionObjectPipeline({(*e_eve)[i]}));
-                for (uint32_t i = 0; i < opts.num_dsps; i++)
-                    eops.push_back(new ExecutionObjectPipeline({(*e_dsp)[i]}));
-            }
-        }
-        else if (opts.net_type == "seg") {
-          // Get ExecutionObjects from Executors
-          vector<ExecutionObject*> eos;
-          for (uint32_t i = 0; i < opts.num_eves; i++) eos.push_back((*e_eve)[i]);
-          for (uint32_t i = 0; i < opts.num_dsps; i++) eos.push_back((*e_dsp)[i]);
-          MSG("eos created of size %d", eos.size());
-          uint32_t num_eos = eos.size();
-
-          // Use duplicate EOPs to do double buffering on frame input/output
-          //    because each EOP has its own set of input/output buffers,
-          //    so that host ReadFrameInput() can be overlapped with device processing
-          // Use one EO as an example, with different buffer_factor,
-          //    we have different execution behavior:
-          // If buffer_factor is set to 1 -> single buffering
-          //    we create one EOP: eop0 (eo0)
-          //    pipeline execution of multiple frames over time is as follows:
-          //    --------------------- time ------------------->
-          //    eop0: [RF][eo0.....][WF]
-          //    eop0:                   [RF][eo0.....][WF]
-          //    eop0:                                     [RF][eo0.....][WF]
-          // If buffer_factor is set to 2 -> double buffering
-          //    we create two EOPs: eop0 (eo0), eop1(eo0)
-          //    pipeline execution of multiple frames over time is as follows:
-          //    --------------------- time ------------------->
-          //    eop0: [RF][eo0.....][WF]
-          //    eop1:     [RF]      [eo0.....][WF]
-          //    eop0:                   [RF]  [eo0.....][WF]
-          //    eop1:                             [RF]  [eo0.....][WF]
-          uint32_t buffer_factor = 2;  // set to 1 for single buffering
-          for (uint32_t j = 0; j < buffer_factor; j++)
-              for (uint32_t i = 0; i < num_eos; i++)
-                  eops.push_back(new ExecutionObjectPipeline({eos[i]}));
-          MSG("eops of size %d created", eops.size());
-        }
-        else {
-          ERROR("NETWORK NOT INITIALIZED");
-          sleep(2);
+        /* The networks are loaded onto the EVEs and DSPs while the capture
+         * and the display are set up, the two only meet in the frame loop
+         */
+        auto init_start = chrono::steady_clock::now();
+        double load_ms = 0;
+        future<bool> loaded = async(launch::async, [&]() {
+          MSG("Beginning to create executors for net_type %s", opts.net_type.c_str());
+          if (!CreatePipelines(opts.net_type, c, opts.num_eves, num_dsps, 0, 0,
+                               e_eve, e_dsp, eops))
+            return false;
+          for (auto &n : extra_nets) {
+            MSG("Creating executors for the additional %s network %s",
+                n->net_type.c_str(), n->config.c_str());
+            if (!CreatePipelines(n->net_type, n->c, n->num_eves, n->num_dsps,
+                                 n->first_eve, n->first_dsp, n->e_eve,
+                                 n->e_dsp, n->eops))
+              return false;
+            AllocateMemory(n->eops);
+          }
+          // Allocate input/output memory for each EOP
+          AllocateMemory(eops);
+          if (cascade && !cascade->init(app_opts.cascade_config, opts.num_dsps,
+                                        IMAGE_CLASSES_NUM,
+                                        app_opts.cascade_min_prob,
+                                        opts.verbose))
+            return false;
+          load_ms = chrono::duration<double, milli>(
+            chrono::steady_clock::now() - init_start).count();
+          WarmUp(eops, app_opts.warmup, opts.config);
+          for (auto &n : extra_nets)
+            WarmUp(n->eops, app_opts.warmup, n->config);
+          return true;
+        });
+        bool capture_ready = cam.init_capture_pipeline();
+        double capture_ms = chrono::duration<double, milli>(
+          chrono::steady_clock::now() - init_start).count();
+        // get() waits for the networks and rethrows a tidl::Exception
+        if (!loaded.get() || !capture_ready)
           return false;
-        }
-        uint32_t num_eops = eops.size();
+        if (app_opts.record_file != "" && !cam.record(app_opts.record_file))
+          return false;
+        if (app_opts.display_dump_file != "" &&
+            !cam.dump_display(app_opts.display_dump_file))
+          return false;
+        if (app_opts.frame_id && opts.net_type == "seg" && quick_display)
+          MSG("WARNING: --frame-id needs the segmentation overlay, not drawn " \
+              "with quick display");
+        cam.set_frame_id(app_opts.frame_id &&
+                         !(opts.net_type == "seg" && quick_display));
+        if (app_opts.results_shm != "" &&
+            !results.open(app_opts.results_shm, RESULTS_RECORDS,
+                          opts.net_type == "seg" ? c.inWidth * c.inHeight : 0))
+          return false;
+        MSG("Network loading took %.0f ms, capture and display setup %.0f ms, " \
+            "in parallel", load_ms, capture_ms);
+        SignalReady(app_opts.ready_file);
 
-        // Allocate input/output memory for each EOP
-        AllocateMemory(eops);
+        uint32_t num_eops = eops.size();
+        if (cam.get_num_crops() > (int) num_eops)
+          MSG("WARNING: %d regions per capture but only %d EOPs, the regions " \
+              "of one capture will not all be processed in parallel",
+              cam.get_num_crops(), num_eops);
+
+        vector<chrono::steady_clock::time_point> eop_start(num_eops);
+        // V4L2 timestamp and sequence of the capture that went into each EOP
+        vector<uint64_t> eop_capture_us(num_eops);
+        vector<uint32_t> eop_capture_seq(num_eops);
         chrono::time_point<chrono::steady_clock> tloop0, tloop1;
         tloop0 = chrono::steady_clock::now();
+        trace_thread_name("frame loop");
 
         // Process frames with available eops in a pipelined manner
         // additional num_eops iterations to flush pipeline (epilogue)
@@ -413,12 +619,82 @@ bool RunConfiguration(const cmdline_opts_t& opts)
         int ave = 20;
         float fps_bank[ave];
         float fps = 0;
+        // time from the start of a network switch to its first frame
+        LatencyStats switch_gap;
+        chrono::steady_clock::time_point switch_start;
+        bool switch_pending = false;
+        string net_name = opts.config, alt_name = app_opts.switch_config;
+        bool first_frame_shown = false;
+        // for the metrics socket, published about once a second
+        uint64_t frames_shown = 0;
+        double eop_busy_ms = 0;
+        chrono::steady_clock::time_point last_publish = tloop0;
+        // frames to read, cut short by a stop request
+        uint32_t num_frames = opts.num_frames;
         for (uint32_t frame_idx = 0;
-             frame_idx < (int) opts.num_frames + num_eops; frame_idx++)
+             frame_idx < (int) num_frames + num_eops; frame_idx++)
         {
+            if (stop_requested && frame_idx < num_frames) {
+              MSG("Stopping after %u frames", frame_idx);
+              num_frames = frame_idx;
+            }
+            if (switch_nets && frame_idx < num_frames &&
+                (switch_requested || (app_opts.switch_every > 0 &&
+                 frame_idx > 0 && frame_idx % app_opts.switch_every == 0))) {
+              /* Drain the EOPs, dropping the frames in flight, and replace
+               * the executors. The capture keeps streaming, only the VPE
+               * output and the display planes follow the new input size.
+               */
+              switch_requested = 0;
+              switch_start = chrono::steady_clock::now();
+              for (auto e : eops)  e->ProcessFrameWait();
+              FreeMemory(eops);
+              for (auto e : eops) {
+                trace_remove_pipeline(e);
+                delete e;
+              }
+              delete e_eve;
+              delete e_dsp;
+              eops.clear();
+
+              std::swap(c, c_alt);
+              std::swap(net_name, alt_name);
+              std::swap(object_classes, alt_classes);
+              if (!cam.set_output_size(c.inWidth, c.inHeight)) {
+                ERROR("Could not switch the capture output to %dx%d",
+                      c.inWidth, c.inHeight);
+                return false;
+              }
+              if (!CreatePipelines(opts.net_type, c, opts.num_eves, num_dsps,
+                                   0, 0, e_eve, e_dsp, eops))
+                return false;
+              AllocateMemory(eops);
+              // the first frames of the new network are not paid live
+              WarmUp(eops, app_opts.warmup, net_name);
+              num_eops = eops.size();
+              eop_start.resize(num_eops);
+              eop_capture_us.assign(num_eops, 0);
+              eop_capture_seq.assign(num_eops, 0);
+              switch_pending = true;
+              MSG("Switched to the %dx%d network at frame %u after %.1f ms",
+                  c.inWidth, c.inHeight, frame_idx,
+                  chrono::duration<double, milli>(chrono::steady_clock::now()
+                                                  - switch_start).count());
+            }
             ExecutionObjectPipeline* eop = eops[frame_idx % num_eops];
             // Wait for previous frame on the same eop to finish processing
             if (eop->ProcessFrameWait()) {
+              trace_eop_done(eop);
+              double eop_ms = chrono::duration<double, milli>(
+                chrono::steady_clock::now() -
+                eop_start[frame_idx % num_eops]).count();
+              eop_time.add(eop_ms);
+              eop_busy_ms += eop_ms;
+              if (cascade)
+                cascade->add_detection(eop_ms);
+              if (tile_merger.num_tiles() > 0)
+                tile_merger.add_tile_time(eop->GetFrameIndex() %
+                                          tile_merger.num_tiles(), eop_ms);
               auto fpsCount = duration_cast<milliseconds>(high_resolution_clock::now() - wrStart);
               fps_bank[(frame_idx-num_eops)%ave] = (1000.00/(float)fpsCount.count());
 
@@ -430,47 +706,171 @@ bool RunConfiguration(const cmdline_opts_t& opts)
               }
 
               wrStart = high_resolution_clock::now();
-              if (opts.net_type == "ssd")
-                WriteFrameOutputSSD(*eop, c, opts, cam, fps);
+              uint64_t post_begin = trace_on ? trace_now() : 0;
+              async_log_frame(eop->GetFrameIndex());
+              // a tiled capture has its results with the last tile
+              if (results.is_open() && (opts.net_type != "ssd" ||
+                  tile_merger.num_tiles() == 0 ||
+                  eop->GetFrameIndex() % tile_merger.num_tiles() ==
+                  tile_merger.num_tiles() - 1))
+                results.begin(eop->GetFrameIndex(),
+                  eop_capture_seq[frame_idx % num_eops],
+                  eop_capture_us[frame_idx % num_eops],
+                  opts.net_type == "ssd" ? RESULTS_SSD :
+                  opts.net_type == "seg" ? RESULTS_SEG : RESULTS_CLASS);
+              if (opts.net_type == "ssd" && tile_merger.num_tiles() > 0) {
+                // every capture takes num_tiles frames
+                int tile = eop->GetFrameIndex() % tile_merger.num_tiles();
+                WriteFrameOutputSSDMapped(*eop, c, opts, cam,
+                  fps / tile_merger.num_tiles(), *object_classes, tile_merger,
+                  tile_merger.rect(tile), tile == tile_merger.num_tiles() - 1);
+              }
+              else if (opts.net_type == "ssd" && attention.enabled()) {
+                // the boxes steer the window of the frames that follow
+                int num = WriteFrameOutputSSDMapped(*eop, c, opts, cam, fps,
+                  *object_classes, attention_merger,
+                  attention.crop_of(eop->GetFrameIndex()), true);
+                attention.update(attention_merger.boxes(), num);
+              }
+              else if (opts.net_type == "ssd")
+                WriteFrameOutputSSD(*eop, c, opts, cam, fps, *object_classes,
+                                    cascade.get());
               else if ((opts.net_type == "seg") && (!quick_display)) {
                 WriteFrameOutputSEG(*eop, c, opts, cam, fps);
               }
               else if (opts.net_type == "class") {
                 WriteFrameOutputCLASS(eop, cam, c, frame_idx, fps, num_eops, opts.num_eves, opts.num_dsps);
               }
-
-              cam.disp_frame();
+              results.commit();
+
+              overlay_time.add(chrono::duration<double, milli>(
+                high_resolution_clock::now() - wrStart).count());
+              if (trace_on)
+                trace_span("postprocess", post_begin, trace_now(),
+                           eop->GetFrameIndex());
+              uint64_t capture_us = eop_capture_us[frame_idx % num_eops];
+              cam.set_overlay_capture(eop_capture_seq[frame_idx % num_eops],
+                                      capture_us);
+              {
+                TraceScope span("flip");
+                cam.disp_frame();
+              }
+              uint64_t flip_us = cam.flip_timestamp_us();
+              if (flip_us && capture_us && flip_us > capture_us)
+                capture_to_display.add((flip_us - capture_us) / 1000.0);
+              capture_us = cam.capture_timestamp_us();
+              if (flip_us && capture_us && flip_us > capture_us)
+                capture_to_video.add((flip_us - capture_us) / 1000.0);
+              if (!first_frame_shown) {
+                MSG("Time to first frame: %.0f ms",
+                    chrono::duration<double, milli>(
+                      chrono::steady_clock::now() - process_start).count());
+                first_frame_shown = true;
+              }
+              if (switch_pending) {
+                double gap = chrono::duration<double, milli>(
+                  chrono::steady_clock::now() - switch_start).count();
+                MSG("Network switch-over gap: %.1f ms", gap);
+                switch_gap.add(gap);
+                switch_pending = false;
+              }
+              frames_shown++;
+              auto now = chrono::steady_clock::now();
+              if (app_opts.metrics_socket != "" &&
+                  now - last_publish >= chrono::seconds(1)) {
+                double uptime_ms = chrono::duration<double, milli>(
+                  now - tloop0).count();
+                PublishMetrics(cam, uptime_ms / 1000, frames_shown, fps,
+                               num_eops,
+                               eop_busy_ms / (uptime_ms * num_eops));
+                last_publish = now;
+              }
 
               if (opts.verbose) {
                 auto wrStop = high_resolution_clock::now();
                 auto wrDuration = duration_cast<milliseconds>(wrStop - wrStart);
-                DBG("Overlay write time: %d ms", (int) wrDuration.count());
+                LOGD("Overlay write time: %d ms", (int) wrDuration.count());
               }
             }
             // Read a frame and start processing it with current eo
+            async_log_frame(frame_idx);
             auto rdStart = high_resolution_clock::now();
-           if (opts.net_type != "seg" || !quick_display) {
-              ReadFrameInput(*eop, frame_idx, c, opts, cam);
+            if (attention.enabled() && frame_idx < num_frames) {
+              cam.set_dynamic_crop(attention.next(frame_idx), true);
+              attention.set_crop(frame_idx, cam.get_crop());
+            }
+           bool read = false;
+           if (frame_idx >= num_frames) {
+              // stopped early, nothing more is captured
+           }
+           else if (opts.net_type != "seg" || !quick_display) {
+              read = ReadFrameInput(*eop, frame_idx, c, opts, cam);
            }
            else {
-              ReadFrameIO(*eop, frame_idx, c, opts, cam);
+              read = ReadFrameIO(*eop, frame_idx, c, opts, cam);
            }
           auto rdStop = high_resolution_clock::now();
           auto rdDuration = duration_cast<milliseconds>(rdStop - rdStart);
-          if (opts.verbose) cout << "One buffer read time:" <<
-            rdDuration.count() << " ms" << endl;
-          eop->ProcessFrameStartAsync();
+          if (opts.verbose)
+            LOGD("One buffer read time: %d ms", (int) rdDuration.count());
+          // past the last frame the EOPs are only drained
+          if (read) {
+            eop_start[frame_idx % num_eops] = chrono::steady_clock::now();
+            eop_capture_us[frame_idx % num_eops] = cam.capture_timestamp_us();
+            eop_capture_seq[frame_idx % num_eops] = cam.capture_sequence();
+            eop->ProcessFrameStartAsync();
+            trace_eop_start(eop);
+          }
+
+          // the additional networks that are due get the same capture
+          if (read) {
+            for (auto &n : extra_nets)
+              if (frame_idx % n->rate == 0)
+                RunExtraNet(*n, frame_idx, cam.get_image_ptr(), c.inWidth,
+                            c.inHeight, opts, cam);
+          }
         }
+        for (auto &n : extra_nets)
+          for (uint32_t i = 0; i < n->eops.size(); i++)
+            RunExtraNet(*n, 0, nullptr, 0, 0, opts, cam);
 
         tloop1 = chrono::steady_clock::now();
         chrono::duration<float> elapsed = tloop1 - tloop0;
         cout << "Loop total time (including read/write/opencv/print/etc): "
                   << setw(6) << setprecision(4)
                   << (elapsed.count() * 1000) << "ms" << endl;
+        if (cascade) {
+          cascade->report();
+          cascade.reset();
+        }
+        if (tile_merger.num_tiles() > 0)
+          tile_merger.report();
+        if (attention.enabled())
+          attention.report();
+        if (switch_gap.count() > 0)
+          switch_gap.report("Network switch-over gap");
+        preprocess_time.report("Preprocess (CPU)");
+        overlay_time.report("Overlay draw");
+        cam.capture_stats().report("Capture");
+        cam.frame_exporter().report("Frame export");
+        capture_to_display.report("Capture to display");
+        capture_to_video.report("Capture to video plane");
+        if (app_opts.latency_hist_file != "")
+          capture_to_display.write_csv(app_opts.latency_hist_file.c_str());
+        BufferPool::report();
+        cmem_slab.report();
+        if (app_opts.ready_file != "")
+          unlink(app_opts.ready_file.c_str());
         FreeMemory(eops);
         for (auto eop : eops)  delete eop;
         delete e_eve;
         delete e_dsp;
+        for (auto &n : extra_nets) {
+          FreeMemory(n->eops);
+          for (auto eop : n->eops)  delete eop;
+          delete n->e_eve;
+          delete n->e_dsp;
+        }
     }
     catch (tidl::Exception &e)
     {
@@ -481,14 +881,367 @@ bool RunConfiguration(const cmdline_opts_t& opts)
     return status;
 }
 
+/* Parse "<type>:<config>:<objects_list>:<eves>:<dsps>[:<rate>]" of --net */
+static bool ParseNetSpec(const string& spec, ExtraNet& n)
+{
+    vector<string> f;
+    size_t start = 0, end;
+    do {
+      end = spec.find(':', start);
+      f.push_back(spec.substr(start, end - start));
+      start = end + 1;
+    } while (end != string::npos);
+
+    if (f.size() < 5 || f.size() > 6) {
+      ERROR("--net %s: expected <type>:<config>:<objects_list>:<eves>:" \
+            "<dsps>[:<rate>]", spec.c_str());
+      return false;
+    }
+    n.net_type = f[0];
+    n.config = f[1];
+    n.objects_file = f[2];
+    n.num_eves = strtoul(f[3].c_str(), NULL, 0);
+    n.num_dsps = strtoul(f[4].c_str(), NULL, 0);
+    n.rate = f.size() > 5 ? strtoul(f[5].c_str(), NULL, 0) : 1;
+
+    if (n.net_type != "ssd" && n.net_type != "seg") {
+      ERROR("--net %s: only ssd and seg networks can be added", spec.c_str());
+      return false;
+    }
+    if (n.num_eves + n.num_dsps == 0 || n.rate == 0) {
+      ERROR("--net %s: needs at least one core and a rate of 1 or more",
+            spec.c_str());
+      return false;
+    }
+    return true;
+}
+
+/* Read the configurations of the networks given with --net, hand out their
+ * cores after the ones of the main network and reserve an overlay plane for
+ * each. Must run before the capture pipeline is initialized.
+ */
+static bool SetupExtraNets(const cmdline_opts_t& opts, CamDisp& cam,
+                           vector<std::unique_ptr<ExtraNet>>& nets)
+{
+    if (app_opts.nets.empty())
+      return true;
+    if (opts.net_type == "class") {
+      ERROR("--net can only be combined with the ssd and seg networks");
+      return false;
+    }
+    if (cam.get_num_crops() > 0) {
+      ERROR("--net can not be combined with --tiles");
+      return false;
+    }
+
+    uint32_t next_eve = opts.num_eves;
+    uint32_t next_dsp = opts.num_dsps;
+    for (auto &spec : app_opts.nets) {
+      std::unique_ptr<ExtraNet> n(new ExtraNet());
+      if (!ParseNetSpec(spec, *n))
+        return false;
+
+      string config_file = ConfigFile(n->net_type, n->config);
+      if (!n->c.ReadFromFile(config_file)) {
+        cerr << "Error in configuration file: " << config_file << endl;
+        return false;
+      }
+      n->c.enableApiTrace = opts.verbose;
+      if (n->num_eves == 0 || n->num_dsps == 0)
+        n->c.runFullNet = true;
+
+      n->first_eve = next_eve;
+      n->first_dsp = next_dsp;
+      next_eve += n->num_eves;
+      next_dsp += n->num_dsps;
+
+      if (n->net_type == "ssd") {
+        n->object_classes = std::unique_ptr<ObjectClasses>(
+                              new ObjectClasses(n->objects_file));
+        if (n->object_classes->GetNumClasses() == 0) {
+          ERROR("No object classes defined in %s", n->objects_file.c_str());
+          return false;
+        }
+      }
+
+      n->overlay = cam.add_overlay(n->net_type, n->c.inWidth, n->c.inHeight,
+                                   n->net_type == "seg" ? 150 : 255);
+      if (n->overlay < 0)
+        return false;
+      MSG("Additional %s network %s on EVE %d-%d, DSP %d-%d, every %d " \
+          "capture(s)", n->net_type.c_str(), n->config.c_str(),
+          n->first_eve, next_eve - 1, n->first_dsp, next_dsp - 1, n->rate);
+      nets.push_back(std::move(n));
+    }
+
+    if (next_eve > Executor::GetNumDevices(DeviceType::EVE) ||
+        next_dsp > Executor::GetNumDevices(DeviceType::DSP)) {
+      ERROR("The networks need %d EVEs and %d DSPs, the SoC has %d and %d",
+            next_eve, next_dsp, Executor::GetNumDevices(DeviceType::EVE),
+            Executor::GetNumDevices(DeviceType::DSP));
+      return false;
+    }
+    return true;
+}
+
+/* Collect the oldest frame of an additional network onto its overlay, if
+ * there is one, and start it on the capture at image (the img_w x img_h BGRx
+ * output of the VPE). With image == nullptr the network is only drained.
+ */
+static void RunExtraNet(ExtraNet& n, uint32_t frame_idx, const void *image,
+                        int img_w, int img_h, const cmdline_opts_t& opts,
+                        CamDisp& cam)
+{
+    ExecutionObjectPipeline *eop = n.eops[n.next_eop++ % n.eops.size()];
+    if (eop->ProcessFrameWait()) {
+      trace_eop_done(eop);
+      auto now = high_resolution_clock::now();
+      float ms = duration_cast<microseconds>(now - n.last_write).count() /
+                 1000.0f;
+      if (ms > 0)
+        n.fps = n.fps > 0 ? 0.9f * n.fps + 0.1f * (1000.0f / ms) : 1000.0f / ms;
+      n.last_write = now;
+
+      if (n.net_type == "ssd")
+        WriteFrameOutputSSD(*eop, n.c, opts, cam, n.fps, *n.object_classes,
+                            nullptr, n.overlay);
+      else
+        WriteFrameOutputSEG(*eop, n.c, opts, cam, n.fps, n.overlay);
+    }
+    if (image == nullptr)
+      return;
+
+    eop->SetFrameIndex(frame_idx);
+    char *frame_buffer = eop->GetInputBufferPtr();
+    {
+      TraceScope span("preprocess");
+      CpuAccess access = cam.image_access(image);
+      if (img_w == n.c.inWidth && img_h == n.c.inHeight) {
+        SplitToPlanar(image, img_w, img_h, frame_buffer);
+      }
+      else {
+        resize_packed_to_planar((const uint8_t *) image, img_w, img_h, 4,
+                                (uint8_t *) frame_buffer, n.c.inWidth,
+                                n.c.inHeight, 3);
+      }
+    }
+    eop->ProcessFrameStartAsync();
+    trace_eop_start(eop);
+}
+
+/* Create the executors of one network on num_eves EVEs and num_dsps DSPs,
+ * starting at device first_eve / first_dsp, and the EOPs that its frames are
+ * processed with.
+ */
+// An EOP over eos, known to the trace so its frames show up on the devices
+static void AddPipeline(vector<ExecutionObjectPipeline *>& eops,
+                        const vector<ExecutionObject *>& eos)
+{
+    eops.push_back(new ExecutionObjectPipeline(eos));
+    trace_add_pipeline(eops.back(), eos);
+}
+
+bool CreatePipelines(const string& net_type, const Configuration& c,
+                     uint32_t num_eves, uint32_t num_dsps,
+                     uint32_t first_eve, uint32_t first_dsp,
+                     Executor*& e_eve, Executor*& e_dsp,
+                     vector<ExecutionObjectPipeline *>& eops)
+{
+    // EVE will run layersGroupId 1 in the network, while
+    // DSP will run layersGroupId 2 in the network
+    if (net_type == "ssd" || net_type == "class") {
+      e_dsp = CreateExecutor(DeviceType::DSP, num_dsps, c, 2, first_dsp);
+      e_eve = CreateExecutor(DeviceType::EVE, num_eves, c, 1, first_eve);
+    }
+    else {
+      e_eve = CreateExecutor(DeviceType::EVE, num_eves, c, first_eve);
+      e_dsp = CreateExecutor(DeviceType::DSP, num_dsps, c, first_dsp);
+    }
+    if (e_eve != nullptr && e_dsp != nullptr && (net_type != "seg"))
+    {
+        // Construct ExecutionObjectPipeline that utilizes multiple
+        // ExecutionObjects to process a single frame, each ExecutionObject
+        // processes one layerGroup of the network
+        //
+        // Pipeline depth can enable more optimized pipeline execution:
+        // Given one EVE and one DSP as an example, with different
+        //     pipeline_depth, we have different execution behavior:
+        // If pipeline_depth is set to 1,
+        //    we create one EOP: eop0 (eve0, dsp0)
+        //    pipeline execution of multiple frames over time is as follows:
+        //    --------------------- time ------------------->
+        //    eop0: [eve0...][dsp0]
+        //    eop0:                [eve0...][dsp0]
+        //    eop0:                               [eve0...][dsp0]
+        //    eop0:                                              [eve0...][dsp0]
+        // If pipeline_depth is set to 2,
+        //    we create two EOPs: eop0 (eve0, dsp0), eop1(eve0, dsp0)
+        //    pipeline execution of multiple frames over time is as follows:
+        //    --------------------- time ------------------->
+        //    eop0: [eve0...][dsp0]
+        //    eop1:          [eve0...][dsp0]
+        //    eop0:                   [eve0...][dsp0]
+        //    eop1:                            [eve0...][dsp0]
+        // Additional benefit of setting pipeline_depth to 2 is that
+        //    it can also overlap host ReadFrameInput() with device processing:
+        //    --------------------- time ------------------->
+        //    eop0: [RF][eve0...][dsp0]
+        //    eop1:     [RF]     [eve0...][dsp0]
+        //    eop0:                    [RF][eve0...][dsp0]
+        //    eop1:                             [RF][eve0...][dsp0]
+        uint32_t pipeline_depth = 2;  // 2 EOs in EOP -> depth 2
+        for (uint32_t j = 0; j < pipeline_depth; j++)
+            for (uint32_t i = 0; i < max(num_eves, num_dsps); i++)
+                AddPipeline(eops, {(*e_eve)[i%num_eves], (*e_dsp)[i%num_dsps]});
+    }
+    else if (net_type == "ssd")
+    {
+        // Construct ExecutionObjectPipeline that utilizes a
+        // ExecutionObject to process a single frame, each ExecutionObject
+        // processes the full network
+        //
+        // Use duplicate EOPs to do double buffering on frame input/output
+        //    because each EOP has its own set of input/output buffers,
+        //    so that host ReadFrameInput() can overlap device processing
+        // Use one EO as an example, with different buffer_factor,
+        //    we have different execution behavior:
+        // If buffer_factor is set to 1 -> single buffering
+        //    we create one EOP: eop0 (eo0)
+        //    pipeline execution of multiple frames over time is as follows:
+        //    --------------------- time ------------------->
+        //    eop0: [RF][eo0.....][WF]
+        //    eop0:                   [RF][eo0.....][WF]
+        //    eop0:                                     [RF][eo0.....][WF]
+        // If buffer_factor is set to 2 -> double buffering
+        //    we create two EOPs: eop0 (eo0), eop1(eo0)
+        //    pipeline execution of multiple frames over time is as follows:
+        //    --------------------- time ------------------->
+        //    eop0: [RF][eo0.....][WF]
+        //    eop1:     [RF]      [eo0.....][WF]
+        //    eop0:                   [RF]  [eo0.....][WF]
+        //    eop1:                             [RF]  [eo0.....][WF]
+        uint32_t buffer_factor = 2;  // set to 1 for single buffering
+        for (uint32_t j = 0; j < buffer_factor; j++)
+        {
+            for (uint32_t i = 0; i < num_eves; i++)
+                AddPipeline(eops, {(*e_eve)[i]});
+            for (uint32_t i = 0; i < num_dsps; i++)
+                AddPipeline(eops, {(*e_dsp)[i]});
+        }
+    }
+    else if (net_type == "seg") {
+      // Get ExecutionObjects from Executors
+      vector<ExecutionObject*> eos;
+      for (uint32_t i = 0; i < num_eves; i++) eos.push_back((*e_eve)[i]);
+      for (uint32_t i = 0; i < num_dsps; i++) eos.push_back((*e_dsp)[i]);
+      MSG("eos created of size %d", eos.size());
+      uint32_t num_eos = eos.size();
+
+      // Use duplicate EOPs to do double buffering on frame input/output
+      //    because each EOP has its own set of input/output buffers,
+      //    so that host ReadFrameInput() can be overlapped with device processing
+      // Use one EO as an example, with different buffer_factor,
+      //    we have different execution behavior:
+      // If buffer_factor is set to 1 -> single buffering
+      //    we create one EOP: eop0 (eo0)
+      //    pipeline execution of multiple frames over time is as follows:
+      //    --------------------- time ------------------->
+      //    eop0: [RF][eo0.....][WF]
+      //    eop0:                   [RF][eo0.....][WF]
+      //    eop0:                                     [RF][eo0.....][WF]
+      // If buffer_factor is set to 2 -> double buffering
+      //    we create two EOPs: eop0 (eo0), eop1(eo0)
+      //    pipeline execution of multiple frames over time is as follows:
+      //    --------------------- time ------------------->
+      //    eop0: [RF][eo0.....][WF]
+      //    eop1:     [RF]      [eo0.....][WF]
+      //    eop0:                   [RF]  [eo0.....][WF]
+      //    eop1:                             [RF]  [eo0.....][WF]
+      uint32_t buffer_factor = 2;  // set to 1 for single buffering
+      for (uint32_t j = 0; j < buffer_factor; j++)
+          for (uint32_t i = 0; i < num_eos; i++)
+              AddPipeline(eops, {eos[i]});
+      MSG("eops of size %d created", eops.size());
+    }
+    else {
+      ERROR("NETWORK NOT INITIALIZED");
+      return false;
+    }
+    return true;
+}
+
+/* Push num synthetic (gray) frames through every EOP before the live ones,
+ * so that the one-time costs of the first frames (layer groups loaded onto
+ * the cores, cold caches) are paid before the capture starts. The first
+ * frame and the ones after it are reported apart for every EOP.
+ */
+static void WarmUp(vector<ExecutionObjectPipeline *>& eops, int num, const string& name)
+{
+    if (num <= 0)
+      return;
+
+    LatencyStats warm;
+    for (uint32_t i = 0; i < eops.size(); i++) {
+      ExecutionObjectPipeline *eop = eops[i];
+      memset(eop->GetInputBufferPtr(), 128, eop->GetInputBufferSizeInBytes());
+      double cold_ms = 0, warm_ms = 0;
+      for (int f = 0; f < num; f++) {
+        eop->SetFrameIndex(f);
+        auto start = chrono::steady_clock::now();
+        eop->ProcessFrameStartAsync();
+        eop->ProcessFrameWait();
+        double ms = chrono::duration<double, milli>(
+          chrono::steady_clock::now() - start).count();
+        if (f == 0) {
+          cold_ms = ms;
+        }
+        else {
+          warm_ms += ms;
+          warm.add(ms);
+        }
+      }
+      if (num > 1)
+        MSG("%s EOP %u (%s) warm-up: first frame %.1f ms, then %.1f ms",
+            name.c_str(), i, eop->GetDeviceName().c_str(), cold_ms,
+            warm_ms / (num - 1));
+      else
+        MSG("%s EOP %u (%s) warm-up: first frame %.1f ms", name.c_str(), i,
+            eop->GetDeviceName().c_str(), cold_ms);
+    }
+    if (warm.count() > 0)
+      warm.report((name + " warm EOP latency").c_str());
+}
+
+/* Tell an outside watchdog that the networks are loaded (and warmed up) and
+ * the capture is streaming: path is written with the pid and the time since
+ * start, and removed again at the end of the run.
+ */
+static void SignalReady(const string& path)
+{
+    double ms = chrono::duration<double, milli>(
+      chrono::steady_clock::now() - process_start).count();
+    MSG("Pipeline ready after %.0f ms", ms);
+    if (path == "")
+      return;
+
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp) {
+      ERROR("Could not write the ready file %s: %s", path.c_str(),
+            strerror(errno));
+      return;
+    }
+    fprintf(fp, "pid %d\nready_ms %.0f\n", (int) getpid(), ms);
+    fclose(fp);
+}
+
 // SSD: Create an Executor with the specified type and number of EOs
 Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c,
-                         int layers_group_id)
+                         int layers_group_id, uint32_t first_id)
 {
     if (num == 0) return nullptr;
 
     DeviceIds ids;
-    for (uint32_t i = 0; i < num; i++)
+    for (uint32_t i = first_id; i < first_id + num; i++)
         ids.insert(static_cast<DeviceId>(i));
 
     Executor* e = new Executor(dt, ids, c, layers_group_id);
@@ -497,12 +1250,13 @@ Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c,
 }
 
 // SEG: Create an Executor with the specified type and number of EOs
-Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c)
+Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c,
+                         uint32_t first_id)
 {
     if (num == 0) return nullptr;
 
     DeviceIds ids;
-    for (uint32_t i = 0; i < num; i++)
+    for (uint32_t i = first_id; i < first_id + num; i++)
         ids.insert(static_cast<DeviceId>(i));
 
     return new Executor(dt, ids, c);
@@ -512,8 +1266,6 @@ Executor* CreateExecutor(DeviceType dt, uint32_t num, const Configuration& c)
 /******************************************************************************/
 /********************** Read Input into TIDL Functions ************************/
 /* This function will read the captured frame into the input buffer of TIDL.
- * However, the output buffer is left alone for TIDL to allocate and manage the
- * memory.
  */
 bool ReadFrameInput(ExecutionObjectPipeline& eop, uint32_t frame_idx,
                const Configuration& c, const cmdline_opts_t& opts,
@@ -523,31 +1275,36 @@ bool ReadFrameInput(ExecutionObjectPipeline& eop, uint32_t frame_idx,
         return false;
 
     eop.SetFrameIndex(frame_idx);
-    char *in_ptr = (char *) cap.grab_image();
-    int channel_size = c.inWidth*c.inHeight;
-
-    /* More efficient method after testing */
-    Mat pic(cvSize(c.inWidth, c.inHeight), CV_8UC4, in_ptr);
-    Mat channels[4];
-    split(pic, channels);
+    // a new capture, or the next region of the current one
+    char *in_ptr = (char *) cap.grab_crop(frame_idx);
+    if (in_ptr == nullptr) {
+        // the loop drains the EOPs and stops as on SIGINT
+        ERROR("No capture for frame %u, stopping", frame_idx);
+        stop_requested = 1;
+        return false;
+    }
     char*  frame_buffer = eop.GetInputBufferPtr();
-
-    auto cpyStart = high_resolution_clock::now();
-    memcpy(frame_buffer, channels[0].ptr(), channel_size);
-    memcpy(frame_buffer+channel_size, channels[1].ptr(), channel_size);
-    memcpy(frame_buffer+(2*channel_size), channels[2].ptr(), channel_size);
-    auto cpyStop = high_resolution_clock::now();
-    auto cpyDuration = duration_cast<milliseconds>(cpyStop - cpyStart);
-    if (opts.verbose) DBG("VPE -> TIDL memcpy time: %d ms", (int)
-      cpyDuration.count());
     assert (frame_buffer != nullptr);
+
+    auto splitStart = high_resolution_clock::now();
+    {
+      TraceScope span("preprocess");
+      CpuAccess access = cap.image_access(in_ptr);
+      SplitToPlanar(in_ptr, c.inWidth, c.inHeight, frame_buffer);
+    }
+    auto splitStop = high_resolution_clock::now();
+    preprocess_time.add(chrono::duration<double, milli>(splitStop -
+                                                        splitStart).count());
+    if (opts.verbose) LOGD("VPE -> TIDL split time: %d us", (int)
+      duration_cast<microseconds>(splitStop - splitStart).count());
+    cap.release_crop(frame_idx);
     return true;
 }
 
 /* This function will read the captured frame into the input buffer of TIDL. It
- * will also send the output of TIDL (still allocated/managed by TIDL) directly
- * to the display system. This is an optimized display overlay method for
- * something like a segmentation neural network.
+ * will also send the output of TIDL directly to the display system. This is
+ * an optimized display overlay method for something like a segmentation
+ * neural network.
  */
 bool ReadFrameIO(ExecutionObjectPipeline& eop, uint32_t frame_idx,
                const Configuration& c, const cmdline_opts_t& opts,
@@ -558,21 +1315,26 @@ bool ReadFrameIO(ExecutionObjectPipeline& eop, uint32_t frame_idx,
 
     eop.SetFrameIndex(frame_idx);
     char *in_ptr = (char *) cap.grab_image();
-    int channel_size = c.inWidth*c.inHeight;
-
-    /* More efficient method after testing */
-    Mat pic(cvSize(c.inWidth, c.inHeight), CV_8UC4, in_ptr);
-    Mat channels[4];
-    split(pic, channels);
+    if (in_ptr == nullptr) {
+        ERROR("No capture for frame %u, stopping", frame_idx);
+        stop_requested = 1;
+        return false;
+    }
     char*  frame_buffer = eop.GetInputBufferPtr();
-    memcpy(frame_buffer, channels[0].ptr(), channel_size);
-    memcpy(frame_buffer+channel_size, channels[1].ptr(), channel_size);
-    memcpy(frame_buffer+(2*channel_size), channels[2].ptr(), channel_size);
-
-    ArgInfo in = {ArgInfo(frame_buffer, channel_size*3)};
-    ArgInfo out = {ArgInfo(cap.get_overlay_plane_ptr(), channel_size)};
-    eop.SetInputOutputBuffer(in, out);
     assert (frame_buffer != nullptr);
+    ArgInfo in = {ArgInfo(frame_buffer, eop.GetInputBufferSizeInBytes())};
+    ArgInfo out = {ArgInfo(cap.get_overlay_plane_ptr(),
+                           eop.GetOutputBufferSizeInBytes())};
+    eop.SetInputOutputBuffer(in, out);
+
+    auto splitStart = high_resolution_clock::now();
+    {
+      TraceScope span("preprocess");
+      CpuAccess access = cap.image_access(in_ptr);
+      SplitToPlanar(in_ptr, c.inWidth, c.inHeight, frame_buffer);
+    }
+    preprocess_time.add(chrono::duration<double, milli>(
+      high_resolution_clock::now() - splitStart).count());
     return true;
 }
 /******************************************************************************/
@@ -587,7 +1349,8 @@ bool ReadFrameIO(ExecutionObjectPipeline& eop, uint32_t frame_idx,
  */
 bool WriteFrameOutputSSD(const ExecutionObjectPipeline& eop,
                       const Configuration& c, const cmdline_opts_t& opts,
-                      CamDisp& cam, float fps)
+                      CamDisp& cam, float fps, ObjectClasses& classes,
+                      ClassCascade *casc, int overlay)
 {
     // Asseemble original frame
     int width  = c.inWidth;
@@ -598,7 +1361,8 @@ bool WriteFrameOutputSSD(const ExecutionObjectPipeline& eop,
     /* clear the old rectangles - note that
      * cam.get_overlay_plane_ptr() is where the data from the display sub system is.
      */
-    void *dss_data = cam.get_overlay_plane_ptr();
+    void *dss_data = cam.get_overlay_plane_ptr(overlay);
+    CpuAccess access = cam.overlay_access(overlay);
     memset(dss_data, 0, height*width*4);
 
     /* Data is being read in as bgra - thus the user may control the alpha
@@ -608,73 +1372,191 @@ bool WriteFrameOutputSSD(const ExecutionObjectPipeline& eop,
      */
     frame = Mat(height, width, CV_8UC4, dss_data);
 
-    // Draw boxes around classified objects
+    // Collect the boxes of the detected objects
     float *out = (float *) eop.GetOutputBufferPtr();
     int num_floats = eop.GetOutputBufferSizeInBytes() / sizeof(float);
-    for (int i = 0; i < num_floats / 7; i++)
+    CascadeBox boxes[MAX_SSD_BOXES];
+    int num_boxes = 0;
+    v4l2_rect lb = {0, 0, (uint32_t) width, (uint32_t) height};
+    if (overlay == 0)
+      lb = cam.get_letterbox();
+    int left = lb.left, top = lb.top;
+    int right = lb.left + lb.width, bottom = lb.top + lb.height;
+    ssd_det_t dets[num_floats / 7 + 1];
+    int num_dets = ParseSSDOutput(out, num_floats, confidence_value / 100,
+                                  width, height, dets, num_floats / 7);
+    for (int i = 0; i < num_dets && num_boxes < MAX_SSD_BOXES; i++)
     {
-        int index = (int)    out[i * 7 + 0];
-        if (index < 0)  break;
+        float score = dets[i].score;
+        int   label = dets[i].label;
+        int   xmin  = (int) dets[i].xmin;
+        int   ymin  = (int) dets[i].ymin;
+        int   xmax  = (int) dets[i].xmax;
+        int   ymax  = (int) dets[i].ymax;
+
+        const ObjectClass& object_class = classes.At(label);
+        if (!SSDLabelWanted(object_class.label, casc != nullptr))
+          continue;
 
-        float score =        out[i * 7 + 2];
-        if (score * 100 < confidence_value)  continue;
+        if (opts.verbose) {
+            LOGI("%2d: (%d, %d) -> (%d, %d): %s, score=%f",
+               i, xmin, ymin, xmax, ymax, object_class.label.c_str(), score);
+        }
+
+        // with letterbox the image only covers lb, not the bars around it
+        if (xmin < left)    xmin = left;
+        if (ymin < top)     ymin = top;
+        if (xmax > right)   xmax = right;
+        if (ymax > bottom)  ymax = bottom;
+        if (xmax <= xmin || ymax <= ymin)  continue;
+
+        boxes[num_boxes++] = {xmin, ymin, xmax, ymax, label, score, -1, 0};
+    }
+    num_detections += num_boxes;
 
-        int   label = (int)  out[i * 7 + 1];
-        int   xmin  = (int) (out[i * 7 + 3] * width);
-        int   ymin  = (int) (out[i * 7 + 4] * height);
-        int   xmax  = (int) (out[i * 7 + 5] * width);
-        int   ymax  = (int) (out[i * 7 + 6] * height);
+    /* Second stage of the cascade: the boxes are classified from the frame
+     * in the input buffer of this EOP while the frames that follow are
+     * detected, what is drawn are the boxes of the frame before with their
+     * classes
+     */
+    CascadeBox classified[MAX_SSD_BOXES];
+    CascadeBox *draw = boxes;
+    if (casc) {
+      num_boxes = casc->classify((const uint8_t *) eop.GetInputBufferPtr(),
+                                 width, height, boxes, num_boxes, classified,
+                                 MAX_SSD_BOXES);
+      draw = classified;
+    }
+
+    // Draw boxes around classified objects
+    for (int b = 0; b < num_boxes; b++)
+    {
+        const CascadeBox &box = draw[b];
+        const ObjectClass& object_class = classes.At(box.label);
+        string text = object_class.label;
+        if (casc && box.id >= 0 && tf_expected_id(box.id))
+          text = labels_classes[box.id];
+
+        DrawSSDBox(frame, object_class, text, box.xmin, box.ymin,
+                   box.xmax, box.ymax);
+        if (overlay == 0)
+          results.add_box(box.label, box.score,
+                          (float) (box.xmin - left) / lb.width,
+                          (float) (box.ymin - top) / lb.height,
+                          (float) (box.xmax - left) / lb.width,
+                          (float) (box.ymax - top) / lb.height);
+    }
+    OverlayFPS(frame, c.inWidth, c.inHeight, fps, 1);
 
-        const ObjectClass& object_class = object_classes->At(label);
+    return true;
+}
 
-        // for now, we really just want the pedestrian label
-        if (object_class.label != "pedestrian")
+/* SSD on a part of the capture (a tile or the attention window, src in
+ * capture coordinates): the boxes are mapped back to the capture and
+ * collected. With last set, as for the last tile of a capture, they are
+ * merged with a class-aware NMS and drawn over the full frame. Returns the
+ * number of boxes drawn, which merger.boxes() holds in capture coordinates.
+ */
+int WriteFrameOutputSSDMapped(const ExecutionObjectPipeline& eop,
+                      const Configuration& c, const cmdline_opts_t& opts,
+                      CamDisp& cam, float fps, ObjectClasses& classes,
+                      TileMerger& merger, const v4l2_rect& src, bool last)
+{
+    float confidence_value = 30;
+    const v4l2_rect &lb = cam.get_letterbox();
+    float lx = (float) lb.left / c.inWidth;
+    float ly = (float) lb.top / c.inHeight;
+    float lw = (float) lb.width / c.inWidth;
+    float lh = (float) lb.height / c.inHeight;
+
+    float *out = (float *) eop.GetOutputBufferPtr();
+    int num_floats = eop.GetOutputBufferSizeInBytes() / sizeof(float);
+    // corners relative to the model input
+    ssd_det_t dets[num_floats / 7 + 1];
+    int num_dets = ParseSSDOutput(out, num_floats, confidence_value / 100,
+                                  1, 1, dets, num_floats / 7);
+    for (int i = 0; i < num_dets; i++)
+    {
+        const ssd_det_t &d = dets[i];
+        if (!SSDLabelWanted(classes.At(d.label).label, false))
           continue;
 
-        int thickness = 1;
-        double scale = 0.6;
-        int baseline = 0;
+        // from the model input to the letterbox region that src fills
+        merger.add(src, (d.xmin - lx) / lw, (d.ymin - ly) / lh,
+                        (d.xmax - lx) / lw, (d.ymax - ly) / lh,
+                        d.score, d.label);
+    }
+    if (!last)
+      return 0;
 
-        Size text_size = getTextSize(object_class.label, FONT_HERSHEY_DUPLEX, scale,
-                                    thickness, &baseline);
-        baseline += thickness;
+    int num_boxes = merger.merge();
+    const det_box_t *boxes = merger.boxes();
+    num_detections += num_boxes;
 
+    /* the overlay covers the full capture at the model resolution, in the
+     * letterbox region of the display
+     */
+    void *dss_data = cam.get_overlay_plane_ptr();
+    CpuAccess access = cam.overlay_access();
+    memset(dss_data, 0, c.inHeight*c.inWidth*4);
+    Mat frame(c.inHeight, c.inWidth, CV_8UC4, dss_data);
+    const v4l2_rect &dl = cam.get_display_letterbox();
+    float sx = (float) dl.width / merger.cap_width();
+    float sy = (float) dl.height / merger.cap_height();
+    int right = dl.left + dl.width, bottom = dl.top + dl.height;
+
+    for (int b = 0; b < num_boxes; b++)
+    {
+        const ObjectClass& object_class = classes.At(boxes[b].label);
+        int xmin = max((int) dl.left, (int) (dl.left + boxes[b].xmin * sx));
+        int ymin = max((int) dl.top, (int) (dl.top + boxes[b].ymin * sy));
+        int xmax = min(right, (int) (dl.left + boxes[b].xmax * sx));
+        int ymax = min(bottom, (int) (dl.top + boxes[b].ymax * sy));
         if (opts.verbose) {
-            printf("%2d: (%d, %d) -> (%d, %d): %s, score=%f\n",
-               i, xmin, ymin, xmax, ymax, object_class.label.c_str(), score);
+            LOGI("%2d: (%d, %d) -> (%d, %d): %s, score=%f", b, xmin, ymin,
+                   xmax, ymax, object_class.label.c_str(), boxes[b].score);
         }
+        DrawSSDBox(frame, object_class, object_class.label, xmin, ymin,
+                   xmax, ymax);
+        results.add_box(boxes[b].label, boxes[b].score,
+                        boxes[b].xmin / merger.cap_width(),
+                        boxes[b].ymin / merger.cap_height(),
+                        boxes[b].xmax / merger.cap_width(),
+                        boxes[b].ymax / merger.cap_height());
+    }
+    OverlayFPS(frame, c.inWidth, c.inHeight, fps, 1);
 
-        int alpha = 255;
-        if (xmin < 0)       xmin = 0;
-        if (ymin < 0)       ymin = 0;
-        if (xmax > width)   xmax = width;
-        if (ymax > height)  ymax = height;
-        cv::rectangle(frame, Point(xmin, ymin), Point(xmax, ymax),
-                      Scalar(object_class.color.blue,
-                             object_class.color.green,
-                             object_class.color.red, alpha), 2);
-
-       // place the name of the class at the botton of the box
-       cv::rectangle(frame, Point(xmin,ymax) + Point(0, baseline),
-             Point(xmin,ymax) + Point(text_size.width,
-             -text_size.height) , Scalar(0,0,0,alpha), -1);
-       cv::putText(frame, object_class.label, Point(xmin,ymax),
-                   FONT_HERSHEY_DUPLEX, scale, Scalar(255,255,255,alpha), thickness);
-
-        MSG("%s class blue %d, green %d, red %d", object_class.label.c_str(),
-          object_class.color.blue, object_class.color.green,
-          object_class.color.red);
-    }
-    OverlayFPS(frame, c, fps, 1);
+    return num_boxes;
+}
 
-    return true;
+// Labels of the SSD output that are drawn
+static bool SSDLabelWanted(const string& label, bool cascade_filter)
+{
+    if (cascade_filter)
+      return app_opts.cascade_class == "" || label == app_opts.cascade_class;
+    // for now, we really just want the pedestrian label
+    return label == "pedestrian";
+}
+
+// Draw a box with its label at the bottom
+static void DrawSSDBox(Mat& frame, const ObjectClass& object_class,
+                       const string& text, int xmin, int ymin, int xmax,
+                       int ymax)
+{
+    DrawBox(frame, Scalar(object_class.color.blue, object_class.color.green,
+                          object_class.color.red, 255),
+            text, xmin, ymin, xmax, ymax);
+    LOGT("%s class blue %d, green %d, red %d", object_class.label.c_str(),
+      object_class.color.blue, object_class.color.green,
+      object_class.color.red);
 }
 
 
 // Create frame overlayed with pixel-level segmentation
 bool WriteFrameOutputSEG(const ExecutionObjectPipeline &eop,
                       const Configuration& c,
-                      const cmdline_opts_t& opts, CamDisp& cap, float fps)
+                      const cmdline_opts_t& opts, CamDisp& cap, float fps,
+                      int overlay)
 {
     unsigned char *out = (unsigned char *) eop.GetOutputBufferPtr();
     int width          = c.inWidth;
@@ -684,32 +1566,14 @@ bool WriteFrameOutputSEG(const ExecutionObjectPipeline &eop,
     /* note that
      * cap.get_overlay_plane_ptr(); is where the data from the display sub system is.
      */
-    uint16_t *dss_data = (uint16_t *) cap.get_overlay_plane_ptr();
-
-    // Color fmt is 0bXXXXRRRRGGGGBBBB
-    for (int i = 0; i < channel_size; i++) {
-      switch (out[i]) {
-        case 0: // background class
-          dss_data[i] = out[i];
-          break;
-        case 1: // road class
-          dss_data[i] = 0x00F0;
-          break;
-        case 2: // pedestrian class
-          dss_data[i] = 0x0F00;
-          break;
-        case 3: // road sign class
-          dss_data[i] = 0x000F;
-          break;
-        case 4: // vehicle class
-          dss_data[i] = 0x0FF0;
-          break;
-        default:
-          dss_data[i] = 0x0000;
-        }
-    }
+    uint16_t *dss_data = (uint16_t *) cap.get_overlay_plane_ptr(overlay);
+    CpuAccess access = cap.overlay_access(overlay);
+
+    ColorizeSeg(out, channel_size, dss_data);
+    if (overlay == 0)
+      results.set_mask(out, width, height);
     Mat frame(c.inHeight, c.inWidth, CV_16UC1, dss_data);
-    OverlayFPS(frame, c, fps, 1);
+    OverlayFPS(frame, c.inWidth, c.inHeight, fps, 1);
     return true;
 }
 
@@ -725,6 +1589,7 @@ void WriteFrameOutputCLASS(const ExecutionObjectPipeline* eop, CamDisp &cam,
    * cam.get_overlay_plane_ptr() is where the data from the display sub system is.
    */
   void *dss_data = cam.get_overlay_plane_ptr();
+  CpuAccess access = cam.overlay_access();
   memset(dss_data, 0, height*width*4);
 
   /* Data is being read in as bgra - thus the user may control the alpha
@@ -736,74 +1601,34 @@ void WriteFrameOutputCLASS(const ExecutionObjectPipeline* eop, CamDisp &cam,
 
   int f_id = eop->GetFrameIndex();
   int curr_roi = f_id % NUM_ROI;
-  int is_object = tf_postprocess((uchar*) eop->GetOutputBufferPtr(),
-                                 eop->GetOutputBufferSizeInBytes(),
-                               IMAGE_CLASSES_NUM, curr_roi, frame_idx, f_id);
-  int alpha = 255;
+  uint32_t seq = f_id / NUM_ROI;
+  int ids[TOPK_MAX];
+  float probs[TOPK_MAX];
+  int num = tf_postprocess((uchar*) eop->GetOutputBufferPtr(),
+                           eop->GetOutputBufferSizeInBytes(),
+                           IMAGE_CLASSES_NUM, curr_roi, frame_idx, f_id,
+                           ids, probs);
   double scale = 0.6;
 
-  selclass_history[curr_roi][2] = selclass_history[curr_roi][1];
-  selclass_history[curr_roi][1] = selclass_history[curr_roi][0];
-  selclass_history[curr_roi][0] = is_object;
+  class_vote.update(curr_roi, seq, ids, probs, num);
+  for (int i = 0; i < num; i++)
+    results.add_box(ids[i], probs[i], 0, 0, 1, 1);
   for (int r = 0; r < NUM_ROI; r++)
   {
-    int rpt_id =  ShowRegion(selclass_history[r]);
+    int rpt_id = class_vote.decide(r, seq);
     if(rpt_id >= 0)
     {
-      int thickness = 1;
-      int baseline = 0;
-
-      Size text_size = getTextSize(labels_classes[rpt_id], FONT_HERSHEY_DUPLEX,
-        scale, thickness, &baseline);
-      baseline += thickness;
-      // place the name of the class at the botton of the box
-      cv::rectangle(frame, Point(0,c.inHeight),
-             Point(text_size.width, c.inHeight-text_size.height-baseline),
-             Scalar(0,0,0,alpha), -1);
-      cv::putText(frame, labels_classes[rpt_id], Point(0,c.inHeight-baseline),
-                  FONT_HERSHEY_DUPLEX, scale, Scalar(255,255,255,alpha),
-                  thickness);
+      string label = labels_classes[rpt_id];
+      if (NUM_ROI > 1)
+        label = "ROI " + to_string(r) + ": " + label;
+      // one line per ROI at the bottom
+      DrawClassLabel(frame, label, r, scale);
     }
   }
-  OverlayFPS(frame, c, fps, 0.45);
+  OverlayFPS(frame, c.inWidth, c.inHeight, fps, 0.45);
 }
 
 
-/* OverlayFPS takes as an argument, a CV Mat class that is the screen to be
- * written upon, the configuration, the fps to be written, and the scale
- * (essentially the size) of the text. It will then overlay the fps onto the
- * image that was passed in on the bottom right corner
- */
-void OverlayFPS(Mat fps_screen, const Configuration& c, float fps, double scale) {
-
-  // write the data in the bottom right corner of the screen
-  int thickness = 1;
-  int baseline = 0;
-
-  char fps_string[20];
-  sprintf(fps_string, "FPS: %.2f", fps);
-  Size text_size = getTextSize(fps_string, FONT_HERSHEY_DUPLEX, scale,
-                              thickness, &baseline);
-  baseline += thickness;
-  // place the name of the class at the botton of the box
-  if (fps_screen.channels() == 4) {
-    cv::rectangle(fps_screen, Point(c.inWidth,c.inHeight),
-      Point(c.inWidth, c.inHeight) - Point(text_size.width, text_size.height),
-      Scalar(0,0,0,255), -1);
-    cv::putText(fps_screen, fps_string, Point(c.inWidth, c.inHeight) -
-      Point(text_size.width, 0), FONT_HERSHEY_DUPLEX, scale,
-      Scalar(255,255,255,255), thickness);
-  }
-  else {
-    cv::rectangle(fps_screen, Point(c.inWidth,c.inHeight),
-      Point(c.inWidth, c.inHeight) - Point(text_size.width,
-      text_size.height+baseline), 0xF000, -1);
-    cv::putText(fps_screen, fps_string, Point(c.inWidth, c.inHeight) -
-      Point(text_size.width, 0), FONT_HERSHEY_DUPLEX, scale,
-      0xFFFF, thickness);
-  }
-
-}
 /******************************************************************************/
 /******************************************************************************/
 
@@ -811,14 +1636,6 @@ void OverlayFPS(Mat fps_screen, const Configuration& c, float fps, double scale)
 
 /******************************************************************************/
 /**************** Classification Display Helper Functions *********************/
-int ShowRegion(int roi_history[])
-{
-  if((roi_history[0] >= 0) && (roi_history[0] == roi_history[1])) return roi_history[0];
-  if((roi_history[0] >= 0) && (roi_history[0] == roi_history[2])) return roi_history[0];
-  if((roi_history[1] >= 0) && (roi_history[1] == roi_history[2])) return roi_history[1];
-  return -1;
-}
-
 // Function to filter all the reported decisions
 bool tf_expected_id(int id)
 {
@@ -829,58 +1646,47 @@ bool tf_expected_id(int id)
    }
    return false;
 }
-//Temporal averaging
-int TOP_CANDIDATES = 3;
+/* Fill ids/probs with the expected classes among the top candidates, best
+ * first, and return how many there are.
+ */
 int tf_postprocess(uchar *in, int out_size, int size, int roi_idx,
-                   int frame_idx, int f_id)
+                   int frame_idx, int f_id, int *ids, float *probs)
 {
   //prob_i = exp(TIDL_Lib_output_i) / sum(exp(TIDL_Lib_output))
-  // sort and get k largest values and corresponding indices
+  // get k largest values and corresponding indices, largest first
   const int k = TOP_CANDIDATES;
-  int rpt_id = -1;
+  int num = 0;
   // Tensorflow trained network outputs 1001 probabilities,
   // with 0-index being background, thus we need to subtract 1 when
   // reporting classified object from 1000 categories
-  int background_offset = out_size == 1001 ? 1 : 0;
-
-  typedef std::pair<uchar, int> val_index;
-  auto cmp = [](val_index &left, val_index &right) { return left.first > right.first; };
-  std::priority_queue<val_index, std::vector<val_index>, decltype(cmp)> queue(cmp);
-  // initialize priority queue with smallest value on top
-  for (int i = 0; i < k; i++) {
-    queue.push(val_index(in[i], i));
-  }
-  // for rest input, if larger than current minimum, pop mininum, push new val
-  for (int i = k; i < size; i++)
-  {
-    if (in[i] > queue.top().first)
-    {
-      queue.pop();
-      queue.push(val_index(in[i], i));
-    }
-  }
+  int background_offset = out_size == size + 1 ? 1 : 0;
 
-  // output top k values in reverse order: largest val first
-  std::vector<val_index> sorted;
-  while (! queue.empty())
-  {
-    sorted.push_back(queue.top());
-    queue.pop();
-  }
+  topk_result_t top;
+  topk_u8(in, out_size, k, &top);
 
-  for (int i = 0; i < k; i++)
-  {
-      int id = sorted[i].second - background_offset;
+  float denom = 0;
+  if (app_opts.softmax_scale > 0)
+    denom = topk_softmax_denom(in, out_size, top.val[0]);
 
-      if (tf_expected_id(id))
-      {
-        std::cout << "Frame:" << frame_idx << "," << f_id << " ROI[" << roi_idx
-        << "]: rank=" << k-i << ", outval=" << (float)sorted[i].first / 255
-        << ", " << labels_classes[id] << std::endl;
-        rpt_id = id;
-      }
+  for (int i = 0; i < top.k; i++)
+  {
+      int id = top.idx[i] - background_offset;
+      if (id < 0 || id >= size || !tf_expected_id(id))
+        continue;
+
+      float prob = (denom > 0) ?
+        topk_softmax_prob(top.val[i], top.val[0], denom) :
+        (float) top.val[i] / 255;
+      if (prob < CLASS_MIN_PROB)
+        continue;
+
+      LOGI("Frame:%d,%d ROI[%d]: rank=%d, prob=%f, %s", frame_idx, f_id,
+          roi_idx, i + 1, prob, labels_classes[id].c_str());
+      ids[num] = id;
+      probs[num] = prob;
+      num++;
   }
-  return rpt_id;
+  return num;
 }
 /******************************************************************************/
 /******************************************************************************/
@@ -911,4 +1717,48 @@ void DisplayHelp()
     " and less computationally expensive dislay routine\n"
     " -v                   Verbose output during execution\n"
     " -h                   Help\n";
+    DisplayAppHelp();
 }
+
+/* Snapshot of the frame loop for the metrics socket, detections per second
+ * are counted since the last one
+ */
+static void PublishMetrics(CamDisp& cam, double uptime_s, uint64_t frames,
+                           float fps, int num_eops, double eop_utilization)
+{
+    static uint64_t last_detections = 0;
+    static double last_uptime_s = 0;
+    metrics_snapshot_t s;
+    memset(&s, 0, sizeof(s));
+
+    s.uptime_s = uptime_s;
+    s.frames = frames;
+    s.fps = fps;
+    s.num_eops = num_eops;
+    s.eop_utilization = eop_utilization;
+    const CaptureStats &capture = cam.capture_stats();
+    s.captures = capture.frames();
+    s.dropped_frames = capture.lost();
+    s.sequence_gaps = capture.gaps();
+    s.starved = capture.starved();
+    s.detections = num_detections;
+    if (uptime_s > last_uptime_s)
+      s.detections_per_s = (num_detections - last_detections) /
+                           (uptime_s - last_uptime_s);
+    last_detections = num_detections;
+    last_uptime_s = uptime_s;
+    size_t used, size, exported;
+    cmem_slab.usage(&used, &size, &exported);
+    s.cmem_slab_used = used;
+    s.cmem_slab_size = size;
+    s.cmem_exported = exported;
+    s.display_buffer_bytes = BufferPool::total_bytes();
+
+    metrics_add_stage(s, "capture_wait", capture.dqbuf_wait());
+    metrics_add_stage(s, "preprocess", preprocess_time);
+    metrics_add_stage(s, "eop", eop_time);
+    metrics_add_stage(s, "overlay", overlay_time);
+    metrics_add_stage(s, "capture_to_display", capture_to_display);
+    metrics_publish(s);
+}
+
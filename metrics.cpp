@@ -0,0 +1,286 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <atomic>
+#include <thread>
+#include "metrics.h"
+#include "error.h"
+
+// a client gets this long to send its request, else it gets Prometheus text
+#define REQUEST_TIMEOUT_MS 100
+
+static std::atomic<uint32_t> snap_seq(0);
+static metrics_snapshot_t snap;
+static std::thread server;
+static std::string socket_path;
+static int listen_fd = -1;
+static int stop_pipe[2] = {-1, -1};
+
+void metrics_publish(const metrics_snapshot_t &s)
+{
+  // odd while the snapshot is written, readers try again
+  uint32_t seq = snap_seq.load(std::memory_order_relaxed);
+  snap_seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&snap, &s, sizeof(snap));
+  snap_seq.store(seq + 2, std::memory_order_release);
+}
+
+static void read_snapshot(metrics_snapshot_t &s)
+{
+  for (;;) {
+    uint32_t seq = snap_seq.load(std::memory_order_acquire);
+    if (seq & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    memcpy(&s, &snap, sizeof(s));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (snap_seq.load(std::memory_order_relaxed) == seq)
+      return;
+  }
+}
+
+void metrics_add_stage(metrics_snapshot_t &s, const char *name,
+                       const LatencyStats &stats)
+{
+  if (s.num_stages >= METRICS_MAX_STAGES)
+    return;
+  metrics_stage_t &st = s.stage[s.num_stages++];
+  snprintf(st.name, sizeof(st.name), "%s", name);
+  st.count = stats.count();
+  st.p50_ms = stats.percentile(50);
+  st.p99_ms = stats.percentile(99);
+  st.max_ms = stats.max();
+}
+
+static void append(std::string &out, const char *fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+static void append(std::string &out, const char *fmt, ...)
+{
+  char line[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  out += line;
+}
+
+static void metric(std::string &out, const char *name, const char *type,
+                   const char *help, double value)
+{
+  append(out, "# HELP tidl_%s %s\n# TYPE tidl_%s %s\ntidl_%s %.6g\n", name,
+         help, name, type, name, value);
+}
+
+static std::string prometheus(const metrics_snapshot_t &s)
+{
+  std::string out;
+  metric(out, "uptime_seconds", "gauge", "Time since the frame loop started",
+         s.uptime_s);
+  metric(out, "frames_total", "counter", "Frames shown", s.frames);
+  metric(out, "fps", "gauge", "Frames per second", s.fps);
+  metric(out, "eops", "gauge", "Execution object pipelines", s.num_eops);
+  metric(out, "eop_utilization", "gauge",
+         "Share of the time the EOPs had a frame in flight", s.eop_utilization);
+  metric(out, "capture_frames_total", "counter", "Frames dequeued from the "
+         "camera", s.captures);
+  metric(out, "capture_dropped_frames_total", "counter",
+         "Frames missing in the capture sequence", s.dropped_frames);
+  metric(out, "capture_sequence_gaps_total", "counter",
+         "Gaps in the capture sequence", s.sequence_gaps);
+  metric(out, "capture_starved_total", "counter",
+         "Dequeues that left no buffer with the driver", s.starved);
+  metric(out, "detections_total", "counter", "Boxes drawn", s.detections);
+  metric(out, "detections_per_second", "gauge", "Boxes drawn per second",
+         s.detections_per_s);
+  metric(out, "cmem_slab_used_bytes", "gauge", "Bytes of the CMEM slab in use",
+         s.cmem_slab_used);
+  metric(out, "cmem_slab_size_bytes", "gauge", "Size of the CMEM slab",
+         s.cmem_slab_size);
+  metric(out, "cmem_exported_bytes", "gauge",
+         "Bytes of the CMEM allocations with a dmabuf of their own",
+         s.cmem_exported);
+  metric(out, "display_buffer_bytes", "gauge",
+         "Bytes of the capture and display buffers", s.display_buffer_bytes);
+
+  out += "# HELP tidl_stage_latency_ms Latency of the pipeline stages\n"
+         "# TYPE tidl_stage_latency_ms summary\n";
+  for (int i = 0; i < s.num_stages; i++) {
+    const metrics_stage_t &st = s.stage[i];
+    append(out, "tidl_stage_latency_ms{stage=\"%s\",quantile=\"0.5\"} %.3f\n",
+           st.name, st.p50_ms);
+    append(out, "tidl_stage_latency_ms{stage=\"%s\",quantile=\"0.99\"} %.3f\n",
+           st.name, st.p99_ms);
+    append(out, "tidl_stage_latency_ms{stage=\"%s\",quantile=\"1\"} %.3f\n",
+           st.name, st.max_ms);
+    append(out, "tidl_stage_latency_ms_count{stage=\"%s\"} %llu\n", st.name,
+           (unsigned long long) st.count);
+  }
+  return out;
+}
+
+static std::string json(const metrics_snapshot_t &s)
+{
+  std::string out;
+  append(out, "{\"uptime_s\": %.3f, \"frames\": %llu, \"fps\": %.2f, "
+         "\"eops\": %d, \"eop_utilization\": %.3f,\n", s.uptime_s,
+         (unsigned long long) s.frames, s.fps, s.num_eops, s.eop_utilization);
+  append(out, " \"capture\": {\"frames\": %llu, \"dropped\": %llu, "
+         "\"sequence_gaps\": %llu, \"starved\": %llu},\n",
+         (unsigned long long) s.captures,
+         (unsigned long long) s.dropped_frames,
+         (unsigned long long) s.sequence_gaps, (unsigned long long) s.starved);
+  append(out, " \"detections\": %llu, \"detections_per_s\": %.2f,\n",
+         (unsigned long long) s.detections, s.detections_per_s);
+  append(out, " \"memory\": {\"cmem_slab_used\": %llu, \"cmem_slab_size\": "
+         "%llu, \"cmem_exported\": %llu, \"display_buffers\": %llu},\n",
+         (unsigned long long) s.cmem_slab_used,
+         (unsigned long long) s.cmem_slab_size,
+         (unsigned long long) s.cmem_exported,
+         (unsigned long long) s.display_buffer_bytes);
+  out += " \"stages_ms\": {";
+  for (int i = 0; i < s.num_stages; i++) {
+    const metrics_stage_t &st = s.stage[i];
+    append(out, "%s\n  \"%s\": {\"count\": %llu, \"p50\": %.3f, \"p99\": "
+           "%.3f, \"max\": %.3f}", i ? "," : "", st.name,
+           (unsigned long long) st.count, st.p50_ms, st.p99_ms, st.max_ms);
+  }
+  out += "}}\n";
+  return out;
+}
+
+static void write_all(int fd, const std::string &data)
+{
+  size_t done = 0;
+  while (done < data.size()) {
+    ssize_t n = send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+    if (n <= 0)
+      return;
+    done += n;
+  }
+}
+
+/* The request decides the format: "json" anywhere in it for JSON, an HTTP
+ * request gets an HTTP response, no request at all Prometheus text
+ */
+static void serve(int fd)
+{
+  char req[512] = "";
+  struct pollfd pfd = {fd, POLLIN, 0};
+  if (poll(&pfd, 1, REQUEST_TIMEOUT_MS) > 0) {
+    ssize_t n = recv(fd, req, sizeof(req) - 1, 0);
+    req[n > 0 ? n : 0] = '\0';
+  }
+
+  metrics_snapshot_t s;
+  read_snapshot(s);
+  bool as_json = strstr(req, "json") != NULL;
+  std::string body = as_json ? json(s) : prometheus(s);
+  if (strncmp(req, "GET ", 4) == 0) {
+    char header[160];
+    snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: %s\r\n"
+             "Content-Length: %zu\r\n\r\n", as_json ? "application/json" :
+             "text/plain; version=0.0.4", body.size());
+    body = header + body;
+  }
+  write_all(fd, body);
+}
+
+static void server_loop()
+{
+  struct pollfd pfd[2] = {{listen_fd, POLLIN, 0}, {stop_pipe[0], POLLIN, 0}};
+  for (;;) {
+    if (poll(pfd, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      ERROR("metrics: poll failed: %s", strerror(errno));
+      return;
+    }
+    if (pfd[1].revents)
+      return;
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0)
+      continue;
+    serve(fd);
+    close(fd);
+  }
+}
+
+bool metrics_start(const std::string &path)
+{
+  struct sockaddr_un addr;
+
+  if (path.size() >= sizeof(addr.sun_path)) {
+    ERROR("metrics: socket path %s is too long", path.c_str());
+    return false;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+
+  // a socket left behind by an earlier run
+  unlink(path.c_str());
+  listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *) &addr,
+                            sizeof(addr)) < 0 ||
+      listen(listen_fd, 4) < 0 || pipe(stop_pipe) < 0) {
+    ERROR("metrics: could not listen on %s: %s", path.c_str(),
+          strerror(errno));
+    if (listen_fd >= 0)
+      close(listen_fd);
+    listen_fd = -1;
+    return false;
+  }
+  socket_path = path;
+  server = std::thread(server_loop);
+  MSG("Serving metrics on %s", path.c_str());
+  return true;
+}
+
+void metrics_stop()
+{
+  if (listen_fd < 0)
+    return;
+  if (write(stop_pipe[1], "", 1) < 0)
+    ERROR("metrics: could not stop the server: %s", strerror(errno));
+  server.join();
+  close(listen_fd);
+  close(stop_pipe[0]);
+  close(stop_pipe[1]);
+  listen_fd = -1;
+  unlink(socket_path.c_str());
+}
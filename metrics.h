@@ -0,0 +1,84 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <string>
+#include "perf_stats.h"
+
+/* Live metrics on a Unix domain socket. The frame loop publishes a snapshot
+ * now and then with metrics_publish(), which copies it under a sequence
+ * lock and never waits. A background thread answers every connection with
+ * the last snapshot and closes it:
+ *
+ *   socat - UNIX-CONNECT:/tmp/tidl.sock </dev/null      Prometheus text
+ *   echo json | socat - UNIX-CONNECT:/tmp/tidl.sock     JSON
+ *   curl --unix-socket /tmp/tidl.sock http://x/metrics  over HTTP, /json too
+ */
+#define METRICS_MAX_STAGES 8
+
+typedef struct metrics_stage_t_ {
+  char     name[24];
+  uint64_t count;
+  double   p50_ms;
+  double   p99_ms;
+  double   max_ms;
+} metrics_stage_t;
+
+typedef struct metrics_snapshot_t_ {
+  double   uptime_s;
+  uint64_t frames;
+  double   fps;
+  int      num_eops;
+  // share of the time the EOPs had a frame in flight, 0..1
+  double   eop_utilization;
+  uint64_t captures;
+  uint64_t dropped_frames;
+  uint64_t sequence_gaps;
+  uint64_t starved;
+  uint64_t detections;
+  double   detections_per_s;
+  uint64_t cmem_slab_used;
+  uint64_t cmem_slab_size;
+  uint64_t cmem_exported;
+  uint64_t display_buffer_bytes;
+  int      num_stages;
+  metrics_stage_t stage[METRICS_MAX_STAGES];
+} metrics_snapshot_t;
+
+// Serve the metrics on a socket at path until metrics_stop()
+bool metrics_start(const std::string &path);
+void metrics_stop();
+void metrics_publish(const metrics_snapshot_t &snap);
+// Percentiles of stats as the next stage of snap, left out once it is full
+void metrics_add_stage(metrics_snapshot_t &snap, const char *name,
+                       const LatencyStats &stats);
+
+#endif // METRICS_H
@@ -0,0 +1,109 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <algorithm>
+#include "nms.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NMS_USE_NEON
+#endif
+
+/* The candidates are kept as a structure of arrays so that the IoU of one
+ * kept box against four others is computed per NEON instruction.
+ */
+static float    nms_x0[NMS_MAX_BOXES];
+static float    nms_y0[NMS_MAX_BOXES];
+static float    nms_x1[NMS_MAX_BOXES];
+static float    nms_y1[NMS_MAX_BOXES];
+static float    nms_area[NMS_MAX_BOXES];
+static int32_t  nms_label[NMS_MAX_BOXES];
+static uint32_t nms_keep[NMS_MAX_BOXES];  // all ones while the box is kept
+
+int nms_boxes(det_box_t *boxes, int num, float iou_thresh)
+{
+  std::sort(boxes, boxes + num, [](const det_box_t &a, const det_box_t &b) {
+    return a.score > b.score;
+  });
+  int n = std::min(num, NMS_MAX_BOXES);
+
+  for (int i = 0; i < n; i++) {
+    nms_x0[i] = boxes[i].xmin;
+    nms_y0[i] = boxes[i].ymin;
+    nms_x1[i] = boxes[i].xmax;
+    nms_y1[i] = boxes[i].ymax;
+    nms_area[i] = (boxes[i].xmax - boxes[i].xmin) *
+                  (boxes[i].ymax - boxes[i].ymin);
+    nms_label[i] = boxes[i].label;
+    nms_keep[i] = ~0u;
+  }
+
+  // IoU > t  <=>  inter > t * (area_i + area_j - inter)
+  for (int i = 0; i < n; i++) {
+    if (!nms_keep[i]) continue;
+    int j = i + 1;
+
+#ifdef NMS_USE_NEON
+    float32x4_t bx0 = vdupq_n_f32(nms_x0[i]);
+    float32x4_t by0 = vdupq_n_f32(nms_y0[i]);
+    float32x4_t bx1 = vdupq_n_f32(nms_x1[i]);
+    float32x4_t by1 = vdupq_n_f32(nms_y1[i]);
+    float32x4_t barea = vdupq_n_f32(nms_area[i]);
+    float32x4_t thresh = vdupq_n_f32(iou_thresh);
+    float32x4_t zero = vdupq_n_f32(0);
+    int32x4_t blabel = vdupq_n_s32(nms_label[i]);
+    for (; j + 4 <= n; j += 4) {
+      float32x4_t w = vsubq_f32(vminq_f32(bx1, vld1q_f32(nms_x1 + j)),
+                                vmaxq_f32(bx0, vld1q_f32(nms_x0 + j)));
+      float32x4_t h = vsubq_f32(vminq_f32(by1, vld1q_f32(nms_y1 + j)),
+                                vmaxq_f32(by0, vld1q_f32(nms_y0 + j)));
+      float32x4_t inter = vmulq_f32(vmaxq_f32(w, zero), vmaxq_f32(h, zero));
+      float32x4_t uni = vsubq_f32(vaddq_f32(barea, vld1q_f32(nms_area + j)),
+                                  inter);
+      uint32x4_t over = vcgtq_f32(inter, vmulq_f32(thresh, uni));
+      uint32x4_t same = vceqq_s32(blabel, vld1q_s32(nms_label + j));
+      vst1q_u32(nms_keep + j, vbicq_u32(vld1q_u32(nms_keep + j),
+                                        vandq_u32(over, same)));
+    }
+#endif
+    for (; j < n; j++) {
+      if (nms_label[j] != nms_label[i]) continue;
+      float w = std::min(nms_x1[i], nms_x1[j]) - std::max(nms_x0[i], nms_x0[j]);
+      float h = std::min(nms_y1[i], nms_y1[j]) - std::max(nms_y0[i], nms_y0[j]);
+      float inter = std::max(w, 0.0f) * std::max(h, 0.0f);
+      if (inter > iou_thresh * (nms_area[i] + nms_area[j] - inter))
+        nms_keep[j] = 0;
+    }
+  }
+
+  int kept = 0;
+  for (int i = 0; i < n; i++)
+    if (nms_keep[i])
+      boxes[kept++] = boxes[i];
+  return kept;
+}
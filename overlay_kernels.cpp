@@ -0,0 +1,175 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include "overlay_kernels.h"
+#include "frame_id.h"
+
+using namespace cv;
+
+void SplitToPlanar(const void *bgrx, int w, int h, char *dst)
+{
+    Mat pic(h, w, CV_8UC4, (void *) bgrx);
+    int plane_size = w * h;
+    Mat planes[3] = {Mat(h, w, CV_8UC1, dst),
+                     Mat(h, w, CV_8UC1, dst + plane_size),
+                     Mat(h, w, CV_8UC1, dst + 2 * plane_size)};
+    const int from_to[] = {0, 0, 1, 1, 2, 2};
+    mixChannels(&pic, 1, planes, 3, from_to, 3);
+}
+
+void ColorizeSeg(const uint8_t *classes, int num, uint16_t *dst)
+{
+    for (int i = 0; i < num; i++) {
+      switch (classes[i]) {
+        case 0: // background class
+          dst[i] = classes[i];
+          break;
+        case 1: // road class
+          dst[i] = 0x00F0;
+          break;
+        case 2: // pedestrian class
+          dst[i] = 0x0F00;
+          break;
+        case 3: // road sign class
+          dst[i] = 0x000F;
+          break;
+        case 4: // vehicle class
+          dst[i] = 0x0FF0;
+          break;
+        default:
+          dst[i] = 0x0000;
+        }
+    }
+}
+
+int ParseSSDOutput(const float *out, int num_floats, float min_score,
+                   float w, float h, ssd_det_t *dets, int max)
+{
+    int num = 0;
+    for (int i = 0; i < num_floats / 7 && num < max; i++, out += 7) {
+      if ((int) out[0] < 0)
+        break;
+      if (out[2] < min_score)
+        continue;
+      dets[num++] = {(int) out[1], out[2], out[3] * w, out[4] * h,
+                     out[5] * w, out[6] * h};
+    }
+    return num;
+}
+
+void DrawBox(Mat &frame, const Scalar &color, const std::string &text,
+             int xmin, int ymin, int xmax, int ymax)
+{
+    int thickness = 1;
+    double scale = 0.6;
+    int baseline = 0;
+
+    Size text_size = getTextSize(text, FONT_HERSHEY_DUPLEX, scale,
+                                thickness, &baseline);
+    baseline += thickness;
+
+    int alpha = 255;
+    cv::rectangle(frame, Point(xmin, ymin), Point(xmax, ymax), color, 2);
+
+   // place the name of the class at the botton of the box
+   cv::rectangle(frame, Point(xmin,ymax) + Point(0, baseline),
+         Point(xmin,ymax) + Point(text_size.width,
+         -text_size.height) , Scalar(0,0,0,alpha), -1);
+   cv::putText(frame, text, Point(xmin,ymax),
+               FONT_HERSHEY_DUPLEX, scale, Scalar(255,255,255,alpha), thickness);
+}
+
+void OverlayFPS(Mat fps_screen, int width, int height, float fps,
+                double scale) {
+
+  // write the data in the bottom right corner of the screen
+  int thickness = 1;
+  int baseline = 0;
+
+  char fps_string[20];
+  sprintf(fps_string, "FPS: %.2f", fps);
+  Size text_size = getTextSize(fps_string, FONT_HERSHEY_DUPLEX, scale,
+                              thickness, &baseline);
+  baseline += thickness;
+  // place the name of the class at the botton of the box
+  if (fps_screen.channels() == 4) {
+    cv::rectangle(fps_screen, Point(width,height),
+      Point(width, height) - Point(text_size.width, text_size.height),
+      Scalar(0,0,0,255), -1);
+    cv::putText(fps_screen, fps_string, Point(width, height) -
+      Point(text_size.width, 0), FONT_HERSHEY_DUPLEX, scale,
+      Scalar(255,255,255,255), thickness);
+  }
+  else {
+    cv::rectangle(fps_screen, Point(width,height),
+      Point(width, height) - Point(text_size.width,
+      text_size.height+baseline), 0xF000, -1);
+    cv::putText(fps_screen, fps_string, Point(width, height) -
+      Point(text_size.width, 0), FONT_HERSHEY_DUPLEX, scale,
+      0xFFFF, thickness);
+  }
+
+}
+
+void DrawClassLabel(Mat &frame, const std::string &label, int line,
+                    double scale)
+{
+    int thickness = 1;
+    int baseline = 0;
+    int alpha = 255;
+
+    Size text_size = getTextSize(label, FONT_HERSHEY_DUPLEX, scale,
+                                 thickness, &baseline);
+    baseline += thickness;
+    int bottom = frame.rows - line * (text_size.height + baseline);
+    cv::rectangle(frame, Point(0, bottom),
+                  Point(text_size.width, bottom - text_size.height - baseline),
+                  Scalar(0, 0, 0, alpha), -1);
+    cv::putText(frame, label, Point(0, bottom - baseline),
+                FONT_HERSHEY_DUPLEX, scale, Scalar(255, 255, 255, alpha),
+                thickness);
+}
+
+void DrawFrameId(Mat &frame, uint16_t id)
+{
+  int x, y, cell;
+  uint8_t cells[FRAME_ID_CELLS];
+  bool bgra = frame.channels() == 4;
+  Scalar white = bgra ? Scalar(255,255,255,255) : Scalar(0xFFFF);
+  Scalar black = bgra ? Scalar(0,0,0,255) : Scalar(0xF000);
+
+  frame_id_layout(frame.cols, frame.rows, &x, &y, &cell);
+  frame_id_encode(id, cells);
+  cv::rectangle(frame, Point(x - cell, y - cell),
+    Point(x + (FRAME_ID_CELLS + 1) * cell - 1, y + 2 * cell - 1), black, -1);
+  for (int i = 0; i < FRAME_ID_CELLS; i++)
+    if (cells[i])
+      cv::rectangle(frame, Point(x + i * cell, y),
+        Point(x + (i + 1) * cell - 1, y + cell - 1), white, -1);
+}
@@ -0,0 +1,88 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef OVERLAY_KERNELS_H
+#define OVERLAY_KERNELS_H
+
+#include <stdint.h>
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+/* CPU kernels of the frame loop that prepare the network input, decode its
+ * output and draw the overlays, shared with bench/kernel_bench and
+ * bench/replay_bench.
+ */
+
+// One record of the SSD output, corners in pixels of the network input
+typedef struct ssd_det_t_ {
+  int   label;
+  float score;
+  float xmin, ymin, xmax, ymax;
+} ssd_det_t;
+
+/* Planes B, G and R of the w x h BGRx image straight into the TIDL input at
+ * dst, without the intermediate planes of a split()
+ */
+void SplitToPlanar(const void *bgrx, int w, int h, char *dst);
+
+/* Segmentation classes to the 0bXXXXRRRRGGGGBBBB colors of the overlay,
+ * num pixels
+ */
+void ColorizeSeg(const uint8_t *classes, int num, uint16_t *dst);
+
+/* The records of the SSD output (7 floats each: image, label, score and the
+ * corners relative to the input) up to the first one of a negative image,
+ * that score at least min_score, with the corners scaled to w x h. At most
+ * max of them go into dets, returns how many.
+ */
+int ParseSSDOutput(const float *out, int num_floats, float min_score,
+                   float w, float h, ssd_det_t *dets, int max);
+
+// Box in color with text on a black background at its bottom
+void DrawBox(cv::Mat &frame, const cv::Scalar &color, const std::string &text,
+             int xmin, int ymin, int xmax, int ymax);
+
+/* Overlay the fps onto the bottom right corner of the width x height
+ * fps_screen (BGRA or 16 bit), scale is essentially the size of the text
+ */
+void OverlayFPS(cv::Mat fps_screen, int width, int height, float fps,
+                double scale);
+
+/* Name of a class on a black background at the left edge of the BGRA frame,
+ * line 0 at the bottom and the others above it
+ */
+void DrawClassLabel(cv::Mat &frame, const std::string &label, int line,
+                    double scale);
+
+/* The frame ID code of frame_id.h for id into the bottom left corner of the
+ * frame (BGRA or 16 bit)
+ */
+void DrawFrameId(cv::Mat &frame, uint16_t id);
+
+#endif // OVERLAY_KERNELS_H
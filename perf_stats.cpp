@@ -0,0 +1,106 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "perf_stats.h"
+#include "error.h"
+
+#define FINE_BINS   1000  // 0.1 ms up to 100 ms
+#define COARSE_BINS 1900  // 1 ms up to 2000 ms
+#define NUM_BINS    (FINE_BINS + COARSE_BINS + 1)
+
+LatencyStats::LatencyStats() : m_bins(NUM_BINS, 0) {
+  reset();
+}
+
+void LatencyStats::reset() {
+  std::fill(m_bins.begin(), m_bins.end(), 0);
+  m_count = 0;
+  m_sum = 0;
+  m_min = 0;
+  m_max = 0;
+}
+
+int LatencyStats::bin(double ms) {
+  if (ms < 0) ms = 0;
+  if (ms < 100) return (int) (ms * 10);
+  if (ms < 2000) return FINE_BINS + (int) (ms - 100);
+  return NUM_BINS - 1;
+}
+
+// upper edge of the bin, so percentiles never under-report
+double LatencyStats::bin_value(int b) {
+  if (b < FINE_BINS) return (b + 1) * 0.1;
+  if (b < FINE_BINS + COARSE_BINS) return 100 + (b - FINE_BINS + 1);
+  return INFINITY;
+}
+
+void LatencyStats::add(double ms) {
+  m_bins[bin(ms)]++;
+  if (!m_count || ms < m_min) m_min = ms;
+  if (ms > m_max) m_max = ms;
+  m_sum += ms;
+  m_count++;
+}
+
+double LatencyStats::percentile(double p) const {
+  if (!m_count) return 0;
+  uint64_t rank = (uint64_t) ceil(p / 100 * m_count);
+  if (rank == 0) rank = 1;
+  uint64_t seen = 0;
+  for (int b = 0; b < NUM_BINS; b++) {
+    seen += m_bins[b];
+    if (seen >= rank) {
+      double v = bin_value(b);
+      return v < m_max ? v : m_max;
+    }
+  }
+  return m_max;
+}
+
+void LatencyStats::report(const char *name) const {
+  MSG("%-24s n=%-6llu mean %7.2f  p50 %7.2f  p99 %7.2f  max %7.2f ms", name,
+      (unsigned long long) m_count, mean(), percentile(50), percentile(99),
+      max());
+}
+
+bool LatencyStats::write_csv(const char *path) const {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    ERROR("Could not open %s: %s", path, strerror(errno));
+    return false;
+  }
+  fprintf(f, "upper_ms,count\n");
+  for (int b = 0; b < NUM_BINS; b++)
+    if (m_bins[b])
+      fprintf(f, "%g,%u\n", bin_value(b), m_bins[b]);
+  return fclose(f) == 0;
+}
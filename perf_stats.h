@@ -0,0 +1,63 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+#include <stdint.h>
+#include <vector>
+
+/* Latency histogram with 0.1 ms bins up to 100 ms and 1 ms bins up to 2 s,
+ * anything slower lands in the last bin. The bins are allocated by the
+ * constructor, add() never allocates and is cheap enough for the frame loop.
+ */
+class LatencyStats {
+public:
+  LatencyStats();
+  void add(double ms);
+  void reset();
+  uint64_t count() const { return m_count; }
+  double mean() const { return m_count ? m_sum / m_count : 0; }
+  double min() const { return m_count ? m_min : 0; }
+  double max() const { return m_max; }
+  double percentile(double p) const;
+  void report(const char *name) const;
+  // "upper_ms,count" of every bin that is not empty
+  bool write_csv(const char *path) const;
+
+private:
+  static int bin(double ms);
+  static double bin_value(int b);
+  std::vector<uint32_t> m_bins;
+  uint64_t m_count;
+  double m_sum;
+  double m_min;
+  double m_max;
+};
+
+#endif // PERF_STATS_H
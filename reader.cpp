@@ -36,11 +36,25 @@ using namespace cv;
 using namespace std;
 
 int IMAGE_CLASSES_NUM = 0;
-#define MAX_CLASSES 10
+#define MAX_CLASSES 1001
 #define MAX_SELECTED_ITEMS 10
 std::string labels_classes[MAX_CLASSES];
 int selected_items_size = 0;
 int selected_items[MAX_SELECTED_ITEMS];
+Rect rect_crop[MAX_NUM_ROI];
+
+
+/* Lay the NUM_ROI_X x NUM_ROI_Y grid of regions out on the RES_X x RES_Y
+ * image, row by row
+ */
+void setup_rect_crop()
+{
+  for (int y = 0; y < NUM_ROI_Y; y++)
+    for (int x = 0; x < NUM_ROI_X; x++)
+      rect_crop[y * NUM_ROI_X + x] = Rect(X_OFFSET + x * X_STEP,
+                                          Y_OFFSET + y * Y_STEP,
+                                          X_STEP, Y_STEP);
+}
 
 
 static int get_classindex(std::string str2find)
@@ -97,7 +111,7 @@ void populate_labels(const char *filename)
   {
     string inputLine;
 
-    while (getline(file, inputLine) )                 //while the end of file is NOT reached
+    while (getline(file, inputLine) && IMAGE_CLASSES_NUM < MAX_CLASSES)
     {
       labels_classes[IMAGE_CLASSES_NUM ++] = string(inputLine);
     }
@@ -28,7 +28,19 @@
 
 #define MAX_NUM_ROI 4
 
-#ifdef TWO_ROIs
+/* The ROI grid is laid out on a RES_X x RES_Y image and scaled to the
+ * capture resolution by the user of rect_crop[]
+ */
+#if defined(FOUR_ROIs)
+#define RES_X 480
+#define RES_Y 480
+#define NUM_ROI_X 2
+#define NUM_ROI_Y 2
+#define X_OFFSET 16
+#define X_STEP   224
+#define Y_OFFSET 16
+#define Y_STEP   224
+#elif defined(TWO_ROIs)
 #define RES_X 400
 #define RES_Y 300
 #define NUM_ROI_X 2
@@ -0,0 +1,265 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "results_ring.h"
+#include "error.h"
+
+#define ALIGN_UP(x, a) (((x) + (a) - 1) / (a) * (a))
+
+static uint64_t load_acquire(const uint64_t *p)
+{
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void store_release(uint64_t *p, uint64_t v)
+{
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static uint64_t now_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool ResultsWriter::open(const std::string &name, uint32_t num_records,
+                         uint32_t mask_size)
+{
+  close();
+  uint64_t records = ALIGN_UP(sizeof(results_ring_header_t), 64);
+  uint64_t masks = records + (uint64_t) num_records * sizeof(results_record_t);
+  masks = ALIGN_UP(masks, 64);
+  mask_size = ALIGN_UP(mask_size, 64);
+  size_t bytes = masks + (uint64_t) num_records * mask_size;
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, bytes) < 0) {
+    ERROR("Could not create the shared memory %s: %s", name.c_str(),
+          strerror(errno));
+    if (fd >= 0) {
+      ::close(fd);
+      shm_unlink(name.c_str());
+    }
+    return false;
+  }
+  void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    ERROR("Could not map the shared memory %s: %s", name.c_str(),
+          strerror(errno));
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  // ftruncate zeroed it, so every seq is 0 and no record is complete
+  hdr = (results_ring_header_t *) p;
+  size = bytes;
+  shm_name = name;
+  hdr->header_size = sizeof(results_ring_header_t);
+  hdr->record_size = sizeof(results_record_t);
+  hdr->num_records = num_records;
+  hdr->mask_size = mask_size;
+  hdr->records_offset = records;
+  hdr->masks_offset = masks;
+  hdr->writer_pid = getpid();
+  // readers take the ring for complete once the magic is there
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(hdr->magic, RESULTS_RING_MAGIC, sizeof(hdr->magic));
+  MSG("Writing the results to the shared memory %s, %u records", name.c_str(),
+      num_records);
+  return true;
+}
+
+void ResultsWriter::begin(uint32_t frame_id, uint32_t capture_sequence,
+                          uint64_t capture_us, results_type_t type)
+{
+  if (!hdr)
+    return;
+  uint64_t n = hdr->head;
+  cur = (results_record_t *) ((uint8_t *) hdr + hdr->records_offset) +
+        n % hdr->num_records;
+  store_release(&cur->seq, 2 * n + 1);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  cur->record = n;
+  cur->frame_id = frame_id;
+  cur->capture_sequence = capture_sequence;
+  cur->capture_us = capture_us;
+  cur->type = type;
+  cur->num_boxes = 0;
+  cur->mask_width = 0;
+  cur->mask_height = 0;
+  cur->mask_offset = 0;
+}
+
+void ResultsWriter::add_box(int label, float score, float xmin, float ymin,
+                            float xmax, float ymax)
+{
+  if (!cur || cur->num_boxes == RESULTS_MAX_BOXES)
+    return;
+  results_box_t &b = cur->boxes[cur->num_boxes++];
+  b.label = label;
+  b.score = score;
+  b.xmin = xmin;
+  b.ymin = ymin;
+  b.xmax = xmax;
+  b.ymax = ymax;
+}
+
+void ResultsWriter::set_mask(const uint8_t *classes, uint32_t width,
+                             uint32_t height)
+{
+  if (!cur || (uint64_t) width * height > hdr->mask_size)
+    return;
+  uint64_t offset = hdr->masks_offset +
+                    (uint64_t) (cur->record % hdr->num_records) * hdr->mask_size;
+  memcpy((uint8_t *) hdr + offset, classes, width * height);
+  cur->mask_width = width;
+  cur->mask_height = height;
+  cur->mask_offset = offset;
+}
+
+void ResultsWriter::commit()
+{
+  if (!cur)
+    return;
+  uint64_t n = cur->record;
+  cur->result_us = now_us();
+  store_release(&cur->seq, 2 * n + 2);
+  store_release(&hdr->head, n + 1);
+  cur = NULL;
+}
+
+void ResultsWriter::close()
+{
+  if (!hdr)
+    return;
+  munmap(hdr, size);
+  shm_unlink(shm_name.c_str());
+  hdr = NULL;
+  cur = NULL;
+}
+
+bool ResultsReader::open(const std::string &name)
+{
+  struct stat st;
+
+  close();
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    ERROR("Could not open the shared memory %s: %s", name.c_str(),
+          strerror(errno));
+    if (fd >= 0)
+      ::close(fd);
+    return false;
+  }
+  void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    ERROR("Could not map the shared memory %s: %s", name.c_str(),
+          strerror(errno));
+    return false;
+  }
+  hdr = (const results_ring_header_t *) p;
+  size = st.st_size;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if ((size_t) st.st_size < sizeof(*hdr) ||
+      memcmp(hdr->magic, RESULTS_RING_MAGIC, sizeof(hdr->magic)) != 0 ||
+      hdr->record_size != sizeof(results_record_t) ||
+      hdr->masks_offset + (uint64_t) hdr->num_records * hdr->mask_size > size) {
+    ERROR("%s is not a results ring of this version", name.c_str());
+    close();
+    return false;
+  }
+  next = load_acquire(&hdr->head);
+  lost = 0;
+  return true;
+}
+
+bool ResultsReader::read(results_record_t &rec)
+{
+  if (!hdr)
+    return false;
+  const results_record_t *records = (const results_record_t *)
+    ((const uint8_t *) hdr + hdr->records_offset);
+  for (;;) {
+    uint64_t head = load_acquire(&hdr->head);
+    if (next >= head)
+      return false;
+    // the writer is a full lap ahead, these are gone
+    if (head - next > hdr->num_records) {
+      lost += head - hdr->num_records - next;
+      next = head - hdr->num_records;
+    }
+    const results_record_t *r = &records[next % hdr->num_records];
+    uint64_t seq = load_acquire(&r->seq);
+    if (seq == 2 * next + 2) {
+      memcpy(&rec, r, sizeof(rec));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&r->seq, __ATOMIC_RELAXED) == seq) {
+        next++;
+        return true;
+      }
+    }
+    // overwritten while or before it was copied
+    lost++;
+    next++;
+  }
+}
+
+const uint8_t *ResultsReader::mask(const results_record_t &rec) const
+{
+  if (!hdr || !rec.mask_offset ||
+      rec.mask_offset + (uint64_t) rec.mask_width * rec.mask_height > size)
+    return NULL;
+  return (const uint8_t *) hdr + rec.mask_offset;
+}
+
+bool ResultsReader::still_valid(const results_record_t &rec) const
+{
+  if (!hdr)
+    return false;
+  const results_record_t *records = (const results_record_t *)
+    ((const uint8_t *) hdr + hdr->records_offset);
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return load_acquire(&records[rec.record % hdr->num_records].seq) ==
+         2 * rec.record + 2;
+}
+
+void ResultsReader::close()
+{
+  if (hdr)
+    munmap((void *) hdr, size);
+  hdr = NULL;
+}
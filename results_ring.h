@@ -0,0 +1,150 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef RESULTS_RING_H
+#define RESULTS_RING_H
+
+#include <stdint.h>
+#include <string>
+
+/* Results of the networks for other processes, in a POSIX shared memory
+ * ring that the frame loop writes (--results-shm <name>) and any number of
+ * ResultsReaders read. The layout is fixed: the header, num_records records
+ * and, for segmentation, a mask slot per record that holds the class of
+ * every pixel of the network output.
+ *
+ * There is one writer and no lock. Record n goes into slot n % num_records,
+ * its seq is 2n + 1 while it is written and 2n + 2 once it is complete, and
+ * head counts the complete records. A reader copies a record and checks seq
+ * before and after, so it sees when the writer lapped it. Readers only map
+ * the memory, there is no system call per record.
+ */
+#define RESULTS_RING_MAGIC  "ATRES01"
+#define RESULTS_MAX_BOXES   64
+
+enum results_type_t {
+  RESULTS_SSD = 1,    // boxes with label and score
+  RESULTS_SEG = 2,    // the class mask
+  RESULTS_CLASS = 3,  // the best classes as boxes over the whole frame
+};
+
+// corners relative to the capture, 0..1
+typedef struct results_box_t_ {
+  int32_t label;
+  float   score;
+  float   xmin, ymin, xmax, ymax;
+} results_box_t;
+
+typedef struct results_record_t_ {
+  uint64_t seq;
+  uint64_t record;
+  uint32_t frame_id;          // frame index of the EOP
+  uint32_t capture_sequence;  // V4L2 sequence of the capture
+  uint64_t capture_us;        // V4L2 timestamp, CLOCK_MONOTONIC
+  uint64_t result_us;         // when the record was written, CLOCK_MONOTONIC
+  uint32_t type;
+  uint32_t num_boxes;
+  // mask_offset from the start of the shared memory, 0 without a mask
+  uint32_t mask_width;
+  uint32_t mask_height;
+  uint64_t mask_offset;
+  results_box_t boxes[RESULTS_MAX_BOXES];
+} results_record_t;
+
+typedef struct results_ring_header_t_ {
+  char     magic[8];
+  uint32_t header_size;
+  uint32_t record_size;
+  uint32_t num_records;
+  uint32_t mask_size;    // bytes of a mask slot, 0 if there are none
+  uint64_t records_offset;
+  uint64_t masks_offset;
+  uint64_t head;
+  uint32_t writer_pid;
+  uint32_t reserved;
+} results_ring_header_t;
+
+class ResultsWriter {
+public:
+  ResultsWriter() : hdr(NULL), size(0), cur(NULL) {}
+  ~ResultsWriter() { close(); }
+  ResultsWriter(const ResultsWriter &) = delete;
+  ResultsWriter &operator=(const ResultsWriter &) = delete;
+
+  // name as for shm_open, "/tidl_results"
+  bool open(const std::string &name, uint32_t num_records, uint32_t mask_size);
+  bool is_open() const { return hdr != NULL; }
+  // The record of one frame goes straight into its slot
+  void begin(uint32_t frame_id, uint32_t capture_sequence, uint64_t capture_us,
+             results_type_t type);
+  bool in_record() const { return cur != NULL; }
+  void add_box(int label, float score, float xmin, float ymin, float xmax,
+               float ymax);
+  // left out when larger than a mask slot
+  void set_mask(const uint8_t *classes, uint32_t width, uint32_t height);
+  void commit();
+  // unmaps and removes the shared memory
+  void close();
+
+private:
+  results_ring_header_t *hdr;
+  size_t size;
+  std::string shm_name;
+  results_record_t *cur;
+};
+
+class ResultsReader {
+public:
+  ResultsReader() : hdr(NULL), size(0), next(0), lost(0) {}
+  ~ResultsReader() { close(); }
+  ResultsReader(const ResultsReader &) = delete;
+  ResultsReader &operator=(const ResultsReader &) = delete;
+
+  // From the next record that is written on
+  bool open(const std::string &name);
+  /* The oldest record not read yet into rec, false if there is none. The
+   * records the writer overwrote before they were read are counted in
+   * num_lost().
+   */
+  bool read(results_record_t &rec);
+  /* The mask of rec in the shared memory, NULL if it has none. It is only
+   * valid as long as still_valid(rec).
+   */
+  const uint8_t *mask(const results_record_t &rec) const;
+  bool still_valid(const results_record_t &rec) const;
+  uint64_t num_lost() const { return lost; }
+  void close();
+
+private:
+  const results_ring_header_t *hdr;
+  size_t size;
+  uint64_t next;
+  uint64_t lost;
+};
+
+#endif // RESULTS_RING_H
@@ -0,0 +1,133 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <math.h>
+#include <algorithm>
+#include "temporal_vote.h"
+#include "error.h"
+
+TemporalVote::TemporalVote() {
+  m_num_roi = 0;
+  m_window = 0;
+  m_max_candidates = 0;
+  m_num_classes = 0;
+  m_threshold = 1;
+  m_norm = 1;
+}
+
+bool TemporalVote::init(int num_roi, int window, int max_candidates,
+                        int num_classes, float decay, float threshold) {
+  if (num_roi <= 0 || window <= 0 || max_candidates <= 0 || num_classes <= 0) {
+    ERROR("Invalid temporal vote size: %d ROIs, window %d, %d candidates, " \
+          "%d classes", num_roi, window, max_candidates, num_classes);
+    return false;
+  }
+  if (decay <= 0 || decay > 1) {
+    ERROR("Temporal vote decay must be in (0, 1], got %f", decay);
+    return false;
+  }
+
+  m_num_roi = num_roi;
+  m_window = window;
+  m_max_candidates = max_candidates;
+  m_num_classes = num_classes;
+  m_threshold = threshold;
+
+  m_seq.assign(num_roi * window, 0);
+  m_num.assign(num_roi * window, 0);
+  m_ids.assign(num_roi * window * max_candidates, -1);
+  m_probs.assign(num_roi * window * max_candidates, 0);
+  m_head.assign(num_roi, 0);
+  m_class_score.assign(num_classes, 0);
+
+  m_decay_pow.resize(window);
+  m_norm = 0;
+  for (int a = 0; a < window; a++) {
+    m_decay_pow[a] = powf(decay, a);
+    m_norm += m_decay_pow[a];
+  }
+
+  MSG("Temporal vote: %d ROIs, window %d, decay %.2f, threshold %.2f",
+      num_roi, window, decay, threshold);
+  return true;
+}
+
+/* Record the candidates of the observation with sequence number seq */
+void TemporalVote::update(int roi, uint32_t seq, const int *ids,
+                          const float *probs, int num) {
+  if (roi < 0 || roi >= m_num_roi) return;
+
+  int slot = roi * m_window + m_head[roi];
+  m_head[roi] = (m_head[roi] + 1) % m_window;
+
+  num = std::min(num, m_max_candidates);
+  m_seq[slot] = seq;
+  m_num[slot] = num;
+  for (int i = 0; i < num; i++) {
+    m_ids[slot * m_max_candidates + i] = ids[i];
+    m_probs[slot * m_max_candidates + i] = probs[i];
+  }
+}
+
+/* Return the class with the highest decayed score at sequence number seq if
+ * it reaches the threshold, -1 otherwise.
+ */
+int TemporalVote::decide(int roi, uint32_t seq, float *score) {
+  if (roi < 0 || roi >= m_num_roi) return -1;
+
+  int best_id = -1;
+  float best = 0;
+  int first = roi * m_window;
+
+  for (int s = first; s < first + m_window; s++) {
+    uint32_t age = seq - m_seq[s];
+    if (!m_num[s] || age >= (uint32_t) m_window) continue;
+    for (int i = 0; i < m_num[s]; i++) {
+      int id = m_ids[s * m_max_candidates + i];
+      if (id < 0 || id >= m_num_classes) continue;
+      m_class_score[id] += m_decay_pow[age] * m_probs[s * m_max_candidates + i];
+    }
+  }
+
+  // read back the touched classes and leave the accumulator cleared
+  for (int s = first; s < first + m_window; s++) {
+    for (int i = 0; i < m_num[s]; i++) {
+      int id = m_ids[s * m_max_candidates + i];
+      if (id < 0 || id >= m_num_classes) continue;
+      if (m_class_score[id] > best) {
+        best = m_class_score[id];
+        best_id = id;
+      }
+      m_class_score[id] = 0;
+    }
+  }
+
+  best /= m_norm;
+  if (score) *score = best;
+  return (best >= m_threshold) ? best_id : -1;
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef TEMPORAL_VOTE_H
+#define TEMPORAL_VOTE_H
+
+#include <stdint.h>
+#include <vector>
+
+/* Temporal filter for classification results. Every ROI keeps a ring of the
+ * candidates (class id + probability) reported for its last N observations.
+ * A class is shown when its exponentially decayed score over that window
+ * reaches the threshold:
+ *
+ *   score(c) = sum(decay^age * p_age(c)) / sum(decay^age), age = 0..N-1
+ *
+ * so a class reported with probability p in every frame scores p. Entries are
+ * aged by their sequence number, not by ring position, so observations that
+ * were skipped simply do not contribute. All storage is sized by init().
+ */
+class TemporalVote {
+public:
+  TemporalVote();
+  bool init(int num_roi, int window, int max_candidates, int num_classes,
+            float decay, float threshold);
+  void update(int roi, uint32_t seq, const int *ids, const float *probs,
+              int num);
+  int decide(int roi, uint32_t seq, float *score = nullptr);
+
+private:
+  int m_num_roi;
+  int m_window;
+  int m_max_candidates;
+  int m_num_classes;
+  float m_threshold;
+  float m_norm;
+
+  // [roi][slot] and [roi][slot][candidate]
+  std::vector<uint32_t> m_seq;
+  std::vector<int> m_num;
+  std::vector<int> m_ids;
+  std::vector<float> m_probs;
+  std::vector<int> m_head;
+  std::vector<float> m_decay_pow;
+  // per-class accumulator used by decide(), all zero between calls
+  std::vector<float> m_class_score;
+};
+
+#endif // TEMPORAL_VOTE_H
@@ -0,0 +1,123 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include "error.h"
+#include "tiling.h"
+
+using namespace std::chrono;
+
+bool tile_layout(int cap_w, int cap_h, int cols, int rows, float overlap,
+                 v4l2_rect *rects)
+{
+  if (cols <= 0 || rows <= 0 || overlap < 0 || overlap >= 1) {
+    ERROR("Invalid tile layout %dx%d with overlap %f", cols, rows, overlap);
+    return false;
+  }
+
+  // n tiles of size t with overlap o cover t * (n - (n - 1) * o)
+  float tile_w = cap_w / (cols - (cols - 1) * overlap);
+  float tile_h = cap_h / (rows - (rows - 1) * overlap);
+  for (int r = 0; r < rows; r++) {
+    for (int c = 0; c < cols; c++) {
+      v4l2_rect &t = rects[r * cols + c];
+      t.left = lroundf(c * tile_w * (1 - overlap));
+      t.top = lroundf(r * tile_h * (1 - overlap));
+      t.width = std::min(cap_w - (int) t.left, (int) lroundf(tile_w));
+      t.height = std::min(cap_h - (int) t.top, (int) lroundf(tile_h));
+    }
+  }
+  return true;
+}
+
+TileMerger::TileMerger() : num_dets(0), cap_w(0), cap_h(0), iou_thresh(0.45),
+  num_merged(0), num_kept(0) {}
+
+bool TileMerger::init(const v4l2_rect *_rects, int num, int _cap_w,
+                      int _cap_h, float _iou_thresh)
+{
+  rects.assign(_rects, _rects + num);
+  dets.resize(NMS_MAX_BOXES);
+  tile_latency.resize(num);
+  num_dets = 0;
+  cap_w = _cap_w;
+  cap_h = _cap_h;
+  iou_thresh = _iou_thresh;
+  return true;
+}
+
+void TileMerger::add(const v4l2_rect &t, float xmin, float ymin, float xmax,
+                     float ymax, float score, int label)
+{
+  if (num_dets >= NMS_MAX_BOXES)
+    return;
+  det_box_t &d = dets[num_dets++];
+  d.xmin = t.left + xmin * t.width;
+  d.ymin = t.top + ymin * t.height;
+  d.xmax = t.left + xmax * t.width;
+  d.ymax = t.top + ymax * t.height;
+  d.score = score;
+  d.label = label;
+}
+
+/* Merge the detections of the capture, returns the number of boxes kept.
+ * The next add() starts the next capture.
+ */
+int TileMerger::merge()
+{
+  auto start = steady_clock::now();
+  int kept = nms_boxes(dets.data(), num_dets, iou_thresh);
+  merge_latency.add(duration<double, std::milli>(steady_clock::now() -
+                                                 start).count());
+  num_merged += num_dets;
+  num_kept += kept;
+  num_dets = 0;
+  return kept;
+}
+
+void TileMerger::add_tile_time(int tile, double ms)
+{
+  tile_latency[tile].add(ms);
+}
+
+void TileMerger::report() const
+{
+  MSG("Tiled detection, %d tiles:", num_tiles());
+  for (int t = 0; t < num_tiles(); t++) {
+    char name[64];
+    snprintf(name, sizeof(name), "tile %d (%dx%d at %d,%d)", t,
+             rects[t].width, rects[t].height, rects[t].left, rects[t].top);
+    tile_latency[t].report(name);
+  }
+  merge_latency.report("cross-tile NMS");
+  MSG("%llu boxes merged into %llu", (unsigned long long) num_merged,
+      (unsigned long long) num_kept);
+}
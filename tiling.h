@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef TILING_H
+#define TILING_H
+
+#include <stdint.h>
+#include <vector>
+#include <linux/videodev2.h>
+#include "nms.h"
+#include "perf_stats.h"
+
+/* Fill rects with cols x rows tiles that cover a cap_w x cap_h capture.
+ * Neighbouring tiles overlap by the fraction overlap (0 <= overlap < 1) of
+ * the tile size, so that objects on a tile border are seen whole by one of
+ * them.
+ */
+bool tile_layout(int cap_w, int cap_h, int cols, int rows, float overlap,
+                 v4l2_rect *rects);
+
+/* Collects the detections of the tiles of one capture in capture
+ * coordinates. Once the last tile is in, merge() runs a class-aware NMS over
+ * all of them. The detection buffer is sized by init, add() and merge() do
+ * not allocate.
+ */
+class TileMerger {
+public:
+  TileMerger();
+  bool init(const v4l2_rect *rects, int num_tiles, int cap_w, int cap_h,
+            float iou_thresh);
+  int num_tiles() const { return (int) rects.size(); }
+  int cap_width() const { return cap_w; }
+  int cap_height() const { return cap_h; }
+  const v4l2_rect &rect(int tile) const { return rects[tile]; }
+  // box in coordinates normalized to src, as reported by the SSD
+  void add(const v4l2_rect &src, float xmin, float ymin, float xmax,
+           float ymax, float score, int label);
+  int merge();
+  const det_box_t *boxes() const { return dets.data(); }
+  void add_tile_time(int tile, double ms);
+  void report() const;
+
+private:
+  std::vector<v4l2_rect> rects;
+  std::vector<det_box_t> dets;
+  int num_dets;
+  int cap_w, cap_h;
+  float iou_thresh;
+  std::vector<LatencyStats> tile_latency;
+  LatencyStats merge_latency;
+  uint64_t num_merged, num_kept;
+};
+
+#endif // TILING_H
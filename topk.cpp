@@ -0,0 +1,137 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <math.h>
+#include "topk.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TOPK_USE_NEON
+#endif
+
+/* Insert (v, i) into the sorted candidate list of length n (n < TOPK_MAX).
+ * Equal values keep their order, so earlier indices stay ahead.
+ */
+static inline void topk_insert(topk_result_t *res, int n, uint8_t v, int i)
+{
+  int pos = n;
+  while (pos > 0 && res->val[pos - 1] < v) {
+    res->val[pos] = res->val[pos - 1];
+    res->idx[pos] = res->idx[pos - 1];
+    pos--;
+  }
+  res->val[pos] = v;
+  res->idx[pos] = i;
+}
+
+/* Replace the current k-th candidate if v is strictly larger than it */
+static inline void topk_replace(topk_result_t *res, int k, uint8_t v, int i)
+{
+  if (v > res->val[k - 1])
+    topk_insert(res, k - 1, v, i);
+}
+
+int topk_u8(const uint8_t *in, int size, int k, topk_result_t *res)
+{
+  if (k > TOPK_MAX) k = TOPK_MAX;
+  if (k > size) k = size;
+  res->k = k;
+  if (k <= 0) return 0;
+
+  // seed the list with the first k values
+  for (int i = 0; i < k; i++)
+    topk_insert(res, i, in[i], i);
+
+  int i = k;
+#ifdef TOPK_USE_NEON
+  /* Most blocks of 16 cannot contain anything larger than the current k-th
+   * value. A horizontal max of the block rejects those without touching the
+   * candidate list, only blocks that pass go through the scalar insert.
+   */
+  for (; i + 16 <= size; i += 16) {
+    uint8x16_t v = vld1q_u8(in + i);
+    uint8x8_t m = vmax_u8(vget_low_u8(v), vget_high_u8(v));
+    m = vpmax_u8(m, m);
+    m = vpmax_u8(m, m);
+    m = vpmax_u8(m, m);
+    if (vget_lane_u8(m, 0) <= res->val[k - 1])
+      continue;
+    for (int j = i; j < i + 16; j++)
+      topk_replace(res, k, in[j], j);
+  }
+#else
+  for (; i + 16 <= size; i += 16) {
+    uint8_t m = in[i];
+    for (int j = i + 1; j < i + 16; j++)
+      m = in[j] > m ? in[j] : m;
+    if (m <= res->val[k - 1])
+      continue;
+    for (int j = i; j < i + 16; j++)
+      topk_replace(res, k, in[j], j);
+  }
+#endif
+  for (; i < size; i++)
+    topk_replace(res, k, in[i], i);
+
+  return k;
+}
+
+
+/* exp(-scale * d) for every possible distance d to the maximum value. Working
+ * relative to the maximum keeps every term in (0, 1] so the sum cannot
+ * overflow, whatever the scale.
+ */
+static float softmax_lut[256];
+
+void topk_softmax_init(float scale)
+{
+  for (int d = 0; d < 256; d++)
+    softmax_lut[d] = expf(-scale * d);
+}
+
+float topk_softmax_denom(const uint8_t *in, int size, uint8_t max_val)
+{
+  /* A histogram of the values turns the sum of size LUT lookups into 256
+   * multiply-adds, and the histogram loop itself has no float dependency
+   * chain.
+   */
+  uint32_t hist[256] = {0};
+  for (int i = 0; i < size; i++)
+    hist[in[i]]++;
+
+  float denom = 0;
+  for (int q = 0; q <= max_val; q++)
+    if (hist[q])
+      denom += hist[q] * softmax_lut[max_val - q];
+  return denom;
+}
+
+float topk_softmax_prob(uint8_t q, uint8_t max_val, float denom)
+{
+  return softmax_lut[max_val - q] / denom;
+}
@@ -0,0 +1,61 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <stdint.h>
+
+/* Largest k that topk_u8 supports. The candidates are kept in a fixed-size
+ * array that is insertion sorted, so this needs to stay small.
+ */
+#define TOPK_MAX 8
+
+typedef struct topk_result_t_ {
+  int     k;
+  uint8_t val[TOPK_MAX];  // largest value first
+  int     idx[TOPK_MAX];
+} topk_result_t;
+
+/* Find the k largest values of a uint8 TIDL output. No memory is allocated.
+ * Ties are resolved in favor of the lower index. Returns the number of
+ * entries written to res (min(k, size)).
+ */
+int topk_u8(const uint8_t *in, int size, int k, topk_result_t *res);
+
+/* Softmax over a uint8 output that is dequantized as in[i] * scale. The LUT
+ * is built once by topk_softmax_init and reused for every frame.
+ * topk_softmax_denom returns the softmax denominator relative to the maximum
+ * value max_val, so that the probability of an element q is
+ * topk_softmax_prob(q, max_val, denom).
+ */
+void  topk_softmax_init(float scale);
+float topk_softmax_denom(const uint8_t *in, int size, uint8_t max_val);
+float topk_softmax_prob(uint8_t q, uint8_t max_val, float denom);
+
+#endif // TOPK_H
@@ -0,0 +1,268 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <mutex>
+#include <algorithm>
+#include "execution_object.h"
+#include "execution_object_pipeline.h"
+#include "trace.h"
+#include "error.h"
+
+using namespace tidl;
+
+#define TRACE_EVENTS_PER_THREAD (1 << 16)
+
+struct TraceEvent {
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+  uint32_t frame;
+  int track;
+};
+
+struct TraceBuffer {
+  std::vector<TraceEvent> events;
+  uint64_t dropped;
+};
+
+struct PipelineTrace {
+  const ExecutionObjectPipeline *eop;
+  std::vector<const ExecutionObject *> eos;
+  std::vector<int> eo_tracks;
+  int track;
+  uint64_t start;
+};
+
+bool trace_on = false;
+
+static std::string trace_path;
+static uint64_t start_ns;
+// registration of timelines and buffers, never taken while recording
+static std::mutex lock;
+static std::vector<std::string> tracks;
+static std::vector<TraceBuffer *> buffers;
+static thread_local TraceBuffer *thread_buf = nullptr;
+static thread_local int thread_track = -1;
+// the EOPs are started and waited for by the frame loop only
+static std::vector<PipelineTrace> pipelines;
+// per timeline, when the device is done with the frames queued on it
+static std::vector<uint64_t> device_free_at;
+
+uint64_t trace_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// timeline of that name, a new unnamed thread timeline for ""
+static int add_track(const std::string &name)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  if (name.empty()) {
+    tracks.push_back("thread " + std::to_string(tracks.size()));
+    return tracks.size() - 1;
+  }
+  auto t = std::find(tracks.begin(), tracks.end(), name);
+  if (t != tracks.end())
+    return t - tracks.begin();
+  tracks.push_back(name);
+  return tracks.size() - 1;
+}
+
+static void record(const char *name, uint64_t begin, uint64_t end,
+                   uint32_t frame, int track)
+{
+  if (!thread_buf) {
+    thread_buf = new TraceBuffer();
+    thread_buf->events.reserve(TRACE_EVENTS_PER_THREAD);
+    thread_buf->dropped = 0;
+    std::lock_guard<std::mutex> guard(lock);
+    buffers.push_back(thread_buf);
+  }
+  if (thread_buf->events.size() == TRACE_EVENTS_PER_THREAD) {
+    thread_buf->dropped++;
+    return;
+  }
+  thread_buf->events.push_back({name, begin, end, frame, track});
+}
+
+bool trace_start(const std::string &path)
+{
+  FILE *fp = fopen(path.c_str(), "w");
+  if (!fp) {
+    ERROR("Could not open %s: %s", path.c_str(), strerror(errno));
+    return false;
+  }
+  fclose(fp);
+  trace_path = path;
+  start_ns = trace_now();
+  trace_on = true;
+  return true;
+}
+
+void trace_thread_name(const char *name)
+{
+  if (trace_on)
+    thread_track = add_track(name);
+}
+
+void trace_span(const char *name, uint64_t begin, uint64_t end,
+                uint32_t frame)
+{
+  if (!trace_on)
+    return;
+  if (thread_track < 0)
+    thread_track = add_track("");
+  record(name, begin, end, frame, thread_track);
+}
+
+void trace_add_pipeline(const ExecutionObjectPipeline *eop,
+                        const std::vector<ExecutionObject *> &eos)
+{
+  if (!trace_on)
+    return;
+  PipelineTrace p;
+  p.eop = eop;
+  p.start = 0;
+  std::string devices;
+  for (auto eo : eos) {
+    int track = add_track(eo->GetDeviceName());
+    if (device_free_at.size() <= (size_t) track)
+      device_free_at.resize(track + 1, 0);
+    p.eos.push_back(eo);
+    p.eo_tracks.push_back(track);
+    devices += (devices.empty() ? "" : "+") + eo->GetDeviceName();
+  }
+  p.track = add_track("EOP " + std::to_string(pipelines.size()) + " (" +
+                      devices + ")");
+  pipelines.push_back(p);
+}
+
+void trace_remove_pipeline(const ExecutionObjectPipeline *eop)
+{
+  for (auto p = pipelines.begin(); p != pipelines.end(); ++p)
+    if (p->eop == eop) {
+      pipelines.erase(p);
+      return;
+    }
+}
+
+static PipelineTrace *find_pipeline(const ExecutionObjectPipeline *eop)
+{
+  for (auto &p : pipelines)
+    if (p.eop == eop)
+      return &p;
+  return nullptr;
+}
+
+void trace_eop_start(const ExecutionObjectPipeline *eop)
+{
+  if (!trace_on)
+    return;
+  PipelineTrace *p = find_pipeline(eop);
+  if (p)
+    p->start = trace_now();
+}
+
+/* The host only sees when the frame went in and when it was waited for. The
+ * layer groups are laid out in between from the device time of their EOs,
+ * each starting once its EO is done with the frames queued before it.
+ */
+void trace_eop_done(const ExecutionObjectPipeline *eop)
+{
+  static const char *group_names[] = {"layers group 1", "layers group 2"};
+  if (!trace_on)
+    return;
+  PipelineTrace *p = find_pipeline(eop);
+  if (!p || p->start == 0)
+    return;
+  uint64_t end = trace_now();
+  uint32_t frame = eop->GetFrameIndex();
+  uint64_t t = p->start;
+  for (unsigned int i = 0; i < p->eos.size(); i++) {
+    int track = p->eo_tracks[i];
+    uint64_t dev = (uint64_t) (p->eos[i]->GetProcessTimeInMilliSeconds() * 1e6);
+    uint64_t begin = std::min(std::max(t, device_free_at[track]), end);
+    t = std::min(begin + dev, end);
+    record(p->eos.size() == 1 ? "network" : group_names[std::min(i, 1u)],
+           begin, t, frame, track);
+    device_free_at[track] = t;
+  }
+  record("EOP", p->start, end, frame, p->track);
+  p->start = 0;
+}
+
+void trace_stop()
+{
+  if (!trace_on)
+    return;
+  trace_on = false;
+
+  FILE *fp = fopen(trace_path.c_str(), "w");
+  if (!fp) {
+    ERROR("Could not open %s: %s", trace_path.c_str(), strerror(errno));
+    return;
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+          "\"args\":{\"name\":\"accelerated_tidl\"}}");
+  for (unsigned int t = 0; t < tracks.size(); t++) {
+    fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"tid\":%u,\"args\":{\"name\":\"%s\"}}", t, tracks[t].c_str());
+    fprintf(fp, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,"
+            "\"tid\":%u,\"args\":{\"sort_index\":%u}}", t, t);
+  }
+
+  uint64_t num = 0, dropped = 0;
+  for (auto b : buffers) {
+    for (auto &e : b->events) {
+      fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+              "\"ts\":%.3f,\"dur\":%.3f", e.name, e.track,
+              (e.begin - start_ns) / 1e3, (e.end - e.begin) / 1e3);
+      if (e.frame != LOG_NO_FRAME)
+        fprintf(fp, ",\"args\":{\"frame\":%u}", e.frame);
+      fprintf(fp, "}");
+    }
+    num += b->events.size();
+    dropped += b->dropped;
+    // the buffers are not given back, threads may still hold them
+    b->events.clear();
+  }
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+  MSG("Trace of %llu events written to %s", (unsigned long long) num,
+      trace_path.c_str());
+  if (dropped)
+    MSG("WARNING: %llu trace events dropped, the per-thread buffers hold %d",
+        (unsigned long long) dropped, TRACE_EVENTS_PER_THREAD);
+}
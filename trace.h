@@ -0,0 +1,90 @@
+/******************************************************************************
+ * Copyright (c) 2019-2020, Texas Instruments Incorporated - http://www.ti.com/
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions are met:
+ *       * Redistributions of source code must retain the above copyright
+ *         notice, this list of conditions and the following disclaimer.
+ *       * Redistributions in binary form must reproduce the above copyright
+ *         notice, this list of conditions and the following disclaimer in the
+ *         documentation and/or other materials provided with the distribution.
+ *       * Neither the name of Texas Instruments Incorporated nor the
+ *         names of its contributors may be used to endorse or promote products
+ *         derived from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *   SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *   INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *   CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *   ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *   THE POSSIBILITY OF SUCH DAMAGE.
+ *****************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "async_log.h"
+
+namespace tidl {
+class ExecutionObject;
+class ExecutionObjectPipeline;
+}
+
+/* Timeline of the pipeline stages in the Chrome trace-event format, to be
+ * opened in Perfetto (ui.perfetto.dev) or chrome://tracing.
+ *
+ * Every thread records its spans into a buffer of its own that is only
+ * written out by trace_stop() at exit, so recording takes two clock reads
+ * and no locks. The host stages go on the timeline of the thread that runs
+ * them, the layer groups on the timeline of the EVE or DSP that runs them.
+ */
+extern bool trace_on;
+
+// Record from now on and write the trace to path at exit
+bool trace_start(const std::string &path);
+// Write the trace out, only the first call does
+void trace_stop();
+uint64_t trace_now();
+// Name of the timeline of the calling thread
+void trace_thread_name(const char *name);
+// Span of the calling thread, name must be a string literal
+void trace_span(const char *name, uint64_t begin, uint64_t end,
+                uint32_t frame);
+
+/* The EOs (first layer group first) that run the frames of eop, so that its
+ * frames show up on their devices
+ */
+void trace_add_pipeline(const tidl::ExecutionObjectPipeline *eop,
+                        const std::vector<tidl::ExecutionObject *> &eos);
+void trace_remove_pipeline(const tidl::ExecutionObjectPipeline *eop);
+// Around ProcessFrameStartAsync() and once ProcessFrameWait() returned
+void trace_eop_start(const tidl::ExecutionObjectPipeline *eop);
+void trace_eop_done(const tidl::ExecutionObjectPipeline *eop);
+
+// Span of the enclosing scope, on the frame set by async_log_frame()
+class TraceScope {
+public:
+  explicit TraceScope(const char *name)
+    : name(name), begin(trace_on ? trace_now() : 0) {}
+  ~TraceScope() {
+    if (begin)
+      trace_span(name, begin, trace_now(), async_log_current_frame());
+  }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+  const char *name;
+  uint64_t begin;
+};
+
+#endif // TRACE_H
@@ -29,6 +29,7 @@
 #include <linux/videodev2.h>
 #include <string>
 #include "save_utils.h"
+#include "capture_stats.h"
 
 #define CAP_WIDTH 800
 #define CAP_HEIGHT 600
@@ -65,6 +66,10 @@ public:
   int m_num_buffers;
   ImageParams src;
   ImageParams dst;
+  // source crop of the VPE, in capture coordinates. It is scaled to dst.
+  v4l2_rect crop;
+  // region of dst that the crop is scaled into, the rest of dst is untouched
+  v4l2_rect compose;
 
   VPEObj();
   VPEObj(int src_w, int src_h, int src_bytes_per_pixel, int src_fourcc,
@@ -76,7 +81,10 @@ public:
   int set_src_format();
   int set_dst_format();
   bool vpe_input_init();
+  bool set_src_crop(const v4l2_rect &r);
+  bool set_dst_compose(const v4l2_rect &r);
   bool vpe_output_init(int *export_fds);
+  bool vpe_output_release();
   bool input_qbuf(int fd, int index);
   bool output_qbuf(int index, int fd);
   bool stream_on(int layer);
@@ -97,12 +105,15 @@ class VIPObj {
 public:
   int m_fd;
   ImageParams src;
+  // sequence gaps, DQBUF wait and buffer hold times of the capture
+  CaptureStats stats;
 
   VIPObj();
   VIPObj(std::string dev_name, int w, int h, int pix_fmt, int num_buf, int type);
   ~VIPObj();
   int set_format();
-  void device_init();
+  bool device_init();
+  bool wait_frame(int timeout_ms);
   bool queue_buf(int fd, int index);
   bool queue_export_buf(int fd, int index);
   bool request_buf();
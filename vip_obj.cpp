@@ -32,6 +32,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <iostream>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/time.h>
@@ -64,7 +65,7 @@ void VIPObj::default_parameters(void) {
 }
 
 
-void VIPObj::device_init(){
+bool VIPObj::device_init(){
     struct v4l2_capability capability;
     struct v4l2_streamparm streamparam;
     int ret;
@@ -74,14 +75,12 @@ void VIPObj::device_init(){
 
     if (m_fd < 0) {
         ERROR("Cannot open %s device\n\n", m_dev_name.c_str());
-        return;
+        return false;
     }
 
     MSG("\n%s: Opened Channel at fd %d\n", m_dev_name.c_str(), m_fd);
-    if (m_fd == 0) {
+    if (m_fd == 0)
       MSG("WARNING: Capture device opened fd 0. There may be an issue with stdin.");
-      sleep(1.5);
-    }
 
     /* Check if the device is capable of streaming */
     if (ioctl(m_fd, VIDIOC_QUERYCAP, &capability) < 0) {
@@ -136,10 +135,11 @@ void VIPObj::device_init(){
     MSG("%s: VIP: G_FMT(start): width = %u, height = %u, 4cc = %.4s\n",
         m_dev_name.c_str(), src.fmt.fmt.pix.width, src.fmt.fmt.pix.height,
         (char*)&src.fmt.fmt.pix.pixelformat);
-    return;
+    return true;
 ERR:
     close(m_fd);
-    return;
+    m_fd = -1;
+    return false;
 }
 
 
@@ -247,9 +247,9 @@ bool VIPObj::request_export_buf(int * export_fds){
       else if (src.memory == V4L2_MEMORY_MMAP) {
         src.base_addr[i] = (unsigned int *) mmap(NULL, src.v4l2bufs[i]->length, PROT_READ | PROT_WRITE,
                MAP_SHARED, m_fd, src.v4l2bufs[i]->m.offset);
-        if (!src.base_addr[i]) {
-          ERROR("mmap failed!");
-          sleep(2);
+        if (src.base_addr[i] == MAP_FAILED) {
+          ERROR("mmap failed: %s", strerror(errno));
+          return false;
         }
         MSG("Length: %d\nAddress: %p", src.v4l2bufs[i]->length, src.base_addr[i]);
       }
@@ -281,6 +281,7 @@ bool VIPObj::queue_export_buf(int fd, int index){
         ERROR("VIDIOC_QBUF failed: %s (%d)", strerror(errno), ret);
         return false;
     }
+    stats.queued(index);
 
     return true;
 }
@@ -309,6 +310,7 @@ bool VIPObj::queue_buf(int fd, int index) {
         ERROR("VIDIOC_QBUF failed: %s (%d)", strerror(errno), ret);
         return false;
     }
+    stats.queued(buf->index);
 
     return true;
 }
@@ -324,13 +326,14 @@ int VIPObj::dequeue_buf(VPEObj *vpe){
 
     v4l2buf.type = src.type;
     v4l2buf.memory = src.memory;
+    double t0 = capture_stats_now_ms();
     ret = ioctl(m_fd, VIDIOC_DQBUF, &v4l2buf);
     // print_v4l2buffer(&v4l2buf);
-    MSG("m_fd is %d", m_fd);
     if (ret) {
         ERROR("VIDIOC_DQBUF failed: %s (%d)\n", strerror(errno), ret);
         return -1;
     }
+    stats.dequeued(v4l2buf, capture_stats_now_ms() - t0);
     if (vpe)
       vpe->m_field = v4l2buf.field;
 
@@ -338,6 +341,27 @@ int VIPObj::dequeue_buf(VPEObj *vpe){
 }
 
 
+/* Wait until a captured frame can be dequeued, so that a camera that does
+ * not deliver is reported instead of blocking in DQBUF forever
+ */
+bool VIPObj::wait_frame(int timeout_ms) {
+    struct pollfd pfd;
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret < 0) {
+        ERROR("poll failed: %s", strerror(errno));
+        return false;
+    }
+    if (ret == 0) {
+        ERROR("%s: no frame within %d ms", m_dev_name.c_str(), timeout_ms);
+        return false;
+    }
+    return true;
+}
+
 /*
 * DeQueue V4L2 buffer
 */
@@ -347,11 +371,13 @@ int VIPObj::dequeue_buf() {
 
     v4l2buf.type = src.type;
   	v4l2buf.memory = src.memory;
+    double t0 = capture_stats_now_ms();
     int ret = ioctl(m_fd, VIDIOC_DQBUF, &v4l2buf);
     if (ret) {
         ERROR("VIDIOC_DQBUF failed: %s (%d)\n", strerror(errno), ret);
         return -1;
     }
+    stats.dequeued(v4l2buf, capture_stats_now_ms() - t0);
     return v4l2buf.index;
 }
 
@@ -368,6 +394,7 @@ bool VIPObj::stream_on(){
         ERROR("VIDIOC_STREAMON failed: %s (%d)", strerror(errno), ret);
         return false;
     }
+    stats.stream_on(src.num_buffers);
 
     return true;
 }
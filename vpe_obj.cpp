@@ -80,6 +80,12 @@ void VPEObj::default_parameters(void) {
     dst.coplanar = false;
     dst.colorspace = V4L2_COLORSPACE_SRGB;
     dst.memory = V4L2_MEMORY_MMAP;
+
+    crop.left = 0;
+    crop.top = 0;
+    crop.width = dst.width;
+    crop.height = dst.height;
+    compose = crop;
     return;
 }
 
@@ -96,10 +102,8 @@ bool VPEObj::open_fd() {
 
   MSG("\n%s: Opened Channel with fd = %d\n", m_dev_name.c_str(), m_fd);
 
-  if (m_fd == 0) {
+  if (m_fd == 0)
     MSG("WARNING: Capture device opened fd 0. There may be an issue with stdin.");
-    sleep(1.5);
-  }
   return true;
 }
 
@@ -120,36 +124,70 @@ bool VPEObj::set_ctrl()
 	return true;
 }
 
-bool VPEObj::vpe_input_init()
+/* Set the region of the source image that the VPE scales to the destination.
+ * This can be called while streaming, it takes effect with the next input
+ * buffer that is queued.
+ */
+bool VPEObj::set_src_crop(const v4l2_rect &r)
 {
-	int ret;
-	struct v4l2_requestbuffers rqbufs;
   struct v4l2_selection selection;
 
-
-	if (!set_ctrl()) return false;
-
-
-  selection.r.left = 0;
-  selection.r.top = 0;
-  selection.r.width = dst.width;
-  selection.r.height = dst.height;
+  memset(&selection, 0, sizeof(selection));
+  selection.r = r;
   selection.target = V4L2_SEL_TGT_CROP_ACTIVE;
   selection.type = src.type;
 
-  ret = ioctl(m_fd, VIDIOC_S_SELECTION, &selection);
-  if (ret < 0) {
+  if (ioctl(m_fd, VIDIOC_S_SELECTION, &selection) < 0) {
     ERROR( "%s: vpe i/p: S_SELECTION failed: %s\n", m_dev_name.c_str(), strerror(errno));
     return false;
   }
-  ret = ioctl(m_fd, VIDIOC_G_SELECTION, &selection);
-  if (ret < 0) {
+  if (ioctl(m_fd, VIDIOC_G_SELECTION, &selection) < 0) {
     ERROR( "%s: vpe i/p: G_SELECTION failed: %s\n", m_dev_name.c_str(), strerror(errno));
     return false;
   }
+  // the driver may have aligned the rectangle
+  crop = selection.r;
+  return true;
+}
+
+/* Set the region of the destination buffer that the source crop is scaled
+ * into. The driver offsets the output address by it, so that the VPE can
+ * write into a part of a larger buffer. Must be called after the destination
+ * format is set, which resets it to the full buffer.
+ */
+bool VPEObj::set_dst_compose(const v4l2_rect &r)
+{
+  struct v4l2_selection selection;
+
+  memset(&selection, 0, sizeof(selection));
+  selection.r = r;
+  selection.target = V4L2_SEL_TGT_COMPOSE;
+  selection.type = dst.type;
+
+  if (ioctl(m_fd, VIDIOC_S_SELECTION, &selection) < 0) {
+    ERROR( "%s: vpe o/p: S_SELECTION failed: %s\n", m_dev_name.c_str(), strerror(errno));
+    return false;
+  }
+  if (ioctl(m_fd, VIDIOC_G_SELECTION, &selection) < 0) {
+    ERROR( "%s: vpe o/p: G_SELECTION failed: %s\n", m_dev_name.c_str(), strerror(errno));
+    return false;
+  }
+  compose = selection.r;
+  return true;
+}
+
+bool VPEObj::vpe_input_init()
+{
+	int ret;
+	struct v4l2_requestbuffers rqbufs;
+
+
+	if (!set_ctrl()) return false;
+
+  if (!set_src_crop(crop)) return false;
 
   DBG("Cropping params of VPE set to\nw: %d\nh: %d\norigin: (%d,%d)",
-    selection.r.width, selection.r.height, selection.r.left, selection.r.top);
+    crop.width, crop.height, crop.left, crop.top);
 
 
   MSG("\n%s: Opened Channel\n", m_dev_name.c_str());
@@ -244,12 +282,24 @@ bool VPEObj::vpe_output_init(int *export_fds)
   }
   DBG("dst.fourcc = 0x%x", fmt.fmt.pix_mp.pixelformat);
   dst.size = fmt.fmt.pix_mp.plane_fmt[0].sizeimage;
-  // sleep(10);
 
   DBG("dst.size was set at %d", dst.size);
-  sleep(1);
   dst.size_uv = fmt.fmt.pix_mp.plane_fmt[1].sizeimage;
 
+  if (compose.left != 0 || compose.top != 0 ||
+      (int) compose.width != dst.width || (int) compose.height != dst.height) {
+    if (!set_dst_compose(compose)) {
+      // the image is then stretched over the whole buffer
+      ERROR("%s: vpe o/p: compose %ux%u at (%d,%d) not supported",
+            m_dev_name.c_str(), compose.width, compose.height, compose.left,
+            compose.top);
+      compose.left = 0;
+      compose.top = 0;
+      compose.width = dst.width;
+      compose.height = dst.height;
+    }
+  }
+
 	ret = ioctl(m_fd, VIDIOC_G_FMT, &fmt);
 	if (ret < 0) {
 		ERROR( "%s: vpe o/p: G_FMT_2 failed: %s\n", m_dev_name.c_str(), strerror(errno));
@@ -259,6 +309,14 @@ bool VPEObj::vpe_output_init(int *export_fds)
 	MSG("%s: vpe o/p: G_FMT: width = %u, height = %u, 4cc = %.4s\n",
 			 m_dev_name.c_str(), fmt.fmt.pix_mp.width, fmt.fmt.pix_mp.height,
 			(char*)&fmt.fmt.pix_mp.pixelformat);
+  // the format has to be in place before buffers are requested for it
+  if ((int) fmt.fmt.pix_mp.width != dst.width ||
+      (int) fmt.fmt.pix_mp.height != dst.height ||
+      (int) fmt.fmt.pix_mp.pixelformat != dst.fourcc) {
+    ERROR("%s: vpe o/p: driver did not take the %dx%d format",
+          m_dev_name.c_str(), dst.width, dst.height);
+    return false;
+  }
 
 	memset(&rqbufs, 0, sizeof(rqbufs));
 	rqbufs.count = m_num_buffers;
@@ -329,6 +387,36 @@ bool VPEObj::vpe_output_init(int *export_fds)
 	return true;
 }
 
+/* Free the output buffers of the VPE so that vpe_output_init can be called
+ * again with another destination format. The output must not be streaming.
+ */
+bool VPEObj::vpe_output_release()
+{
+  struct v4l2_requestbuffers rqbufs;
+
+  memset(&rqbufs, 0, sizeof(rqbufs));
+  rqbufs.count = 0;
+  rqbufs.type = dst.type;
+  rqbufs.memory = dst.memory;
+
+  if (ioctl(m_fd, VIDIOC_REQBUFS, &rqbufs) < 0) {
+    ERROR( "%s: vpe o/p: REQBUFS 0 failed: %s\n", m_dev_name.c_str(), strerror(errno));
+    return false;
+  }
+
+  if (dst.v4l2bufs) {
+    for (int i = 0; i < m_num_buffers; i++) {
+      free(dst.v4l2bufs[i]);
+      free(dst.v4l2planes[i]);
+    }
+    free(dst.v4l2bufs);
+    free(dst.v4l2planes);
+    dst.v4l2bufs = NULL;
+    dst.v4l2planes = NULL;
+  }
+  return true;
+}
+
 bool VPEObj::input_qbuf(int fd, int index){
   struct v4l2_buffer buf;
 	struct v4l2_plane planes[2];
@@ -551,6 +639,10 @@ VPEObj::VPEObj(int src_w, int src_h, int src_bytes_per_pixel, int src_fourcc,
   dst.size = dst_w*dst_h*dst_bytes_per_pixel;
   dst.fourcc = dst_fourcc;
   dst.memory = dst_memory;
+
+  crop.width = dst_w;
+  crop.height = dst_h;
+  compose = crop;
 }
 
 